@@ -12,33 +12,57 @@
 #endif
 
 #include <curl/curl.h>
+#include <ctype.h>
+#include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <signal.h>
 #include <glob.h>
 #include <json-c/json.h>
+#include <limits.h>
+#include <linux/fs.h>
 #include <openssl/evp.h>
+#include <poll.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/mount.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <sys/xattr.h>
 #include <time.h>
 #include <unistd.h>
 
 #include <limeos-common-lib.h>
 #include "config.h"
 
-#include "phases/preparation/resolve.h"
 #include "phases/preparation/download.h"
+#include "phases/preparation/source.h"
+#include "phases/preparation/resolve.h"
+#include "phases/preparation/checksums.h"
+#include "phases/preparation/cache.h"
+#include "phases/preparation/lock.h"
 #include "phases/preparation/preparation.h"
 #include "phases/base/create.h"
 #include "phases/base/strip.h"
+#include "phases/base/snapshot.h"
 #include "phases/base/base.h"
 #include "phases/target/create.h"
 #include "phases/target/configure.h"
 #include "phases/target/package.h"
+#include "phases/target/image.h"
 #include "phases/target/target.h"
 #include "phases/live/create.h"
 #include "phases/live/configure.h"
@@ -50,7 +74,16 @@
 #include "phases/assembly/grub.h"
 #include "phases/assembly/iso.h"
 #include "phases/assembly/assembly.h"
+#include "phases/pipeline.h"
 #include "utils/rootfs.h"
 #include "utils/dependencies.h"
+#include "utils/clone.h"
+#include "utils/archive.h"
+#include "utils/dedup.h"
+#include "utils/packages.h"
+#include "utils/overlay.h"
+#include "utils/layers.h"
+#include "utils/executor.h"
+#include "utils/scheduler.h"
 #include "utils/branding/identity.h"
 #include "utils/branding/plymouth.h"
@@ -20,6 +20,25 @@
 /** The prefix for temporary build directories. */
 #define CONFIG_TMPDIR_PREFIX "/tmp/limeos-build-"
 
+/**
+ * The directory for artifacts reused across builds.
+ *
+ * Keep it on the same filesystem as the build directory so cached files can
+ * be hardlinked or reflinked into a build instead of copied.
+ */
+#define CONFIG_CACHE_DIR "/var/cache/limeos-iso-builder"
+
+/**
+ * The SOURCE_DATE_EPOCH of version 0.0.0 (2024-01-01 UTC). Other versions
+ * count up from it, a million seconds per major version, a thousand per
+ * minor version and one per patch, so every release gets its own fixed
+ * time that is later than the time of the releases before it.
+ */
+#define CONFIG_SOURCE_DATE_EPOCH_BASE 1704067200LL
+
+/** The default number of build steps run at once (see `--jobs`). */
+#define CONFIG_BUILD_JOBS 4
+
 // ---
 // Github Configuration
 // ---
@@ -33,12 +52,24 @@
 /** The GitHub API base URL for releases. */
 #define CONFIG_GITHUB_API_BASE "https://api.github.com/repos"
 
+/** The GitHub base URL for release asset downloads. */
+#define CONFIG_GITHUB_DOWNLOAD_BASE "https://github.com"
+
 /** The GitHub API version for request headers. */
 #define CONFIG_GITHUB_API_VERSION "2022-11-28"
 
 /** The filename for release checksums. */
 #define CONFIG_CHECKSUMS_FILENAME "SHA256SUMS"
 
+/**
+ * The filename of each repository's releases index in a release mirror.
+ *
+ * Holds the same JSON as the GitHub releases API. A mirror is laid out as
+ * `<repo>/` CONFIG_MIRROR_RELEASES_INDEX, with each release's checksums and
+ * assets under `<repo>/<version>/`.
+ */
+#define CONFIG_MIRROR_RELEASES_INDEX "releases.json"
+
 // ---
 // Boot Configuration
 // ---
@@ -129,15 +160,110 @@
 /** The Debian release to use for the base rootfs. */
 #define CONFIG_DEBIAN_RELEASE "bookworm"
 
+/** The Debian archive mirror used to bootstrap the base rootfs. */
+#define CONFIG_DEBIAN_MIRROR "http://deb.debian.org/debian"
+
 /** The installation path for component binaries (relative to rootfs). */
 #define CONFIG_INSTALL_BIN_PATH "/usr/local/bin"
 
-/** The path where the target tarball is stored in the live rootfs. */
-#define CONFIG_TARGET_ROOTFS_PATH "/usr/share/limeos/rootfs.tar.gz"
+/** The live rootfs directory holding the target payload and its format. */
+#define CONFIG_TARGET_PAYLOAD_DIR "/usr/share/limeos"
+
+/**
+ * The path where the target tarball is stored in the live rootfs, before
+ * the extension of its compression: "rootfs.tar.gz", "rootfs.tar.zst", or
+ * "rootfs.tar" when uncompressed.
+ */
+#define CONFIG_TARGET_ROOTFS_PATH CONFIG_TARGET_PAYLOAD_DIR "/rootfs.tar"
+
+/** The path where the target ext4 image is stored in the live rootfs. */
+#define CONFIG_TARGET_ROOTFS_IMAGE_PATH CONFIG_TARGET_PAYLOAD_DIR "/rootfs.img"
+
+/**
+ * The path where the geometry of the target ext4 image is recorded in the
+ * live rootfs, including the smallest partition it can be copied to.
+ *
+ * The image's filesystem UUID is derived from the source date epoch, so it
+ * is the same on every copy of a version. The manifest carries
+ * "regenerate_uuid=1", and the installer must then give the filesystem a
+ * fresh UUID after copying it (`tune2fs -U random`), before anything refers
+ * to it by `UUID=`, so two installs never share one.
+ */
+#define CONFIG_TARGET_ROOTFS_MANIFEST_PATH CONFIG_TARGET_PAYLOAD_DIR "/rootfs.manifest"
+
+/**
+ * The path where the format of the target payload is recorded in the live
+ * rootfs for the installer to detect: the tarball compression, as "gzip",
+ * "zstd" or "none", or "ext4" for the image.
+ */
+#define CONFIG_TARGET_ROOTFS_FORMAT_PATH CONFIG_TARGET_PAYLOAD_DIR "/rootfs.format"
+
+/**
+ * The directory of the ISO holding the target payload when it is shipped
+ * outside the live squashfs (see `--payload-on-media`).
+ */
+#define CONFIG_ISO_PAYLOAD_DIR "/limeos"
+
+/** The path where live-boot mounts the boot medium in the live system. */
+#define CONFIG_LIVE_MEDIUM_PATH "/run/live/medium"
+
+/**
+ * The live rootfs directory for the systemd units the embed step installs,
+ * kept apart from /etc/systemd/system, which the components step owns.
+ */
+#define CONFIG_LIVE_EMBED_UNIT_DIR "/usr/local/lib/systemd/system"
+
+/** The mount unit exposing the payload on the medium (named after its path). */
+#define CONFIG_TARGET_PAYLOAD_MOUNT_UNIT "usr-share-limeos.mount"
+
+/** The default format of the target payload (see `--payload-format`). */
+#define CONFIG_TARGET_PAYLOAD_FORMAT "tar"
+
+/** The block size of the target ext4 image. */
+#define CONFIG_TARGET_IMAGE_BLOCK_SIZE 4096
+
+/**
+ * The free space the target ext4 image is created with on top of its
+ * contents, before it is shrunk, for the journal and metadata. Kept small,
+ * since a larger filesystem spreads its inodes over more block groups, all
+ * of which the shrunk image must keep.
+ */
+#define CONFIG_TARGET_IMAGE_HEADROOM (64 * 1024 * 1024)
+
+/**
+ * The directory of the target rootfs whose identical files are collapsed into
+ * hardlinks. Limited to package-managed files, which are replaced rather than
+ * edited in place, so a change to one path never shows through another.
+ */
+#define CONFIG_TARGET_DEDUP_PATH "/usr"
+
+/** The default compression of the target tarball (see `--compression`). */
+#define CONFIG_TARGET_COMPRESSION "gzip"
+
+/** The gzip compression level of the target tarball (1-9). */
+#define CONFIG_TARGET_GZIP_LEVEL 6
+
+/** The zstd compression level of the target tarball (1-19). */
+#define CONFIG_TARGET_ZSTD_LEVEL 9
 
 /** The APT cache directory where bootloader packages are pre-populated. */
 #define CONFIG_APT_CACHE_DIR "/var/cache/apt/archives"
 
+/**
+ * The size cap of the host package archive shared across builds.
+ *
+ * Packages are pruned least recently used first once the archive grows past
+ * it.
+ */
+#define CONFIG_PACKAGES_ARCHIVE_MAX_BYTES (4ULL * 1024 * 1024 * 1024)
+
+/**
+ * The size cap of the layer store holding build step outputs across builds.
+ *
+ * Layers are pruned least recently used first once the store grows past it.
+ */
+#define CONFIG_LAYER_STORE_MAX_BYTES (16ULL * 1024 * 1024 * 1024)
+
 /**
  * Packages for the live rootfs (boots from ISO, runs installer).
  * Minimal environment to run the installation wizard.
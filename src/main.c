@@ -10,21 +10,33 @@ static void print_usage(const char *program_name)
     printf("Usage: %s <version> [options]\n", program_name);
     printf("\n");
     printf("Arguments:\n");
-    printf("  <version>       Version tag to build (e.g., 1.0.0)\n");
+    printf("  <version>               Version tag to build (e.g., 1.0.0)\n");
     printf("\n");
     printf("Options:\n");
-    printf("  --help          Show this help message\n");
+    printf("  --mirror <dir|url>      Fetch releases from a mirror instead of GitHub\n");
+    printf("  --lock <file>           Pin components to the releases in a lockfile\n");
+    printf("  --write-lock <file>     Record the fetched component releases to a lockfile\n");
+    printf("  --jobs <count>          Run up to this many build steps at once (default: %d)\n", CONFIG_BUILD_JOBS);
+    printf("  --build-dir <dir>       Keep the build in this directory and resume it after a failure\n");
+    printf("  --payload-format <type> Ship the target rootfs as a tar archive or an ext4 image (default: %s)\n", CONFIG_TARGET_PAYLOAD_FORMAT);
+    printf("  --compression <type>    Compress the target tarball with gzip, zstd or none (default: %s)\n", CONFIG_TARGET_COMPRESSION);
+    printf("  --payload-on-media      Ship the target payload on the ISO outside the live squashfs\n");
+    printf("  --verify-reproducible   Build the target payload and squashfs twice and fail unless they match\n");
+    printf("  --help                  Show this help message\n");
 }
 
 int main(int argc, char *argv[])
 {
     const char *version = NULL;
+    const char *mirror = NULL;
+    const char *lock_path = NULL;
+    const char *write_lock_path = NULL;
+    const char *persistent_build_dir = NULL;
+    const char *payload_format_name = CONFIG_TARGET_PAYLOAD_FORMAT;
+    const char *compression_name = CONFIG_TARGET_COMPRESSION;
+    int max_jobs = CONFIG_BUILD_JOBS;
     char build_dir[COMMON_MAX_PATH_LENGTH];
-    char components_dir[COMMON_MAX_PATH_LENGTH];
-    char base_rootfs_dir[COMMON_MAX_PATH_LENGTH];
-    char target_rootfs_dir[COMMON_MAX_PATH_LENGTH];
-    char target_tarball_path[COMMON_MAX_PATH_LENGTH];
-    char live_rootfs_dir[COMMON_MAX_PATH_LENGTH];
+    BuildContext context = {0};
     int exit_code = 0;
 
     // Verify the program is running as root.
@@ -59,12 +71,53 @@ int main(int argc, char *argv[])
     int option;
     static struct option long_options[] = {
         {"help", no_argument, 0, 'h'},
+        {"mirror", required_argument, 0, 'm'},
+        {"lock", required_argument, 0, 'l'},
+        {"write-lock", required_argument, 0, 'w'},
+        {"jobs", required_argument, 0, 'j'},
+        {"build-dir", required_argument, 0, 'b'},
+        {"payload-format", required_argument, 0, 'f'},
+        {"compression", required_argument, 0, 'c'},
+        {"payload-on-media", no_argument, 0, 'p'},
+        {"verify-reproducible", no_argument, 0, 'r'},
         {0, 0, 0, 0}
     };
-    while ((option = getopt_long(argc, argv, "h", long_options, NULL)) != -1)
+    while ((option = getopt_long(argc, argv, "hm:l:w:j:b:f:c:pr", long_options, NULL)) != -1)
     {
         switch (option)
         {
+            case 'm':
+                mirror = optarg;
+                break;
+            case 'l':
+                lock_path = optarg;
+                break;
+            case 'w':
+                write_lock_path = optarg;
+                break;
+            case 'j':
+                max_jobs = atoi(optarg);
+                if (max_jobs < 1)
+                {
+                    LOG_ERROR("Invalid job count: %s", optarg);
+                    return 1;
+                }
+                break;
+            case 'b':
+                persistent_build_dir = optarg;
+                break;
+            case 'f':
+                payload_format_name = optarg;
+                break;
+            case 'c':
+                compression_name = optarg;
+                break;
+            case 'p':
+                context.is_payload_on_media = 1;
+                break;
+            case 'r':
+                context.is_verifying_reproducible = 1;
+                break;
             case 'h':
                 print_usage(argv[0]);
                 return 0;
@@ -90,69 +143,129 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    // Create a secure temporary build directory.
-    if (common.create_secure_tmpdir(build_dir, sizeof(build_dir)) != 0)
+    // Fix the time the build output's timestamps are set or clamped to.
+    int epoch_result = get_source_date_epoch(version, &context.source_date_epoch);
+    if (epoch_result != 0)
     {
-        LOG_ERROR("Failed to create secure build directory");
+        LOG_ERROR(
+            "Invalid %s: %s", epoch_result == -1 ? "SOURCE_DATE_EPOCH" : "version",
+            epoch_result == -1 ? getenv("SOURCE_DATE_EPOCH") : version
+        );
         return 1;
     }
 
-    // Install signal handlers for graceful shutdown.
-    common.install_signal_handlers(build_dir);
-
-    // Construct derived paths.
-    snprintf(components_dir, sizeof(components_dir), "%s/components", build_dir);
-    snprintf(base_rootfs_dir, sizeof(base_rootfs_dir), "%s/base-rootfs", build_dir);
-    snprintf(target_rootfs_dir, sizeof(target_rootfs_dir), "%s/target-rootfs", build_dir);
-    snprintf(target_tarball_path, sizeof(target_tarball_path), "%s/rootfs.tar.gz", build_dir);
-    snprintf(live_rootfs_dir, sizeof(live_rootfs_dir), "%s/live-rootfs", build_dir);
+    // Select the form the target rootfs is shipped in.
+    if (parse_payload_format(payload_format_name, &context.payload_format) != 0)
+    {
+        LOG_ERROR("Invalid payload format: %s (expected: tar or ext4)", payload_format_name);
+        return 1;
+    }
 
-    LOG_INFO("Building ISO for version %s", version);
+    // Select how the target tarball is compressed.
+    if (parse_tarball_compression(compression_name, &context.target_compression) != 0)
+    {
+        LOG_ERROR("Invalid compression: %s (expected: gzip, zstd or none)", compression_name);
+        return 1;
+    }
 
-    // Phase 1: Preparation - fetch components from GitHub.
-    if (run_preparation_phase(version, components_dir) != 0)
+    // Select where component releases are fetched from.
+    if (set_release_source(mirror) != 0)
     {
-        exit_code = 1;
-        goto cleanup;
+        LOG_ERROR("Invalid release mirror: %s", mirror);
+        return 1;
     }
-    if (common.check_interrupted()) return 130;
 
-    // Phase 2: Base - create and strip base rootfs.
-    if (run_base_phase(base_rootfs_dir) != 0)
+    // Pin components to the releases in the lockfile, if given.
+    if (lock_path && load_component_locks(lock_path) != 0)
     {
-        exit_code = 1;
-        goto cleanup;
+        clear_component_locks();
+        return 1;
     }
-    if (common.check_interrupted()) return 130;
 
-    // Phase 3: Target - copy base, install packages, brand, package.
-    if (run_target_phase(base_rootfs_dir, target_rootfs_dir, target_tarball_path, version) != 0)
+    if (persistent_build_dir)
     {
-        exit_code = 1;
-        goto cleanup;
+        // Use the given build directory, resolved to an absolute path for
+        // the overlay mounts.
+        if (common.mkdir_p(persistent_build_dir) != 0 ||
+            !realpath(persistent_build_dir, build_dir))
+        {
+            LOG_ERROR("Failed to create build directory %s", persistent_build_dir);
+            clear_component_locks();
+            return 1;
+        }
+
+        // Install signal handlers for graceful shutdown, without removing
+        // the build directory, so an interrupted build can be resumed.
+        common.install_signal_handlers(build_dir);
+        common.clear_cleanup_dir();
+    }
+    else
+    {
+        // Create a secure temporary build directory.
+        if (common.create_secure_tmpdir(build_dir, sizeof(build_dir)) != 0)
+        {
+            LOG_ERROR("Failed to create secure build directory");
+            return 1;
+        }
+
+        // Install signal handlers for graceful shutdown.
+        common.install_signal_handlers(build_dir);
     }
-    if (common.check_interrupted()) return 130;
 
-    // Phase 4: Live - copy base, install packages, embed target.
-    if (run_live_phase(base_rootfs_dir, live_rootfs_dir, target_tarball_path, components_dir, version) != 0)
+    // Construct derived paths.
+    context.version = version;
+    context.mirror = mirror;
+    context.lock_path = lock_path;
+    context.write_lock_path = write_lock_path;
+    snprintf(context.components_dir, sizeof(context.components_dir), "%s/components", build_dir);
+    snprintf(context.base_rootfs_dir, sizeof(context.base_rootfs_dir), "%s/base-rootfs", build_dir);
+    snprintf(context.target_rootfs_dir, sizeof(context.target_rootfs_dir), "%s/target-rootfs", build_dir);
+    snprintf(context.live_rootfs_dir, sizeof(context.live_rootfs_dir), "%s/live-rootfs", build_dir);
+    snprintf(context.iso_path, sizeof(context.iso_path), CONFIG_ISO_FILENAME_PREFIX "-%s.iso", version);
+    snprintf(context.log_dir, sizeof(context.log_dir), "%s/logs", build_dir);
+    if (persistent_build_dir)
     {
-        exit_code = 1;
-        goto cleanup;
+        snprintf(context.checkpoint_dir, sizeof(context.checkpoint_dir), "%s/checkpoints", build_dir);
     }
-    if (common.check_interrupted()) return 130;
 
-    // Base rootfs no longer needed after target and live are created.
-    common.rm_rf(base_rootfs_dir);
+    LOG_INFO("Building ISO for version %s", version);
 
-    // Phase 5: Assembly - configure bootloaders and create ISO.
-    if (run_assembly_phase(live_rootfs_dir, version) != 0)
+    // Run every phase, overlapping the steps that do not depend on each
+    // other: preparation, base, target, live, and assembly.
+    int pipeline_result = run_build_pipeline(&context, max_jobs);
+    if (pipeline_result == -2)
+    {
+        exit_code = 130;
+        goto cleanup;
+    }
+    if (pipeline_result != 0)
     {
         exit_code = 1;
         goto cleanup;
     }
 
 cleanup:
-    common.rm_rf(build_dir);
+    if (persistent_build_dir && exit_code != 0)
+    {
+        // Keep the build for the next run to resume, with the overlays
+        // unmounted so nothing stays mounted after the builder exits.
+        detach_rootfs(context.target_rootfs_dir);
+        detach_rootfs(context.live_rootfs_dir);
+        LOG_INFO("Kept build directory %s, rerun with --build-dir to resume", build_dir);
+    }
+    else if (persistent_build_dir)
+    {
+        // Remove everything but the logs once the build succeeded.
+        clean_build_pipeline(&context);
+    }
+    else
+    {
+        // Release the rootfs overlays before the base rootfs beneath them.
+        release_rootfs(context.target_rootfs_dir);
+        release_rootfs(context.live_rootfs_dir);
+        common.rm_rf(build_dir);
+    }
+    clear_component_locks();
     common.clear_cleanup_dir();
     return exit_code;
 }
@@ -4,20 +4,18 @@
 
 #include "all.h"
 
-/** Maximum length for the ISO output path. */
-#define ISO_OUTPUT_PATH_MAX_LENGTH 256
-
-int run_assembly_phase(const char *rootfs_dir, const char *version)
+int run_assembly_phase(
+    const char *rootfs_dir,
+    const char *iso_output_path,
+    int is_payload_on_media,
+    time_t source_date_epoch,
+    char *out_squashfs_digest
+)
 {
-    // Construct the ISO output path.
-    char iso_output_path[ISO_OUTPUT_PATH_MAX_LENGTH];
-    snprintf(
-        iso_output_path, sizeof(iso_output_path),
-        CONFIG_ISO_FILENAME_PREFIX "-%s.iso", version
-    );
-
     // Create the final ISO image (handles GRUB setup internally).
-    if (create_iso(rootfs_dir, iso_output_path) != 0)
+    if (create_iso(
+            rootfs_dir, iso_output_path, is_payload_on_media, source_date_epoch,
+            out_squashfs_digest) != 0)
     {
         LOG_ERROR("Failed to create ISO image");
         return -1;
@@ -1,5 +1,13 @@
 #pragma once
 
+/**
+ * The revision of the assembly phase.
+ *
+ * The stored ISO is keyed by it, so bump it whenever the assembly phase
+ * changes the image it produces.
+ */
+#define ASSEMBLY_PHASE_REVISION 2
+
 /**
  * Runs the assembly phase.
  *
@@ -7,9 +15,20 @@
  * the live rootfs, and assembles the final bootable hybrid ISO image.
  *
  * @param rootfs_dir The live rootfs directory.
- * @param version The version string for the ISO filename.
+ * @param iso_output_path The path to write the ISO image to.
+ * @param is_payload_on_media Whether to ship the target payload on the ISO
+ * outside the squashfs.
+ * @param source_date_epoch The time the squashfs and ISO timestamps use.
+ * @param out_squashfs_digest Receives the SHA-256 (hex) of the squashfs on
+ * the ISO, or `NULL` to skip hashing it.
  *
  * @return - `0` - Indicates success.
  * @return - `-1` - Indicates failure.
  */
-int run_assembly_phase(const char *rootfs_dir, const char *version);
+int run_assembly_phase(
+    const char *rootfs_dir,
+    const char *iso_output_path,
+    int is_payload_on_media,
+    time_t source_date_epoch,
+    char *out_squashfs_digest
+);
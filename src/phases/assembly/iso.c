@@ -7,6 +7,14 @@
 /** Squashfs compression. xz provides best ratio for live systems. */
 #define SQUASHFS_COMPRESSION "xz"
 
+/**
+ * Boot files left out of the squashfs (~100MB), since the ISO boots the
+ * copies in staging. Excluding them rather than deleting them keeps the
+ * live rootfs intact, so assembly can run again on it.
+ */
+#define SQUASHFS_BOOT_EXCLUDES \
+    "'boot/vmlinuz*' 'boot/initrd.img*' 'boot/config-*' 'boot/System.map-*'"
+
 /** Maximum cleanup retry attempts before giving up. */
 #define CLEANUP_MAX_RETRIES 3
 
@@ -29,14 +37,15 @@ static int create_staging_directory(const char *staging_path)
     return 0;
 }
 
-static int create_squashfs(const char *rootfs_path, const char *staging_path)
+int create_squashfs(
+    const char *rootfs_path,
+    const char *squashfs_path,
+    int is_payload_on_media,
+    time_t source_date_epoch
+)
 {
     LOG_INFO("Creating squashfs filesystem...");
 
-    // Construct the squashfs output path.
-    char squashfs_path[COMMON_MAX_PATH_LENGTH];
-    snprintf(squashfs_path, sizeof(squashfs_path), "%s/live/filesystem.squashfs", staging_path);
-
     // Quote the rootfs path for shell safety.
     char quoted_rootfs[COMMON_MAX_QUOTED_LENGTH];
     if (common.shell_escape_path(rootfs_path, quoted_rootfs, sizeof(quoted_rootfs)) != 0)
@@ -53,12 +62,21 @@ static int create_squashfs(const char *rootfs_path, const char *staging_path)
         return -2;
     }
 
-    // Create the squashfs filesystem.
+    // Leave out the payload if it ships on the ISO instead, keeping its
+    // directory as the mount point.
+    char payload_exclude[COMMON_MAX_PATH_LENGTH] = "";
+    if (is_payload_on_media)
+    {
+        snprintf(payload_exclude, sizeof(payload_exclude), " '%s/*'", CONFIG_TARGET_PAYLOAD_DIR + 1);
+    }
+
+    // Create the squashfs filesystem, with every timestamp set to the epoch.
     char command[COMMON_MAX_COMMAND_LENGTH];
     snprintf(
         command, sizeof(command),
-        "mksquashfs %s %s -comp " SQUASHFS_COMPRESSION " -noappend",
-        quoted_rootfs, quoted_squashfs
+        "SOURCE_DATE_EPOCH=%lld mksquashfs %s %s -comp " SQUASHFS_COMPRESSION " -noappend "
+        "-reproducible -wildcards -e " SQUASHFS_BOOT_EXCLUDES "%s",
+        (long long)source_date_epoch, quoted_rootfs, quoted_squashfs, payload_exclude
     );
     if (common.run_command_indented(command) != 0)
     {
@@ -85,7 +103,7 @@ static int copy_boot_files(const char *rootfs_path, const char *staging_path)
     // Copy the kernel to staging.
     snprintf(src_path, sizeof(src_path), "%s/boot/vmlinuz", rootfs_path);
     snprintf(dst_path, sizeof(dst_path), "%s/boot/vmlinuz", staging_path);
-    if (common.copy_file(src_path, dst_path) != 0)
+    if (clone_or_copy_file(src_path, dst_path) != 0)
     {
         LOG_ERROR("Failed to copy kernel");
         return -2;
@@ -94,7 +112,7 @@ static int copy_boot_files(const char *rootfs_path, const char *staging_path)
     // Copy the initrd to staging.
     snprintf(src_path, sizeof(src_path), "%s/boot/initrd.img", rootfs_path);
     snprintf(dst_path, sizeof(dst_path), "%s/boot/initrd.img", staging_path);
-    if (common.copy_file(src_path, dst_path) != 0)
+    if (clone_or_copy_file(src_path, dst_path) != 0)
     {
         LOG_ERROR("Failed to copy initrd");
         return -3;
@@ -103,7 +121,56 @@ static int copy_boot_files(const char *rootfs_path, const char *staging_path)
     return 0;
 }
 
-static int run_grub_mkrescue(const char *staging_path, const char *output_path)
+static int copy_payload_files(const char *rootfs_path, const char *staging_path)
+{
+    LOG_INFO("Placing target payload on the ISO outside the squashfs...");
+
+    // Create the payload directory in staging.
+    char src_dir[COMMON_MAX_PATH_LENGTH];
+    char dst_dir[COMMON_MAX_PATH_LENGTH];
+    snprintf(src_dir, sizeof(src_dir), "%s" CONFIG_TARGET_PAYLOAD_DIR, rootfs_path);
+    snprintf(dst_dir, sizeof(dst_dir), "%s" CONFIG_ISO_PAYLOAD_DIR, staging_path);
+    if (common.mkdir_p(dst_dir) != 0)
+    {
+        LOG_ERROR("Failed to create payload directory");
+        return -1;
+    }
+
+    // Copy every file of the payload directory, sharing extents if possible.
+    DIR *directory = opendir(src_dir);
+    if (!directory)
+    {
+        LOG_ERROR("Failed to open payload directory %s", src_dir);
+        return -2;
+    }
+    int result = 0;
+    struct dirent *entry;
+    while (result == 0 && (entry = readdir(directory)) != NULL)
+    {
+        if (entry->d_name[0] == '.')
+        {
+            continue;
+        }
+        char src_path[COMMON_MAX_PATH_LENGTH];
+        char dst_path[COMMON_MAX_PATH_LENGTH];
+        snprintf(src_path, sizeof(src_path), "%s/%s", src_dir, entry->d_name);
+        snprintf(dst_path, sizeof(dst_path), "%s/%s", dst_dir, entry->d_name);
+        if (clone_or_copy_file(src_path, dst_path) != 0)
+        {
+            LOG_ERROR("Failed to copy payload file %s", src_path);
+            result = -3;
+        }
+    }
+    closedir(directory);
+
+    return result;
+}
+
+static int run_grub_mkrescue(
+    const char *staging_path,
+    const char *output_path,
+    time_t source_date_epoch
+)
 {
     LOG_INFO("Running grub-mkrescue to create hybrid ISO...");
 
@@ -122,17 +189,18 @@ static int run_grub_mkrescue(const char *staging_path, const char *output_path)
     }
 
     // Build hybrid ISO supporting both BIOS and UEFI boot.
-    // grub-mkrescue handles all boot image creation automatically.
+    // grub-mkrescue handles all boot image creation automatically, and
+    // xorriso takes the volume dates and UUID from SOURCE_DATE_EPOCH.
     char command[COMMON_MAX_COMMAND_LENGTH];
     snprintf(
         command, sizeof(command),
-        "grub-mkrescue "
+        "SOURCE_DATE_EPOCH=%lld grub-mkrescue "
         "-o %s "            // Output ISO file path.
         "--locales=\"\" "   // Skip locales (reduce size).
         "--fonts=\"\" "     // Skip fonts (hidden menu anyway).
         "--themes=\"\" "    // Skip themes.
         "%s",               // Source directory (staging).
-        quoted_output, quoted_staging
+        (long long)source_date_epoch, quoted_output, quoted_staging
     );
     if (common.run_command_indented(command) != 0)
     {
@@ -169,25 +237,13 @@ static void cleanup_staging(const char *staging_path)
     );
 }
 
-static void cleanup_live_boot(const char *rootfs_path)
-{
-    char path[COMMON_MAX_PATH_LENGTH];
-
-    LOG_INFO("Removing boot files from live rootfs...");
-
-    // Remove versioned boot files (vmlinuz-*, initrd.img-*).
-    cleanup_versioned_boot_files(rootfs_path);
-
-    // Remove the generic kernel symlink.
-    snprintf(path, sizeof(path), "%s/boot/vmlinuz", rootfs_path);
-    common.rm_file(path);
-
-    // Remove the generic initrd symlink.
-    snprintf(path, sizeof(path), "%s/boot/initrd.img", rootfs_path);
-    common.rm_file(path);
-}
-
-int create_iso(const char *rootfs_path, const char *output_path)
+int create_iso(
+    const char *rootfs_path,
+    const char *output_path,
+    int is_payload_on_media,
+    time_t source_date_epoch,
+    char *out_squashfs_digest
+)
 {
     LOG_INFO("Creating bootable ISO image...");
 
@@ -201,7 +257,7 @@ int create_iso(const char *rootfs_path, const char *output_path)
         return -1;
     }
 
-    // Copy boot files to staging before cleanup removes them from rootfs.
+    // Copy boot files to staging, since the squashfs leaves them out.
     if (copy_boot_files(rootfs_path, staging_path) != 0)
     {
         cleanup_staging(staging_path);
@@ -215,18 +271,33 @@ int create_iso(const char *rootfs_path, const char *output_path)
         return -3;
     }
 
-    // Remove boot files from live rootfs to reduce squashfs size (~100MB).
-    cleanup_live_boot(rootfs_path);
+    // Place the payload next to the live directory, if requested.
+    if (is_payload_on_media && copy_payload_files(rootfs_path, staging_path) != 0)
+    {
+        cleanup_staging(staging_path);
+        return -6;
+    }
 
     // Create the squashfs filesystem from the live rootfs.
-    if (create_squashfs(rootfs_path, staging_path) != 0)
+    char squashfs_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(squashfs_path, sizeof(squashfs_path), "%s/live/filesystem.squashfs", staging_path);
+    if (create_squashfs(rootfs_path, squashfs_path, is_payload_on_media, source_date_epoch) != 0)
     {
         cleanup_staging(staging_path);
         return -4;
     }
 
+    // Hash the squashfs while it still exists, if requested.
+    if (out_squashfs_digest &&
+        common.compute_file_sha256(squashfs_path, out_squashfs_digest, COMMON_SHA256_HEX_LENGTH) != 0)
+    {
+        LOG_ERROR("Failed to hash squashfs: %s", squashfs_path);
+        cleanup_staging(staging_path);
+        return -7;
+    }
+
     // Assemble the final hybrid ISO with grub-mkrescue.
-    if (run_grub_mkrescue(staging_path, output_path) != 0)
+    if (run_grub_mkrescue(staging_path, output_path, source_date_epoch) != 0)
     {
         cleanup_staging(staging_path);
         return -5;
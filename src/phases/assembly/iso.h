@@ -1,13 +1,49 @@
 #pragma once
 
+/**
+ * Creates a squashfs of the live rootfs.
+ *
+ * The squashfs is compressed with xz and leaves out the boot files, which
+ * the ISO carries outside it. It is reproducible: mksquashfs sorts the
+ * entries and numbers the inodes in that order, and every timestamp is set
+ * to the source date epoch, so the same rootfs always gives the same bytes.
+ * Owners are kept as the numeric IDs of the rootfs.
+ *
+ * @param rootfs_path The path to the live rootfs directory.
+ * @param squashfs_path The path where the squashfs will be created.
+ * @param is_payload_on_media Whether to leave out the target payload.
+ * @param source_date_epoch The time every timestamp is set to.
+ *
+ * @return - `0` - Indicates successful squashfs creation.
+ * @return - `-1` - Indicates rootfs path quoting failure.
+ * @return - `-2` - Indicates squashfs path quoting failure.
+ * @return - `-3` - Indicates mksquashfs failure.
+ */
+int create_squashfs(
+    const char *rootfs_path,
+    const char *squashfs_path,
+    int is_payload_on_media,
+    time_t source_date_epoch
+);
+
 /**
  * Creates a hybrid bootable ISO image from the root filesystem.
  *
  * Uses grub-mkrescue to create an ISO that supports both UEFI and legacy BIOS
  * boot.
  *
+ * The target payload normally ships inside the live squashfs. With
+ * `is_payload_on_media`, its files are placed in CONFIG_ISO_PAYLOAD_DIR next
+ * to the live directory instead and left out of the squashfs, so mksquashfs
+ * does not recompress them and the installer reads them straight from the
+ * medium, through the mount unit the embed step installs.
+ *
  * @param rootfs_path The path to the prepared root filesystem directory.
  * @param output_path The path where the ISO file will be created.
+ * @param is_payload_on_media Whether to ship the payload outside the squashfs.
+ * @param source_date_epoch The time the squashfs and ISO timestamps use.
+ * @param out_squashfs_digest Receives the SHA-256 (hex) of the squashfs on
+ * the ISO, or `NULL` to skip hashing it.
  *
  * @return - `0` - Indicates successful ISO creation.
  * @return - `-1` - Indicates staging directory creation failure.
@@ -15,5 +51,13 @@
  * @return - `-3` - Indicates GRUB setup failure.
  * @return - `-4` - Indicates squashfs creation failure.
  * @return - `-5` - Indicates ISO assembly failure.
+ * @return - `-6` - Indicates payload copy failure.
+ * @return - `-7` - Indicates squashfs hashing failure.
  */
-int create_iso(const char *rootfs_path, const char *output_path);
+int create_iso(
+    const char *rootfs_path,
+    const char *output_path,
+    int is_payload_on_media,
+    time_t source_date_epoch,
+    char *out_squashfs_digest
+);
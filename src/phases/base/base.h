@@ -6,6 +6,9 @@
  * Creates a minimal, stripped rootfs that serves as the foundation for
  * both the target (installed system) and live (live installer) rootfs.
  * Running debootstrap once and copying saves significant build time.
+ * The build pipeline stores the stripped rootfs in the layer store, so
+ * later builds with the same inputs replay it instead of running
+ * debootstrap at all.
  *
  * @param rootfs_dir The directory for the base rootfs.
  *
@@ -21,8 +21,9 @@ int create_base_rootfs(const char *path)
     char command[COMMON_MAX_COMMAND_LENGTH];
     snprintf(
         command, sizeof(command),
-        "debootstrap --variant=minbase %s %s",
-        CONFIG_DEBIAN_RELEASE, quoted_path
+        "debootstrap --variant=%s %s %s %s",
+        BASE_DEBOOTSTRAP_VARIANT, CONFIG_DEBIAN_RELEASE, quoted_path,
+        CONFIG_DEBIAN_MIRROR
     );
     if (common.run_command_indented(command) != 0)
     {
@@ -38,8 +39,8 @@ int create_base_rootfs(const char *path)
     char sources_path[COMMON_MAX_PATH_LENGTH];
     snprintf(
         sources_content, sizeof(sources_content),
-        "deb http://deb.debian.org/debian %s main non-free-firmware\n",
-        CONFIG_DEBIAN_RELEASE
+        BASE_SOURCES_FORMAT,
+        CONFIG_DEBIAN_MIRROR, CONFIG_DEBIAN_RELEASE
     );
     snprintf(sources_path, sizeof(sources_path), "%s/etc/apt/sources.list", path);
     if (common.write_file(sources_path, sources_content) != 0)
@@ -82,7 +83,7 @@ int create_base_rootfs(const char *path)
         driver_policy_path, sizeof(driver_policy_path),
         "%s/etc/initramfs-tools/conf.d/driver-policy.conf", path
     );
-    if (common.write_file(driver_policy_path, "MODULES=most\n") != 0)
+    if (common.write_file(driver_policy_path, BASE_INITRAMFS_DRIVER_POLICY) != 0)
     {
         LOG_ERROR("Failed to create initramfs conf.d");
         return -6;
@@ -1,5 +1,14 @@
 #pragma once
 
+/** The debootstrap variant used for the base rootfs. */
+#define BASE_DEBOOTSTRAP_VARIANT "minbase"
+
+/** The apt sources line, formatted with the mirror and the release. */
+#define BASE_SOURCES_FORMAT "deb %s %s main non-free-firmware\n"
+
+/** The initramfs driver policy written to conf.d/driver-policy.conf. */
+#define BASE_INITRAMFS_DRIVER_POLICY "MODULES=most\n"
+
 /**
  * Creates a minimal base rootfs using debootstrap.
  *
@@ -0,0 +1,143 @@
+/**
+ * This code is responsible for identifying the stripped base rootfs by its
+ * inputs, so the layer store only reruns debootstrap when they change.
+ */
+
+#include "all.h"
+
+typedef struct ReleaseHeader
+{
+    char data[SNAPSHOT_RELEASE_HEADER_LENGTH];
+    size_t length;
+} ReleaseHeader;
+
+static size_t write_release_header(void *contents, size_t size, size_t nmemb, void *userp)
+{
+    ReleaseHeader *header = (ReleaseHeader *)userp;
+    size_t total_size = size * nmemb;
+
+    // Keep only the start of the file, where the Date field lives.
+    size_t available = sizeof(header->data) - 1 - header->length;
+    size_t length = total_size < available ? total_size : available;
+    memcpy(header->data + header->length, contents, length);
+    header->length += length;
+    header->data[header->length] = '\0';
+
+    // Stop the transfer once the buffer is full.
+    return length == total_size ? total_size : 0;
+}
+
+static int fetch_release_date(char *out_date, size_t date_length)
+{
+    // Construct the Release file URL of the configured suite.
+    char url[FETCH_URL_MAX_LENGTH];
+    snprintf(
+        url, sizeof(url), "%s/dists/%s/Release",
+        CONFIG_DEBIAN_MIRROR, CONFIG_DEBIAN_RELEASE
+    );
+
+    // Request only the head of the file, which carries the Date field.
+    CURL *curl = curl_easy_init();
+    if (!curl)
+    {
+        return -1;
+    }
+    ReleaseHeader header = {0};
+    char range[32];
+    snprintf(range, sizeof(range), "0-%d", SNAPSHOT_RELEASE_HEADER_LENGTH - 1);
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_RANGE, range);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_release_header);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &header);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, CONFIG_USER_AGENT);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, (long)FETCH_TIMEOUT_SECONDS);
+    CURLcode result = curl_easy_perform(curl);
+    curl_easy_cleanup(curl);
+
+    // A write error only means the server ignored the range.
+    if (result != CURLE_OK && result != CURLE_WRITE_ERROR)
+    {
+        return -1;
+    }
+
+    // Find the Date field at the start of a line.
+    const char *line = header.data;
+    while (line && *line)
+    {
+        if (strncmp(line, "Date:", 5) == 0)
+        {
+            const char *value = line + 5;
+            while (*value == ' ')
+            {
+                value++;
+            }
+            size_t length = strcspn(value, "\r\n");
+            if (length == 0 || length >= date_length)
+            {
+                return -1;
+            }
+            memcpy(out_date, value, length);
+            out_date[length] = '\0';
+            return 0;
+        }
+        line = strchr(line, '\n');
+        if (line)
+        {
+            line++;
+        }
+    }
+
+    return -1;
+}
+
+int build_base_snapshot_key(char *out_key, size_t key_length)
+{
+    if (key_length < SNAPSHOT_KEY_LENGTH)
+    {
+        return -2;
+    }
+
+    // Read when the archive last changed, since package lists and the
+    // packages debootstrap installs follow it.
+    char release_date[128];
+    if (fetch_release_date(release_date, sizeof(release_date)) != 0)
+    {
+        return -1;
+    }
+
+    // Render every input into one string, one per line.
+    char sources_content[256];
+    char inputs[1024];
+    snprintf(
+        sources_content, sizeof(sources_content), BASE_SOURCES_FORMAT,
+        CONFIG_DEBIAN_MIRROR, CONFIG_DEBIAN_RELEASE
+    );
+    int length = snprintf(
+        inputs, sizeof(inputs),
+        "release=%s\nmirror=%s\nvariant=%s\nsources=%sinitramfs=%s"
+        "strip=%d\ndate=%s\n",
+        CONFIG_DEBIAN_RELEASE, CONFIG_DEBIAN_MIRROR, BASE_DEBOOTSTRAP_VARIANT,
+        sources_content, BASE_INITRAMFS_DRIVER_POLICY, STRIP_RULES_REVISION,
+        release_date
+    );
+    if (length < 0 || (size_t)length >= sizeof(inputs))
+    {
+        return -2;
+    }
+
+    // Hash the inputs into the key.
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_length = 0;
+    if (EVP_Digest(inputs, (size_t)length, digest, &digest_length, EVP_sha256(), NULL) != 1)
+    {
+        return -2;
+    }
+    for (unsigned int i = 0; i < digest_length; i++)
+    {
+        snprintf(out_key + i * 2, 3, "%02x", digest[i]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+/** The length of a base rootfs key (SHA-256 hex plus terminator). */
+#define SNAPSHOT_KEY_LENGTH COMMON_SHA256_HEX_LENGTH
+
+/** The number of bytes of the mirror's Release file read for its date. */
+#define SNAPSHOT_RELEASE_HEADER_LENGTH 2048
+
+/**
+ * Computes the key identifying the stripped base rootfs for the current
+ * inputs.
+ *
+ * The key is the SHA-256 of everything that decides the stripped base
+ * rootfs: the Debian release and mirror, the debootstrap variant, the apt
+ * sources, the initramfs configuration, the strip rules revision, and the
+ * Date of the mirror's Release file, so a stored base rootfs is rebuilt as
+ * soon as the archive publishes new packages.
+ *
+ * @param out_key The buffer to store the key (hex).
+ * @param key_length The size of the key buffer.
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates the Release file date is unavailable.
+ * @return - `-2` - Indicates hashing failure.
+ */
+int build_base_snapshot_key(char *out_key, size_t key_length);
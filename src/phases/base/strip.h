@@ -1,5 +1,13 @@
 #pragma once
 
+/**
+ * The revision of the strip rules below.
+ *
+ * Stored base rootfs layers are keyed by it, so bump it whenever
+ * strip_base_rootfs() changes what it removes or writes.
+ */
+#define STRIP_RULES_REVISION 1
+
 /**
  * Aggressively strips the base rootfs to minimize size.
  *
@@ -10,17 +10,20 @@
  * Downloads packages using apt-get download.
  *
  * Packages are downloaded to the current directory, so we cd to the
- * APT cache first.
+ * APT cache first. Packages already in the host package archive are
+ * placed there beforehand, and apt-get download skips them.
  */
 static int download_packages(const char *rootfs, const char *packages)
 {
+    char apt_arguments[COMMON_MAX_COMMAND_LENGTH];
     char command[COMMON_MAX_COMMAND_LENGTH];
+    snprintf(apt_arguments, sizeof(apt_arguments), "download %s", packages);
     snprintf(
         command, sizeof(command),
         "cd " CONFIG_APT_CACHE_DIR " && apt-get download %s",
         packages
     );
-    return common.run_chroot_indented(rootfs, command);
+    return run_with_package_archive(rootfs, apt_arguments, command);
 }
 
 int bundle_live_packages(const char *live_rootfs_path)
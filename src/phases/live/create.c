@@ -9,42 +9,26 @@ int create_live_rootfs(const char *base_path, const char *path)
 {
     LOG_INFO("Creating live rootfs at %s", path);
 
-    // Quote the base path for shell safety.
-    char quoted_base[COMMON_MAX_QUOTED_LENGTH];
-    if (common.shell_escape_path(base_path, quoted_base, sizeof(quoted_base)) != 0)
+    // Derive the rootfs from the base as a copy-on-write layer.
+    LOG_INFO("Deriving rootfs from base...");
+    int derive_result = derive_rootfs(base_path, path);
+    if (derive_result != 0)
     {
-        LOG_ERROR("Failed to quote base path");
-        return -1;
-    }
-
-    // Quote the destination path for shell safety.
-    char quoted_path[COMMON_MAX_QUOTED_LENGTH];
-    if (common.shell_escape_path(path, quoted_path, sizeof(quoted_path)) != 0)
-    {
-        LOG_ERROR("Failed to quote path");
-        return -2;
-    }
-
-    // Copy the base rootfs.
-    LOG_INFO("Copying base rootfs...");
-    char command[COMMON_MAX_COMMAND_LENGTH];
-    snprintf(command, sizeof(command), "cp -a %s %s", quoted_base, quoted_path);
-    if (common.run_command_indented(command) != 0)
-    {
-        LOG_ERROR("Failed to copy base rootfs");
-        return -3;
+        LOG_ERROR("Failed to derive rootfs from base");
+        return derive_result == -1 ? -1 : -2;
     }
 
     // Install live-specific packages.
     LOG_INFO("Installing live environment packages...");
-    int install_result = common.run_chroot_indented(path,
+    int install_result = run_with_package_archive(path,
+        "install --no-install-recommends " CONFIG_LIVE_PACKAGES,
         "apt-get install -y --no-install-recommends " CONFIG_LIVE_PACKAGES);
 
     // Check if package installation succeeded.
     if (install_result != 0)
     {
         LOG_ERROR("Failed to install required packages");
-        return -4;
+        return -3;
     }
 
     // Add GPU drivers for early KMS initialization. Must be done AFTER package
@@ -54,15 +38,16 @@ int create_live_rootfs(const char *base_path, const char *path)
         "printf 'amdgpu\\ni915\\nnouveau\\nradeon\\n' >> /etc/initramfs-tools/modules") != 0)
     {
         LOG_ERROR("Failed to add GPU drivers to initramfs modules");
-        return -5;
+        return -4;
     }
 
-    // Clean APT cache to remove downloaded .deb files.
-    // Bootloader packages will be downloaded later by bundle_live_packages.
+    // Clean APT cache to remove downloaded .deb files. They were kept in the
+    // host package archive, so later chroots and builds still reuse them.
+    // Bootloader packages will be placed later by bundle_live_packages.
     if (common.run_chroot_indented(path, "apt-get clean") != 0)
     {
         LOG_ERROR("Failed to clean APT cache");
-        return -6;
+        return -5;
     }
 
     // Copy kernel and initrd to standard paths for boot loaders.
@@ -84,7 +69,7 @@ int create_live_rootfs(const char *base_path, const char *path)
                 LOG_ERROR("Failed to copy initrd");
                 break;
         }
-        return -7;
+        return -6;
     }
 
     LOG_INFO("Live rootfs created successfully");
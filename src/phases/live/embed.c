@@ -1,33 +1,145 @@
 /**
- * This code is responsible for embedding the target rootfs tarball into the
- * live rootfs so the installer can access it during installation.
+ * This code is responsible for embedding the target rootfs into the live
+ * rootfs as a tarball or ext4 image so the installer can access it during
+ * installation.
  */
 
 #include "all.h"
 
-int embed_target_rootfs(const char *live_rootfs_path, const char *tarball_path)
+/**
+ * Writes the mount unit exposing the payload on the boot medium at
+ * CONFIG_TARGET_PAYLOAD_DIR, and enables it.
+ *
+ * @return - `0` - Success.
+ * @return - `-1` - Directory creation failure.
+ * @return - `-2` - Unit file write failure.
+ * @return - `-3` - Symlink creation failure.
+ */
+static int write_payload_mount_unit(const char *rootfs_path)
+{
+    // Create the unit directory with its "local-fs wants" directory.
+    char path[COMMON_MAX_PATH_LENGTH];
+    snprintf(
+        path, sizeof(path), "%s" CONFIG_LIVE_EMBED_UNIT_DIR "/local-fs.target.wants",
+        rootfs_path
+    );
+    if (common.mkdir_p(path) != 0)
+    {
+        return -1;
+    }
+
+    // Bind the payload directory of the medium, which live-boot has mounted
+    // by the time systemd starts, read-only over the payload directory.
+    const char *unit_content =
+        "[Unit]\n"
+        "Description=LimeOS Target Payload\n"
+        "RequiresMountsFor=" CONFIG_LIVE_MEDIUM_PATH "\n"
+        "\n"
+        "[Mount]\n"
+        "What=" CONFIG_LIVE_MEDIUM_PATH CONFIG_ISO_PAYLOAD_DIR "\n"
+        "Where=" CONFIG_TARGET_PAYLOAD_DIR "\n"
+        "Type=none\n"
+        "Options=bind,ro\n"
+        "\n"
+        "[Install]\n"
+        "WantedBy=local-fs.target\n";
+    snprintf(
+        path, sizeof(path), "%s" CONFIG_LIVE_EMBED_UNIT_DIR "/" CONFIG_TARGET_PAYLOAD_MOUNT_UNIT,
+        rootfs_path
+    );
+    if (common.write_file(path, unit_content) != 0)
+    {
+        return -2;
+    }
+
+    // Enable the unit.
+    snprintf(
+        path, sizeof(path),
+        "%s" CONFIG_LIVE_EMBED_UNIT_DIR "/local-fs.target.wants/" CONFIG_TARGET_PAYLOAD_MOUNT_UNIT,
+        rootfs_path
+    );
+    if (common.symlink_file("../" CONFIG_TARGET_PAYLOAD_MOUNT_UNIT, path) != 0)
+    {
+        return -3;
+    }
+
+    return 0;
+}
+
+int embed_target_rootfs(
+    const char *live_rootfs_path,
+    const char *target_rootfs_path,
+    PayloadFormat format,
+    TarballCompression compression,
+    int is_payload_on_media,
+    time_t source_date_epoch
+)
 {
-    LOG_INFO("Embedding target rootfs tarball into live rootfs...");
+    LOG_INFO("Embedding target rootfs %s into live rootfs...", get_payload_format_name(format));
 
-    // Create the target directory within the live rootfs.
+    // Create the target directory within the live rootfs, dropping the
+    // payload of an earlier attempt, which may be in the other format.
     char dst_dir[COMMON_MAX_PATH_LENGTH];
-    snprintf(dst_dir, sizeof(dst_dir), "%s/usr/share/limeos", live_rootfs_path);
-    if (common.mkdir_p(dst_dir) != 0)
+    snprintf(dst_dir, sizeof(dst_dir), "%s" CONFIG_TARGET_PAYLOAD_DIR, live_rootfs_path);
+    if (common.rm_rf(dst_dir) != 0 || common.mkdir_p(dst_dir) != 0)
     {
         LOG_ERROR("Failed to create limeos directory in live rootfs");
         return -1;
     }
 
-    // Copy the tarball to the live rootfs.
+    // Package the target rootfs straight to its place in the live rootfs,
+    // so the payload is written once.
     char dst_path[COMMON_MAX_PATH_LENGTH];
-    snprintf(dst_path, sizeof(dst_path), "%s" CONFIG_TARGET_ROOTFS_PATH, live_rootfs_path);
-    if (common.copy_file(tarball_path, dst_path) != 0)
+    const char *format_name;
+    if (format == PAYLOAD_FORMAT_EXT4)
     {
-        LOG_ERROR("Failed to copy target rootfs tarball");
-        return -2;
+        char manifest_path[COMMON_MAX_PATH_LENGTH];
+        snprintf(dst_path, sizeof(dst_path), "%s" CONFIG_TARGET_ROOTFS_IMAGE_PATH, live_rootfs_path);
+        snprintf(manifest_path, sizeof(manifest_path), "%s" CONFIG_TARGET_ROOTFS_MANIFEST_PATH, live_rootfs_path);
+        if (image_target_rootfs(target_rootfs_path, dst_path, manifest_path, source_date_epoch) != 0)
+        {
+            LOG_ERROR("Failed to package target rootfs image");
+            return -2;
+        }
+        format_name = get_payload_format_name(format);
+    }
+    else
+    {
+        snprintf(
+            dst_path, sizeof(dst_path), "%s" CONFIG_TARGET_ROOTFS_PATH "%s",
+            live_rootfs_path, get_tarball_compression_extension(compression)
+        );
+        if (package_target_rootfs(target_rootfs_path, dst_path, compression, source_date_epoch) != 0)
+        {
+            LOG_ERROR("Failed to package target rootfs tarball");
+            return -2;
+        }
+        format_name = get_tarball_compression_name(compression);
+    }
+
+    // Record the format next to the payload for the installer.
+    char format_path[COMMON_MAX_PATH_LENGTH];
+    char format_line[16];
+    snprintf(format_path, sizeof(format_path), "%s" CONFIG_TARGET_ROOTFS_FORMAT_PATH, live_rootfs_path);
+    snprintf(format_line, sizeof(format_line), "%s\n", format_name);
+    if (common.write_file(format_path, format_line) != 0)
+    {
+        LOG_ERROR("Failed to record target rootfs payload format");
+        return -3;
+    }
+
+    // Mount the payload from the medium if it ships outside the squashfs,
+    // dropping the mount unit of an earlier attempt otherwise.
+    char unit_dir[COMMON_MAX_PATH_LENGTH];
+    snprintf(unit_dir, sizeof(unit_dir), "%s" CONFIG_LIVE_EMBED_UNIT_DIR, live_rootfs_path);
+    if (common.rm_rf(unit_dir) != 0 ||
+        (is_payload_on_media && write_payload_mount_unit(live_rootfs_path) != 0))
+    {
+        LOG_ERROR("Failed to write target payload mount unit");
+        return -4;
     }
 
-    LOG_INFO("Target rootfs tarball embedded successfully");
+    LOG_INFO("Target rootfs embedded successfully");
 
     return 0;
 }
@@ -1,16 +1,38 @@
 #pragma once
 
 /**
- * Embeds the target rootfs tarball into the live rootfs.
+ * Embeds the target rootfs into the live rootfs as a tarball or ext4 image.
  *
- * Copies the target rootfs tarball to the configured location within the
- * live rootfs so the installer can access it during installation.
+ * Packages the target rootfs straight to the configured location within the
+ * live rootfs so the installer can access it during installation, and
+ * records its format at CONFIG_TARGET_ROOTFS_FORMAT_PATH so the installer
+ * knows how to install it: the compression of the tarball at
+ * CONFIG_TARGET_ROOTFS_PATH, whose name ends in the extension of that
+ * compression, or "ext4" for an image at CONFIG_TARGET_ROOTFS_IMAGE_PATH
+ * described by the manifest at CONFIG_TARGET_ROOTFS_MANIFEST_PATH.
+ *
+ * When the payload ships on the ISO outside the live squashfs, a mount unit
+ * is installed that binds its directory on the boot medium over
+ * CONFIG_TARGET_PAYLOAD_DIR, so the installer finds it at the same paths.
  *
  * @param live_rootfs_path The path to the live rootfs directory.
- * @param tarball_path The path to the target rootfs tarball.
+ * @param target_rootfs_path The path to the target rootfs directory.
+ * @param format The format of the payload.
+ * @param compression The compression of the tarball, if the format is tar.
+ * @param is_payload_on_media Whether the payload ships outside the squashfs.
+ * @param source_date_epoch The time the payload timestamps are clamped to.
  *
  * @return - `0` - Indicates successful embedding.
  * @return - `-1` - Indicates directory creation failure.
- * @return - `-2` - Indicates copy failure.
+ * @return - `-2` - Indicates packaging failure.
+ * @return - `-3` - Indicates format file write failure.
+ * @return - `-4` - Indicates mount unit write failure.
  */
-int embed_target_rootfs(const char *live_rootfs_path, const char *tarball_path);
+int embed_target_rootfs(
+    const char *live_rootfs_path,
+    const char *target_rootfs_path,
+    PayloadFormat format,
+    TarballCompression compression,
+    int is_payload_on_media,
+    time_t source_date_epoch
+);
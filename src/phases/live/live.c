@@ -1,14 +1,16 @@
 /**
  * This code is responsible for orchestrating the live phase.
+ *
+ * The phase is split into steps that the build graph can overlap: once the
+ * live rootfs exists, bootloader packages, components and the target
+ * rootfs tarball each touch separate parts of it.
  */
 
 #include "all.h"
 
-int run_live_phase(
+int run_live_rootfs_step(
     const char *base_rootfs_dir,
     const char *rootfs_dir,
-    const char *tarball_path,
-    const char *components_dir,
     const char *version
 )
 {
@@ -26,32 +28,58 @@ int run_live_phase(
         return -2;
     }
 
-    // Embed the target rootfs tarball.
-    if (embed_target_rootfs(rootfs_dir, tarball_path) != 0)
+    LOG_INFO("Phase 4: Live rootfs created");
+
+    return 0;
+}
+
+int run_live_embed_step(
+    const char *rootfs_dir,
+    const char *target_rootfs_dir,
+    PayloadFormat format,
+    TarballCompression compression,
+    int is_payload_on_media,
+    time_t source_date_epoch
+)
+{
+    // Embed the target rootfs as a tarball or ext4 image.
+    if (embed_target_rootfs(
+            rootfs_dir, target_rootfs_dir, format, compression,
+            is_payload_on_media, source_date_epoch) != 0)
     {
         LOG_ERROR("Failed to embed target rootfs");
-        return -3;
+        return -1;
     }
 
+    return 0;
+}
+
+int run_live_components_step(const char *rootfs_dir, const char *components_dir)
+{
     // Install LimeOS components (installer, etc.).
     if (install_live_components(rootfs_dir, components_dir) != 0)
     {
         LOG_ERROR("Failed to install components");
-        return -4;
+        return -1;
     }
 
     // Configure autostart to launch installer on boot.
     if (configure_live_autostart(rootfs_dir) != 0)
     {
         LOG_ERROR("Failed to configure autostart");
-        return -5;
+        return -2;
     }
 
+    return 0;
+}
+
+int run_live_packages_step(const char *rootfs_dir)
+{
     // Clean up apt cache and lists before bundling bootloader packages.
     if (cleanup_apt_directories(rootfs_dir) != 0)
     {
         LOG_ERROR("Failed to cleanup apt directories");
-        return -6;
+        return -1;
     }
 
     // Bundle boot-mode-specific packages (GRUB for BIOS/EFI). Must happen after
@@ -59,10 +87,8 @@ int run_live_phase(
     if (bundle_live_packages(rootfs_dir) != 0)
     {
         LOG_ERROR("Failed to bundle packages");
-        return -7;
+        return -2;
     }
 
-    LOG_INFO("Phase 4 complete: Live rootfs created");
-    
     return 0;
 }
@@ -1,31 +1,81 @@
 #pragma once
 
 /**
- * Runs the live phase.
+ * The revisions of the live steps.
  *
- * Copies the base rootfs, installs live-specific packages, embeds the
- * target tarball, installs LimeOS components, configures init, and bundles
- * boot-mode-specific packages.
+ * The stored layer of each step is keyed by its revision, so bump one
+ * whenever its step, or the code it calls, changes what it produces.
+ */
+#define LIVE_ROOTFS_STEP_REVISION 1
+#define LIVE_PACKAGES_STEP_REVISION 1
+#define LIVE_COMPONENTS_STEP_REVISION 2
+#define LIVE_EMBED_STEP_REVISION 6
+
+/**
+ * Runs the live rootfs step of the live phase.
+ *
+ * Derives the live rootfs from the base rootfs, installs live-specific
+ * packages, and configures it. The other live steps build on its result.
  *
- * @param base_rootfs_dir The path to the base rootfs to copy from.
+ * @param base_rootfs_dir The path to the base rootfs to derive from.
  * @param rootfs_dir The directory for the live rootfs.
- * @param tarball_path The path to the target tarball to embed.
- * @param components_dir The directory containing downloaded components.
  * @param version The version string for OS branding.
  *
  * @return - `0` - Indicates success.
  * @return - `-1` - Indicates live rootfs creation failure.
  * @return - `-2` - Indicates live rootfs configuration failure.
- * @return - `-3` - Indicates target rootfs embedding failure.
- * @return - `-4` - Indicates component installation failure.
- * @return - `-5` - Indicates autostart configuration failure.
- * @return - `-6` - Indicates APT directory cleanup failure.
- * @return - `-7` - Indicates package bundling failure.
  */
-int run_live_phase(
+int run_live_rootfs_step(
     const char *base_rootfs_dir,
     const char *rootfs_dir,
-    const char *tarball_path,
-    const char *components_dir,
     const char *version
 );
+
+/**
+ * Runs the embed step of the live phase.
+ *
+ * @param rootfs_dir The directory of the live rootfs.
+ * @param target_rootfs_dir The directory of the target rootfs to embed.
+ * @param format The format of the target payload.
+ * @param compression The compression of the target tarball.
+ * @param is_payload_on_media Whether the payload ships outside the squashfs.
+ * @param source_date_epoch The time the payload timestamps are clamped to.
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates target rootfs embedding failure.
+ */
+int run_live_embed_step(
+    const char *rootfs_dir,
+    const char *target_rootfs_dir,
+    PayloadFormat format,
+    TarballCompression compression,
+    int is_payload_on_media,
+    time_t source_date_epoch
+);
+
+/**
+ * Runs the components step of the live phase.
+ *
+ * Installs LimeOS components and configures init to launch the installer.
+ *
+ * @param rootfs_dir The directory of the live rootfs.
+ * @param components_dir The directory containing downloaded components.
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates component installation failure.
+ * @return - `-2` - Indicates autostart configuration failure.
+ */
+int run_live_components_step(const char *rootfs_dir, const char *components_dir);
+
+/**
+ * Runs the packages step of the live phase.
+ *
+ * Cleans the APT directories, then bundles boot-mode-specific packages.
+ *
+ * @param rootfs_dir The directory of the live rootfs.
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates APT directory cleanup failure.
+ * @return - `-2` - Indicates package bundling failure.
+ */
+int run_live_packages_step(const char *rootfs_dir);
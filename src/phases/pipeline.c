@@ -0,0 +1,891 @@
+/**
+ * This code is responsible for declaring the build phases and their
+ * sub-steps as a dependency graph over the artifacts they exchange.
+ *
+ * Every step may be rerun on top of what a failed attempt left behind, so
+ * steps that create a tree start by discarding any earlier one, and steps
+ * working in the target or live rootfs mount its overlay again if a previous
+ * builder process left it unmounted.
+ *
+ * Steps other than preparation are cached in the layer store. The base step
+ * stores its whole output, the target and live rootfs steps store their
+ * overlay upper layers, and the steps finishing the live rootfs store the
+ * paths they own, since they work side by side in one tree.
+ */
+
+#include "all.h"
+
+/** The configuration that shapes the branding of both rootfs. */
+#define PIPELINE_BRANDING_CONFIG \
+    CONFIG_OS_NAME "\n" CONFIG_OS_ID "\n" CONFIG_OS_HOME_URL "\n" \
+    CONFIG_OS_BASE_ID "\n" CONFIG_PLYMOUTH_THEME_NAME "\n" \
+    CONFIG_PLYMOUTH_DISPLAY_NAME "\n" CONFIG_PLYMOUTH_DESCRIPTION "\n" \
+    CONFIG_PLYMOUTH_THEMES_DIR "\n"
+
+/** The live rootfs directories owned by the packages step. */
+static const char *const LIVE_PACKAGES_PATHS[] = {
+    "/var/cache/apt", "/var/lib/apt/lists", NULL
+};
+
+/** The number of component binaries the components step may install. */
+#define LIVE_COMPONENTS_BINARY_COUNT \
+    (CONFIG_REQUIRED_COMPONENTS_COUNT + CONFIG_OPTIONAL_COMPONENTS_COUNT)
+
+/** The live rootfs units the components step writes, enables or removes. */
+static const char *const LIVE_COMPONENTS_UNIT_PATHS[] = {
+    "/etc/systemd/system/" CONFIG_INSTALLER_SERVICE_NAME ".service",
+    "/etc/systemd/system/multi-user.target.wants/" CONFIG_INSTALLER_SERVICE_NAME ".service",
+    "/etc/systemd/system/default.target",
+    "/etc/systemd/system/getty.target.wants/getty@tty1.service",
+    NULL
+};
+
+/**
+ * A type representing the live rootfs paths owned by the components step.
+ *
+ * Only the files the step installs are listed, since the directories
+ * holding them also hold files of the base and live rootfs steps.
+ */
+typedef struct LiveComponentsPaths
+{
+    char binary_paths[LIVE_COMPONENTS_BINARY_COUNT][COMMON_MAX_PATH_LENGTH];
+    const char *paths[
+        LIVE_COMPONENTS_BINARY_COUNT +
+        sizeof(LIVE_COMPONENTS_UNIT_PATHS) / sizeof(LIVE_COMPONENTS_UNIT_PATHS[0])
+    ];
+} LiveComponentsPaths;
+
+/** The live rootfs directories owned by the embed step. */
+static const char *const LIVE_EMBED_PATHS[] = {
+    CONFIG_TARGET_PAYLOAD_DIR, CONFIG_LIVE_EMBED_UNIT_DIR, NULL
+};
+
+static int hash_string(EVP_MD_CTX *digest_context, const char *value)
+{
+    return EVP_DigestUpdate(digest_context, value, strlen(value) + 1) == 1 ? 0 : -1;
+}
+
+static int hash_revision(EVP_MD_CTX *digest_context, int revision)
+{
+    char value[32];
+    snprintf(value, sizeof(value), "revision=%d", revision);
+    return hash_string(digest_context, value);
+}
+
+static int hash_reproducibility(EVP_MD_CTX *digest_context, const BuildContext *context)
+{
+    char value[64];
+    snprintf(
+        value, sizeof(value), "epoch=%lld verify=%d",
+        (long long)context->source_date_epoch, context->is_verifying_reproducible
+    );
+    return hash_string(digest_context, value);
+}
+
+static int digest_output(const char *path, char *out_digest)
+{
+    EVP_MD_CTX *digest_context = EVP_MD_CTX_new();
+    if (!digest_context || EVP_DigestInit_ex(digest_context, EVP_sha256(), NULL) != 1)
+    {
+        EVP_MD_CTX_free(digest_context);
+        return -1;
+    }
+
+    // Hash a directory by its tree and anything else by its contents.
+    struct stat path_stat;
+    int result = stat(path, &path_stat) == 0 ? 0 : -1;
+    if (result == 0)
+    {
+        result = S_ISDIR(path_stat.st_mode) ?
+            hash_tree_contents(digest_context, path) :
+            hash_file_contents(digest_context, path);
+    }
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_length = 0;
+    if (result == 0 && EVP_DigestFinal_ex(digest_context, digest, &digest_length) != 1)
+    {
+        result = -1;
+    }
+    EVP_MD_CTX_free(digest_context);
+    if (result != 0)
+    {
+        return -1;
+    }
+
+    // Encode the digest as hex.
+    for (unsigned int i = 0; i < digest_length; i++)
+    {
+        snprintf(out_digest + i * 2, 3, "%02x", digest[i]);
+    }
+
+    return 0;
+}
+
+static int compare_output(const char *name, const char *digest, const char *rebuilt_path)
+{
+    char rebuilt_digest[COMMON_SHA256_HEX_LENGTH];
+    if (digest_output(rebuilt_path, rebuilt_digest) != 0)
+    {
+        LOG_ERROR("Failed to hash the rebuilt %s", name);
+        return -1;
+    }
+    if (strcmp(digest, rebuilt_digest) != 0)
+    {
+        LOG_ERROR("The %s is not reproducible: %s, then %s", name, digest, rebuilt_digest);
+        return -1;
+    }
+
+    LOG_INFO("The %s is reproducible: %s", name, digest);
+    return 0;
+}
+
+static int run_preparation_step(void *argument)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+
+    // Fetch components from GitHub or the mirror.
+    if (run_preparation_phase(context->version, context->components_dir) != 0)
+    {
+        return -1;
+    }
+
+    // Record the fetched component releases, if requested. This must run in
+    // the same step, since the releases are recorded in this process.
+    if (context->write_lock_path && save_component_locks(context->write_lock_path) != 0)
+    {
+        return -2;
+    }
+
+    return 0;
+}
+
+static int release_derived_rootfs(const BuildContext *context)
+{
+    // Release the target and live overlays an earlier run may have left
+    // mounted on the base rootfs, since the lower tree of a mounted overlay
+    // must not change.
+    if (release_rootfs(context->target_rootfs_dir) != 0 ||
+        release_rootfs(context->live_rootfs_dir) != 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+static int run_base_step(void *argument)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+
+    // Discard a base rootfs left by an interrupted attempt, along with the
+    // overlays on it.
+    if (release_derived_rootfs(context) != 0 || common.rm_rf(context->base_rootfs_dir) != 0)
+    {
+        return -1;
+    }
+
+    return run_base_phase(context->base_rootfs_dir);
+}
+
+static int hash_base_inputs(void *argument, EVP_MD_CTX *digest_context)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+
+    // Hash the base phase inputs, read before the graph started, since the
+    // mirror is queried over the network.
+    if (context->base_key[0] == '\0')
+    {
+        return -1;
+    }
+
+    return hash_string(digest_context, context->base_key);
+}
+
+static int record_base(void *argument, const char *layer_path)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+    char stored_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(stored_path, sizeof(stored_path), "%s/rootfs", layer_path);
+    return copy_tree(context->base_rootfs_dir, stored_path);
+}
+
+static int replay_base(void *argument, const char *layer_path)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+    char stored_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(stored_path, sizeof(stored_path), "%s/rootfs", layer_path);
+    if (release_derived_rootfs(context) != 0 || common.rm_rf(context->base_rootfs_dir) != 0)
+    {
+        return -1;
+    }
+    return copy_tree(stored_path, context->base_rootfs_dir);
+}
+
+static int record_rootfs_upper(const char *rootfs_dir, const char *layer_path)
+{
+    // Only an overlay keeps the step's changes apart from the base rootfs.
+    char upper_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(upper_path, sizeof(upper_path), "%s.layer/upper", rootfs_dir);
+    if (!common.file_exists(upper_path))
+    {
+        LOG_INFO("%s is a copy rather than an overlay, not storing it", rootfs_dir);
+        return -1;
+    }
+
+    char stored_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(stored_path, sizeof(stored_path), "%s/upper", layer_path);
+    return copy_tree(upper_path, stored_path);
+}
+
+static int replay_rootfs_upper(
+    const char *base_rootfs_dir,
+    const char *rootfs_dir,
+    const char *layer_path
+)
+{
+    // Recreate the overlay's upper layer from the stored one.
+    char layer_dir[COMMON_MAX_PATH_LENGTH];
+    char upper_path[COMMON_MAX_PATH_LENGTH];
+    char stored_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(layer_dir, sizeof(layer_dir), "%s.layer", rootfs_dir);
+    snprintf(upper_path, sizeof(upper_path), "%s/upper", layer_dir);
+    snprintf(stored_path, sizeof(stored_path), "%s/upper", layer_path);
+    if (release_rootfs(rootfs_dir) != 0 ||
+        common.mkdir_p(layer_dir) != 0 ||
+        copy_tree(stored_path, upper_path) != 0)
+    {
+        return -1;
+    }
+
+    // Mount it over the base rootfs.
+    if (attach_rootfs(base_rootfs_dir, rootfs_dir) != 0)
+    {
+        return -2;
+    }
+
+    return 0;
+}
+
+static int run_target_step(void *argument)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+
+    // Discard a target rootfs left by an interrupted attempt.
+    if (release_rootfs(context->target_rootfs_dir) != 0)
+    {
+        return -1;
+    }
+
+    return run_target_phase(
+        context->base_rootfs_dir, context->target_rootfs_dir, context->version
+    );
+}
+
+static int hash_target_inputs(void *argument, EVP_MD_CTX *digest_context)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+    if (hash_revision(digest_context, TARGET_PHASE_REVISION) != 0 ||
+        hash_string(digest_context, context->version) != 0 ||
+        hash_string(digest_context, CONFIG_TARGET_PACKAGES) != 0 ||
+        hash_string(digest_context, CONFIG_TARGET_KERNEL_PARAMS) != 0 ||
+        hash_string(digest_context, CONFIG_TARGET_DEDUP_PATH) != 0 ||
+        hash_string(digest_context, PIPELINE_BRANDING_CONFIG) != 0 ||
+        hash_file_contents(digest_context, CONFIG_SPLASH_LOGO_PATH) != 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+static int record_target(void *argument, const char *layer_path)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+    return record_rootfs_upper(context->target_rootfs_dir, layer_path);
+}
+
+static int replay_target(void *argument, const char *layer_path)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+    return replay_rootfs_upper(context->base_rootfs_dir, context->target_rootfs_dir, layer_path);
+}
+
+static int run_live_rootfs(void *argument)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+
+    // Discard a live rootfs left by an interrupted attempt.
+    if (release_rootfs(context->live_rootfs_dir) != 0)
+    {
+        return -1;
+    }
+
+    return run_live_rootfs_step(
+        context->base_rootfs_dir, context->live_rootfs_dir, context->version
+    );
+}
+
+static int hash_live_rootfs_inputs(void *argument, EVP_MD_CTX *digest_context)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+    if (hash_revision(digest_context, LIVE_ROOTFS_STEP_REVISION) != 0 ||
+        hash_string(digest_context, context->version) != 0 ||
+        hash_string(digest_context, CONFIG_LIVE_PACKAGES) != 0 ||
+        hash_string(digest_context, PIPELINE_BRANDING_CONFIG) != 0 ||
+        hash_file_contents(digest_context, CONFIG_SPLASH_LOGO_PATH) != 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+static int record_live_rootfs(void *argument, const char *layer_path)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+    return record_rootfs_upper(context->live_rootfs_dir, layer_path);
+}
+
+static int replay_live_rootfs(void *argument, const char *layer_path)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+    return replay_rootfs_upper(context->base_rootfs_dir, context->live_rootfs_dir, layer_path);
+}
+
+static int verify_payload_reproducible(const BuildContext *context)
+{
+    // Embed the target rootfs again into a scratch tree.
+    char scratch_dir[COMMON_MAX_PATH_LENGTH];
+    snprintf(scratch_dir, sizeof(scratch_dir), "%s.verify", context->live_rootfs_dir);
+    if (common.rm_rf(scratch_dir) != 0 ||
+        embed_target_rootfs(
+            scratch_dir, context->target_rootfs_dir, context->payload_format,
+            context->target_compression, context->is_payload_on_media,
+            context->source_date_epoch) != 0)
+    {
+        LOG_ERROR("Failed to embed the target rootfs a second time");
+        common.rm_rf(scratch_dir);
+        return -1;
+    }
+
+    // Compare both payload directories.
+    char payload_dir[COMMON_MAX_PATH_LENGTH];
+    char rebuilt_payload_dir[COMMON_MAX_PATH_LENGTH];
+    snprintf(payload_dir, sizeof(payload_dir), "%s" CONFIG_TARGET_PAYLOAD_DIR, context->live_rootfs_dir);
+    snprintf(rebuilt_payload_dir, sizeof(rebuilt_payload_dir), "%s" CONFIG_TARGET_PAYLOAD_DIR, scratch_dir);
+    char digest[COMMON_SHA256_HEX_LENGTH];
+    int result = -1;
+    if (digest_output(payload_dir, digest) != 0)
+    {
+        LOG_ERROR("Failed to hash the target payload");
+    }
+    else
+    {
+        result = compare_output("target payload", digest, rebuilt_payload_dir);
+    }
+    common.rm_rf(scratch_dir);
+
+    return result;
+}
+
+static int run_live_embed(void *argument)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+
+    // Mount both rootfs again if an earlier run left them detached.
+    if (attach_rootfs(context->base_rootfs_dir, context->live_rootfs_dir) != 0 ||
+        attach_rootfs(context->base_rootfs_dir, context->target_rootfs_dir) != 0)
+    {
+        return -1;
+    }
+
+    if (run_live_embed_step(
+            context->live_rootfs_dir, context->target_rootfs_dir, context->payload_format,
+            context->target_compression, context->is_payload_on_media,
+            context->source_date_epoch) != 0)
+    {
+        return -1;
+    }
+
+    // Embed the payload a second time and compare, if asked to.
+    if (context->is_verifying_reproducible && verify_payload_reproducible(context) != 0)
+    {
+        return -1;
+    }
+
+    // Release the target rootfs now that it is packaged.
+    if (release_rootfs(context->target_rootfs_dir) != 0)
+    {
+        LOG_WARNING("Failed to release target rootfs");
+    }
+
+    return 0;
+}
+
+static int hash_live_embed_inputs(void *argument, EVP_MD_CTX *digest_context)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+    char format[128];
+    snprintf(
+        format, sizeof(format), "%s %s gzip=%d zstd=%d block=%d headroom=%d",
+        get_payload_format_name(context->payload_format),
+        get_tarball_compression_name(context->target_compression),
+        CONFIG_TARGET_GZIP_LEVEL, CONFIG_TARGET_ZSTD_LEVEL,
+        CONFIG_TARGET_IMAGE_BLOCK_SIZE, CONFIG_TARGET_IMAGE_HEADROOM
+    );
+    if (hash_revision(digest_context, LIVE_EMBED_STEP_REVISION) != 0 ||
+        hash_reproducibility(digest_context, context) != 0 ||
+        hash_string(digest_context, CONFIG_TARGET_ROOTFS_PATH) != 0 ||
+        hash_string(digest_context, CONFIG_TARGET_ROOTFS_IMAGE_PATH) != 0 ||
+        hash_string(digest_context, CONFIG_TARGET_ROOTFS_MANIFEST_PATH) != 0 ||
+        hash_string(digest_context, CONFIG_TARGET_ROOTFS_FORMAT_PATH) != 0 ||
+        hash_string(digest_context, format) != 0 ||
+        hash_string(digest_context, context->is_payload_on_media ? "payload=media" : "payload=squashfs") != 0 ||
+        hash_string(digest_context, CONFIG_ISO_PAYLOAD_DIR) != 0 ||
+        hash_string(digest_context, CONFIG_LIVE_MEDIUM_PATH) != 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+static int record_live_embed(void *argument, const char *layer_path)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+    return record_rootfs_paths(context->live_rootfs_dir, LIVE_EMBED_PATHS, layer_path);
+}
+
+static int replay_live_embed(void *argument, const char *layer_path)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+
+    // Mount the live rootfs again if an earlier run left it detached.
+    if (attach_rootfs(context->base_rootfs_dir, context->live_rootfs_dir) != 0)
+    {
+        return -1;
+    }
+
+    return replay_rootfs_paths(context->live_rootfs_dir, LIVE_EMBED_PATHS, layer_path);
+}
+
+static int run_live_components(void *argument)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+
+    // Mount the live rootfs again if an earlier run left it detached.
+    if (attach_rootfs(context->base_rootfs_dir, context->live_rootfs_dir) != 0)
+    {
+        return -1;
+    }
+
+    return run_live_components_step(context->live_rootfs_dir, context->components_dir);
+}
+
+static int hash_live_components_inputs(void *argument, EVP_MD_CTX *digest_context)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+    if (hash_revision(digest_context, LIVE_COMPONENTS_STEP_REVISION) != 0 ||
+        hash_string(digest_context, CONFIG_INSTALL_BIN_PATH) != 0 ||
+        hash_string(digest_context, CONFIG_INSTALLER_SERVICE_NAME) != 0)
+    {
+        return -1;
+    }
+
+    // Hash the component binaries the preparation step fetched.
+    return hash_tree_contents(digest_context, context->components_dir);
+}
+
+static void list_live_components_paths(LiveComponentsPaths *out_paths)
+{
+    // List the binary of every component, including optional ones that
+    // were skipped, so replaying the layer removes them.
+    int path_count = 0;
+    for (int i = 0; i < LIVE_COMPONENTS_BINARY_COUNT; i++)
+    {
+        const Component *component = i < CONFIG_REQUIRED_COMPONENTS_COUNT
+            ? &CONFIG_REQUIRED_COMPONENTS[i]
+            : &CONFIG_OPTIONAL_COMPONENTS[i - CONFIG_REQUIRED_COMPONENTS_COUNT];
+        snprintf(
+            out_paths->binary_paths[i], sizeof(out_paths->binary_paths[i]),
+            CONFIG_INSTALL_BIN_PATH "/%s", component->binary_name
+        );
+        out_paths->paths[path_count++] = out_paths->binary_paths[i];
+    }
+
+    // List the units, ending with the terminating NULL.
+    for (int i = 0; LIVE_COMPONENTS_UNIT_PATHS[i]; i++)
+    {
+        out_paths->paths[path_count++] = LIVE_COMPONENTS_UNIT_PATHS[i];
+    }
+    out_paths->paths[path_count] = NULL;
+}
+
+static int record_live_components(void *argument, const char *layer_path)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+    LiveComponentsPaths paths;
+    list_live_components_paths(&paths);
+    return record_rootfs_paths(context->live_rootfs_dir, paths.paths, layer_path);
+}
+
+static int replay_live_components(void *argument, const char *layer_path)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+
+    // Mount the live rootfs again if an earlier run left it detached.
+    if (attach_rootfs(context->base_rootfs_dir, context->live_rootfs_dir) != 0)
+    {
+        return -1;
+    }
+
+    LiveComponentsPaths paths;
+    list_live_components_paths(&paths);
+    return replay_rootfs_paths(context->live_rootfs_dir, paths.paths, layer_path);
+}
+
+static int run_live_packages(void *argument)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+
+    // Mount the live rootfs again if an earlier run left it detached.
+    if (attach_rootfs(context->base_rootfs_dir, context->live_rootfs_dir) != 0)
+    {
+        return -1;
+    }
+
+    return run_live_packages_step(context->live_rootfs_dir);
+}
+
+static int hash_live_packages_inputs(void *argument, EVP_MD_CTX *digest_context)
+{
+    (void)argument;
+    if (hash_revision(digest_context, LIVE_PACKAGES_STEP_REVISION) != 0 ||
+        hash_string(digest_context, CONFIG_BIOS_PACKAGES) != 0 ||
+        hash_string(digest_context, CONFIG_EFI_PACKAGES) != 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+static int record_live_packages(void *argument, const char *layer_path)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+    return record_rootfs_paths(context->live_rootfs_dir, LIVE_PACKAGES_PATHS, layer_path);
+}
+
+static int replay_live_packages(void *argument, const char *layer_path)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+
+    // Mount the live rootfs again if an earlier run left it detached.
+    if (attach_rootfs(context->base_rootfs_dir, context->live_rootfs_dir) != 0)
+    {
+        return -1;
+    }
+
+    return replay_rootfs_paths(context->live_rootfs_dir, LIVE_PACKAGES_PATHS, layer_path);
+}
+
+static int verify_squashfs_reproducible(const BuildContext *context, const char *digest)
+{
+    // Build the squashfs a second time.
+    char rebuilt_squashfs_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(rebuilt_squashfs_path, sizeof(rebuilt_squashfs_path), "%s.verify.squashfs", context->live_rootfs_dir);
+    int result = 0;
+    if (create_squashfs(
+            context->live_rootfs_dir, rebuilt_squashfs_path,
+            context->is_payload_on_media, context->source_date_epoch) != 0)
+    {
+        LOG_ERROR("Failed to build the squashfs a second time");
+        result = -1;
+    }
+
+    // Compare it with the squashfs on the ISO.
+    if (result == 0)
+    {
+        result = compare_output("squashfs", digest, rebuilt_squashfs_path);
+    }
+    common.rm_file(rebuilt_squashfs_path);
+
+    return result;
+}
+
+static int run_assembly_step(void *argument)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+
+    // Mount the live rootfs again if an earlier run left it detached.
+    if (attach_rootfs(context->base_rootfs_dir, context->live_rootfs_dir) != 0)
+    {
+        return -1;
+    }
+
+    // Keep the digest of the squashfs on the ISO to verify it, if asked to.
+    char squashfs_digest[COMMON_SHA256_HEX_LENGTH];
+    if (run_assembly_phase(
+            context->live_rootfs_dir, context->iso_path, context->is_payload_on_media,
+            context->source_date_epoch,
+            context->is_verifying_reproducible ? squashfs_digest : NULL) != 0)
+    {
+        return -1;
+    }
+
+    // Build the squashfs a second time and compare, if asked to.
+    if (context->is_verifying_reproducible &&
+        verify_squashfs_reproducible(context, squashfs_digest) != 0)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int hash_assembly_inputs(void *argument, EVP_MD_CTX *digest_context)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+    if (hash_revision(digest_context, ASSEMBLY_PHASE_REVISION) != 0 ||
+        hash_reproducibility(digest_context, context) != 0 ||
+        hash_string(digest_context, context->is_payload_on_media ? "payload=media" : "payload=squashfs") != 0 ||
+        hash_string(digest_context, CONFIG_ISO_PAYLOAD_DIR) != 0 ||
+        hash_string(digest_context, CONFIG_LIVE_KERNEL_PARAMS) != 0 ||
+        hash_string(digest_context, CONFIG_GRUB_MENU_ENTRY_NAME) != 0 ||
+        hash_string(digest_context, CONFIG_BOOT_KERNEL_PATH) != 0 ||
+        hash_string(digest_context, CONFIG_BOOT_INITRD_PATH) != 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+static int record_assembly(void *argument, const char *layer_path)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+    char stored_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(stored_path, sizeof(stored_path), "%s/image.iso", layer_path);
+    return clone_or_copy_file(context->iso_path, stored_path);
+}
+
+static int replay_assembly(void *argument, const char *layer_path)
+{
+    const BuildContext *context = (const BuildContext *)argument;
+    char stored_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(stored_path, sizeof(stored_path), "%s/image.iso", layer_path);
+    if (clone_or_copy_file(stored_path, context->iso_path) != 0)
+    {
+        return -1;
+    }
+    LOG_INFO("Reused the ISO of an earlier build with the same inputs: %s", context->iso_path);
+    return 0;
+}
+
+/**
+ * The build steps, with the artifacts each consumes and produces and the
+ * hooks caching their output.
+ */
+static const BuildStep BUILD_STEPS[] = {
+    {
+        "preparation", run_preparation_step,
+        { NULL },
+        { "components", NULL },
+        NULL, NULL, NULL, 0
+    },
+    {
+        "base", run_base_step,
+        { NULL },
+        { "base-rootfs", NULL },
+        hash_base_inputs, record_base, replay_base, 1
+    },
+    {
+        "target", run_target_step,
+        { "base-rootfs", NULL },
+        { "target-rootfs", NULL },
+        hash_target_inputs, record_target, replay_target, 0
+    },
+    {
+        "live-rootfs", run_live_rootfs,
+        { "base-rootfs", NULL },
+        { "live-rootfs", NULL },
+        hash_live_rootfs_inputs, record_live_rootfs, replay_live_rootfs, 0
+    },
+    {
+        "live-packages", run_live_packages,
+        { "live-rootfs", NULL },
+        { "live-packages", NULL },
+        hash_live_packages_inputs, record_live_packages, replay_live_packages, 0
+    },
+    {
+        "live-components", run_live_components,
+        { "live-rootfs", "components", NULL },
+        { "live-components", NULL },
+        hash_live_components_inputs, record_live_components, replay_live_components, 0
+    },
+    {
+        "live-embed", run_live_embed,
+        { "live-rootfs", "target-rootfs", NULL },
+        { "live-embed", NULL },
+        hash_live_embed_inputs, record_live_embed, replay_live_embed, 0
+    },
+    {
+        "assembly", run_assembly_step,
+        { "live-packages", "live-components", "live-embed", NULL },
+        { "iso", NULL },
+        hash_assembly_inputs, record_assembly, replay_assembly, 1
+    }
+};
+
+/** The number of build steps. */
+#define BUILD_STEPS_COUNT (int)(sizeof(BUILD_STEPS) / sizeof(BUILD_STEPS[0]))
+
+static int build_pipeline_fingerprint(const BuildContext *context, char *out_fingerprint)
+{
+    // Identify the builder binary, since its configuration and step code
+    // are inputs to every step.
+    struct stat builder_stat;
+    if (stat("/proc/self/exe", &builder_stat) != 0)
+    {
+        return -1;
+    }
+    char inputs[COMMON_MAX_COMMAND_LENGTH];
+    int length = snprintf(
+        inputs, sizeof(inputs),
+        "version=%s\nmirror=%s\nformat=%s\ncompression=%s\npayload=%s\n"
+        "epoch=%lld\nverify=%d\nbuilder=%lld:%lld.%09ld\n",
+        context->version, context->mirror ? context->mirror : "",
+        get_payload_format_name(context->payload_format),
+        get_tarball_compression_name(context->target_compression),
+        context->is_payload_on_media ? "media" : "squashfs",
+        (long long)context->source_date_epoch, context->is_verifying_reproducible,
+        (long long)builder_stat.st_size,
+        (long long)builder_stat.st_mtim.tv_sec, builder_stat.st_mtim.tv_nsec
+    );
+    if (length < 0 || (size_t)length >= sizeof(inputs))
+    {
+        return -1;
+    }
+
+    EVP_MD_CTX *digest_context = EVP_MD_CTX_new();
+    if (!digest_context || EVP_DigestInit_ex(digest_context, EVP_sha256(), NULL) != 1)
+    {
+        EVP_MD_CTX_free(digest_context);
+        return -1;
+    }
+
+    // Hash the inputs, with the pinned releases if a lockfile is used.
+    int result = 0;
+    if (EVP_DigestUpdate(digest_context, inputs, (size_t)length) != 1 ||
+        (context->lock_path && hash_file_contents(digest_context, context->lock_path) != 0))
+    {
+        result = -1;
+    }
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_length = 0;
+    if (result == 0 && EVP_DigestFinal_ex(digest_context, digest, &digest_length) != 1)
+    {
+        result = -1;
+    }
+    EVP_MD_CTX_free(digest_context);
+    if (result != 0)
+    {
+        return -1;
+    }
+
+    // Encode the digest as hex.
+    for (unsigned int i = 0; i < digest_length; i++)
+    {
+        snprintf(out_fingerprint + i * 2, 3, "%02x", digest[i]);
+    }
+
+    return 0;
+}
+
+int get_source_date_epoch(const char *version, time_t *out_epoch)
+{
+    // Prefer the epoch the environment sets, as reproducible builds do.
+    const char *environment_epoch = getenv("SOURCE_DATE_EPOCH");
+    if (environment_epoch && environment_epoch[0] != '\0')
+    {
+        char *end = NULL;
+        errno = 0;
+        long long epoch = strtoll(environment_epoch, &end, 10);
+        if (errno != 0 || *end != '\0' || epoch < 0)
+        {
+            return -1;
+        }
+        *out_epoch = (time_t)epoch;
+        return 0;
+    }
+
+    // Derive it from the version otherwise.
+    unsigned int major = 0;
+    unsigned int minor = 0;
+    unsigned int patch = 0;
+    if (sscanf(common.strip_version_prefix(version), "%u.%u.%u", &major, &minor, &patch) != 3)
+    {
+        return -2;
+    }
+    *out_epoch = (time_t)(CONFIG_SOURCE_DATE_EPOCH_BASE +
+        major * 1000000LL + minor * 1000LL + patch);
+
+    return 0;
+}
+
+int run_build_pipeline(const BuildContext *context, int max_jobs)
+{
+    // Fingerprint the inputs every checkpoint depends on.
+    const char *checkpoint_dir = NULL;
+    char fingerprint[COMMON_SHA256_HEX_LENGTH] = "";
+    if (context->checkpoint_dir[0] != '\0')
+    {
+        if (build_pipeline_fingerprint(context, fingerprint) != 0)
+        {
+            LOG_ERROR("Failed to fingerprint the build inputs");
+            return -1;
+        }
+        checkpoint_dir = context->checkpoint_dir;
+    }
+
+    // Key the base rootfs before the graph starts, since reading the
+    // mirror's Release date blocks, and the scheduler hashes step inputs
+    // while it drains the output of running steps.
+    BuildContext step_context = *context;
+    if (build_base_snapshot_key(step_context.base_key, sizeof(step_context.base_key)) != 0)
+    {
+        LOG_WARNING("Could not read the Debian Release date");
+        step_context.base_key[0] = '\0';
+    }
+
+    int result = run_build_graph(
+        BUILD_STEPS, BUILD_STEPS_COUNT, &step_context, max_jobs,
+        context->log_dir, checkpoint_dir, fingerprint
+    );
+    if (result == -4)
+    {
+        return -2;
+    }
+    return result == 0 ? 0 : -1;
+}
+
+int clean_build_pipeline(const BuildContext *context)
+{
+    // Release the rootfs overlays before the base rootfs beneath them.
+    int result = 0;
+    if (release_derived_rootfs(context) != 0)
+    {
+        result = -1;
+    }
+
+    // Remove the remaining trees and artifacts, and the checkpoints that
+    // refer to them.
+    const char *paths[] = {
+        context->base_rootfs_dir,
+        context->components_dir,
+        context->checkpoint_dir
+    };
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i++)
+    {
+        if (paths[i][0] != '\0' && common.rm_rf(paths[i]) != 0)
+        {
+            result = -1;
+        }
+    }
+
+    return result;
+}
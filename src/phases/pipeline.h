@@ -0,0 +1,84 @@
+#pragma once
+
+/**
+ * A type representing the inputs and paths shared by every build step.
+ */
+typedef struct BuildContext
+{
+    const char *version;
+    const char *mirror;
+    const char *lock_path;
+    const char *write_lock_path;
+    PayloadFormat payload_format;
+    TarballCompression target_compression;
+    int is_payload_on_media;
+    time_t source_date_epoch;
+    int is_verifying_reproducible;
+    char base_key[SNAPSHOT_KEY_LENGTH];
+    char components_dir[COMMON_MAX_PATH_LENGTH];
+    char base_rootfs_dir[COMMON_MAX_PATH_LENGTH];
+    char target_rootfs_dir[COMMON_MAX_PATH_LENGTH];
+    char live_rootfs_dir[COMMON_MAX_PATH_LENGTH];
+    char iso_path[COMMON_MAX_PATH_LENGTH];
+    char log_dir[COMMON_MAX_PATH_LENGTH];
+    char checkpoint_dir[COMMON_MAX_PATH_LENGTH];
+} BuildContext;
+
+/**
+ * Gets the time every timestamp of the build output is set or clamped to.
+ *
+ * A SOURCE_DATE_EPOCH in the environment is used as is. Otherwise the time
+ * is derived from the version, counting up from
+ * CONFIG_SOURCE_DATE_EPOCH_BASE, so rebuilding a version gives the same
+ * timestamps.
+ *
+ * @param version The version being built (X.Y.Z or vX.Y.Z).
+ * @param out_epoch The time, in seconds since the Unix epoch.
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates an invalid SOURCE_DATE_EPOCH.
+ * @return - `-2` - Indicates an invalid version.
+ */
+int get_source_date_epoch(const char *version, time_t *out_epoch);
+
+/**
+ * Runs every build phase as a dependency graph.
+ *
+ * The component fetch overlaps debootstrap, the target and live rootfs are
+ * built side by side from the base, and only the embed step, which packages
+ * the target rootfs straight into the live rootfs, waits for both. Assembly
+ * starts once the live rootfs is complete. Each step's full output is logged
+ * under the context's log directory.
+ *
+ * Each step's output is kept in the layer store under a hash of its inputs,
+ * so a rebuild replays the steps whose inputs did not change and reruns
+ * only those downstream of a change. When nothing changed, the ISO of the
+ * earlier build is reused outright.
+ *
+ * When the context asks to verify reproducibility, the embed and assembly
+ * steps build the target payload and the squashfs a second time and fail
+ * unless both copies hash the same.
+ *
+ * If the context has a checkpoint directory, steps completed by an earlier
+ * run with the same version, mirror, lockfile and builder binary are
+ * skipped, so a failed build resumes at the step that failed.
+ *
+ * @param context The build inputs and paths.
+ * @param max_jobs The maximum number of steps running at once.
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates a build step failed.
+ * @return - `-2` - Indicates the build was interrupted.
+ */
+int run_build_pipeline(const BuildContext *context, int max_jobs);
+
+/**
+ * Removes the rootfs trees, artifacts and checkpoints of a build, keeping
+ * its logs.
+ *
+ * @param context The build paths.
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates removal failure.
+ */
+int clean_build_pipeline(const BuildContext *context);
@@ -0,0 +1,321 @@
+/**
+ * This code is responsible for the persistent, content-addressed cache of
+ * LimeOS component binaries shared across builds.
+ *
+ * Entries live at CONFIG_CACHE_DIR/components/<repo>/<version>/<sha256>.
+ * Since the SHA-256 is part of the key and entries are only stored after
+ * verification, a hit can be placed into the build without re-hashing.
+ * Release checksum manifests are kept alongside, under
+ * CONFIG_CACHE_DIR/checksums/<repo>/<version>/, so a hit needs no network.
+ * Interrupted downloads are kept under CONFIG_CACHE_DIR/partial/ so a later
+ * attempt, even in another build, can resume them.
+ */
+
+#include "all.h"
+
+static int is_safe_key_segment(const char *segment)
+{
+    // Reject empty segments and anything that could escape the cache.
+    if (!segment || segment[0] == '\0' || segment[0] == '.')
+    {
+        return 0;
+    }
+    return strchr(segment, '/') == NULL;
+}
+
+static int build_cache_path(
+    const Component *component,
+    const char *version,
+    const char *sha256,
+    char *out_directory,
+    size_t directory_length,
+    char *out_path,
+    size_t path_length
+)
+{
+    // Validate the key so it maps onto a single cache entry.
+    if (!is_safe_key_segment(component->repo_name) ||
+        !is_safe_key_segment(version) ||
+        !sha256 || strlen(sha256) != COMMON_SHA256_HEX_LENGTH - 1)
+    {
+        return -1;
+    }
+
+    // Normalize the hash to lowercase so lookups are case-insensitive.
+    char hash[COMMON_SHA256_HEX_LENGTH];
+    for (size_t i = 0; i < sizeof(hash); i++)
+    {
+        hash[i] = (char)tolower((unsigned char)sha256[i]);
+    }
+
+    // Construct the entry directory and file paths.
+    snprintf(
+        out_directory, directory_length,
+        CONFIG_CACHE_DIR "/components/%s/%s",
+        component->repo_name, version
+    );
+    snprintf(out_path, path_length, "%s/%s", out_directory, hash);
+
+    return 0;
+}
+
+int has_cached_component_version(const Component *component, const char *version)
+{
+    // Validate the key so it maps onto a single cache directory.
+    if (!is_safe_key_segment(component->repo_name) || !is_safe_key_segment(version))
+    {
+        return 0;
+    }
+
+    // Construct the version directory path.
+    char version_directory[COMMON_MAX_PATH_LENGTH];
+    snprintf(
+        version_directory, sizeof(version_directory),
+        CONFIG_CACHE_DIR "/components/%s/%s",
+        component->repo_name, version
+    );
+
+    // Check whether the directory holds any entries.
+    DIR *directory = opendir(version_directory);
+    if (!directory)
+    {
+        return 0;
+    }
+    int found = 0;
+    struct dirent *entry;
+    while (!found && (entry = readdir(directory)) != NULL)
+    {
+        found = entry->d_name[0] != '.';
+    }
+    closedir(directory);
+
+    return found;
+}
+
+int lookup_cached_component(
+    const Component *component,
+    const char *version,
+    const char *sha256,
+    const char *output_path
+)
+{
+    // Construct the cache entry path.
+    char entry_directory[COMMON_MAX_PATH_LENGTH];
+    char entry_path[COMMON_MAX_PATH_LENGTH];
+    if (build_cache_path(
+            component, version, sha256,
+            entry_directory, sizeof(entry_directory),
+            entry_path, sizeof(entry_path)) != 0)
+    {
+        return -1;
+    }
+
+    // Check whether the entry exists.
+    if (!common.file_exists(entry_path))
+    {
+        return -2;
+    }
+
+    // Place the cached binary by hardlink or reflink, copying as a last resort.
+    unlink(output_path);
+    if (clone_file(entry_path, output_path) != 0 &&
+        common.copy_file(entry_path, output_path) != 0)
+    {
+        LOG_WARNING("Failed to place cached %s", component->repo_name);
+        return -3;
+    }
+
+    LOG_INFO("Using cached %s %s", component->repo_name, version);
+
+    return 0;
+}
+
+int store_cached_component(
+    const Component *component,
+    const char *version,
+    const char *sha256,
+    const char *source_path
+)
+{
+    // Construct the cache entry path.
+    char entry_directory[COMMON_MAX_PATH_LENGTH];
+    char entry_path[COMMON_MAX_PATH_LENGTH];
+    if (build_cache_path(
+            component, version, sha256,
+            entry_directory, sizeof(entry_directory),
+            entry_path, sizeof(entry_path)) != 0)
+    {
+        return -1;
+    }
+
+    // Skip the store if the entry is already cached.
+    if (common.file_exists(entry_path))
+    {
+        return 0;
+    }
+
+    // Create the entry directory.
+    if (common.mkdir_p(entry_directory) != 0)
+    {
+        return -2;
+    }
+
+    // Write the entry under a temporary name, then publish it atomically so
+    // concurrent builds never observe a partial binary.
+    char staging_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(staging_path, sizeof(staging_path), "%s.%d.tmp", entry_path, getpid());
+    if (clone_file(source_path, staging_path) != 0 &&
+        common.copy_file(source_path, staging_path) != 0)
+    {
+        unlink(staging_path);
+        return -3;
+    }
+    if (rename(staging_path, entry_path) != 0)
+    {
+        unlink(staging_path);
+        return -3;
+    }
+
+    return 0;
+}
+
+int prepare_partial_component(
+    const Component *component,
+    const char *version,
+    char *out_path,
+    size_t path_length
+)
+{
+    // Validate the key so it maps onto a single partial download.
+    if (!is_safe_key_segment(component->repo_name) || !is_safe_key_segment(version))
+    {
+        return -1;
+    }
+
+    // Create the version directory for the partial download.
+    char partial_directory[COMMON_MAX_PATH_LENGTH];
+    snprintf(
+        partial_directory, sizeof(partial_directory),
+        CONFIG_CACHE_DIR "/partial/%s/%s",
+        component->repo_name, version
+    );
+    if (common.mkdir_p(partial_directory) != 0)
+    {
+        return -2;
+    }
+
+    // Construct the partial download path.
+    snprintf(out_path, path_length, "%s/%s.part", partial_directory, component->repo_name);
+
+    return 0;
+}
+
+static int build_checksums_path(
+    const ChecksumTable *table,
+    char *out_directory,
+    size_t directory_length,
+    char *out_path,
+    size_t path_length
+)
+{
+    // Validate the key so it maps onto a single manifest.
+    if (!is_safe_key_segment(table->repo_name) || !is_safe_key_segment(table->version))
+    {
+        return -1;
+    }
+
+    // Construct the manifest directory and file paths.
+    snprintf(
+        out_directory, directory_length,
+        CONFIG_CACHE_DIR "/checksums/%s/%s",
+        table->repo_name, table->version
+    );
+    snprintf(out_path, path_length, "%s/" CONFIG_CHECKSUMS_FILENAME, out_directory);
+
+    return 0;
+}
+
+int load_cached_checksums(ChecksumTable *table)
+{
+    // Construct the manifest path.
+    char manifest_directory[COMMON_MAX_PATH_LENGTH];
+    char manifest_path[COMMON_MAX_PATH_LENGTH];
+    if (build_checksums_path(
+            table,
+            manifest_directory, sizeof(manifest_directory),
+            manifest_path, sizeof(manifest_path)) != 0)
+    {
+        return -1;
+    }
+
+    // Read the cached manifest into memory.
+    FILE *manifest_file = fopen(manifest_path, "rb");
+    if (!manifest_file)
+    {
+        return -2;
+    }
+    char *data = NULL;
+    size_t length = 0;
+    FILE *data_stream = open_memstream(&data, &length);
+    if (!data_stream)
+    {
+        fclose(manifest_file);
+        return -3;
+    }
+    char chunk[4096];
+    size_t chunk_length;
+    while ((chunk_length = fread(chunk, 1, sizeof(chunk), manifest_file)) > 0)
+    {
+        fwrite(chunk, 1, chunk_length, data_stream);
+    }
+    fclose(manifest_file);
+    fclose(data_stream);
+
+    // Parse the manifest into the table.
+    int parse_result = parse_checksum_table(table, data, length);
+    free(data);
+    if (parse_result != 0)
+    {
+        return -3;
+    }
+
+    return 0;
+}
+
+int store_cached_checksums(const ChecksumTable *table, const char *data, size_t length)
+{
+    // Construct the manifest path.
+    char manifest_directory[COMMON_MAX_PATH_LENGTH];
+    char manifest_path[COMMON_MAX_PATH_LENGTH];
+    if (build_checksums_path(
+            table,
+            manifest_directory, sizeof(manifest_directory),
+            manifest_path, sizeof(manifest_path)) != 0)
+    {
+        return -1;
+    }
+
+    // Create the manifest directory.
+    if (common.mkdir_p(manifest_directory) != 0)
+    {
+        return -2;
+    }
+
+    // Write the manifest under a temporary name, then publish it atomically.
+    char staging_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(staging_path, sizeof(staging_path), "%s.%d.tmp", manifest_path, getpid());
+    FILE *staging_file = fopen(staging_path, "wb");
+    if (!staging_file)
+    {
+        return -3;
+    }
+    size_t written = fwrite(data, 1, length, staging_file);
+    if (fclose(staging_file) != 0 || written != length ||
+        rename(staging_path, manifest_path) != 0)
+    {
+        unlink(staging_path);
+        return -3;
+    }
+
+    return 0;
+}
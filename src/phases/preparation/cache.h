@@ -0,0 +1,113 @@
+#pragma once
+
+/**
+ * Checks whether the cache holds any binary for a component version.
+ *
+ * Lets callers decide, before the checksum is known, whether a cache hit is
+ * possible at all.
+ *
+ * @param component The component definition with repo and binary names.
+ * @param version The resolved release version tag.
+ *
+ * @return - `1` - Indicates at least one cached entry exists.
+ * @return - `0` - Indicates no entry exists or the key is invalid.
+ */
+int has_cached_component_version(const Component *component, const char *version);
+
+/**
+ * Places a cached component binary into the build, if one exists.
+ *
+ * Looks up the binary by repository, resolved version, and SHA-256, then
+ * hardlinks or reflinks it to the output path (copying only as a last
+ * resort).
+ *
+ * @param component The component definition with repo and binary names.
+ * @param version The resolved release version tag.
+ * @param sha256 The expected SHA-256 of the binary (hex).
+ * @param output_path The path to place the binary at.
+ *
+ * @return - `0` - Indicates a cache hit; the binary is at output_path.
+ * @return - `-1` - Indicates the cache key is invalid.
+ * @return - `-2` - Indicates a cache miss.
+ * @return - `-3` - Indicates the cached binary could not be placed.
+ */
+int lookup_cached_component(
+    const Component *component,
+    const char *version,
+    const char *sha256,
+    const char *output_path
+);
+
+/**
+ * Stores a verified component binary in the persistent cache.
+ *
+ * @param component The component definition with repo and binary names.
+ * @param version The resolved release version tag.
+ * @param sha256 The verified SHA-256 of the binary (hex).
+ * @param source_path The path to the verified binary.
+ *
+ * @return - `0` - Indicates the binary was stored (or already cached).
+ * @return - `-1` - Indicates the cache key is invalid.
+ * @return - `-2` - Indicates cache directory creation failure.
+ * @return - `-3` - Indicates the binary could not be written to the cache.
+ *
+ * @note Only call this after the binary's checksum has been verified, since
+ * later builds trust cached entries by their key.
+ */
+int store_cached_component(
+    const Component *component,
+    const char *version,
+    const char *sha256,
+    const char *source_path
+);
+
+/**
+ * Prepares the persistent location of a component's partial download.
+ *
+ * Keeping partial downloads outside the build directory lets a download that
+ * fails, even in an earlier build, be resumed rather than restarted.
+ *
+ * @param component The component definition with repo and binary names.
+ * @param version The resolved release version tag.
+ * @param out_path The buffer to store the partial download path.
+ * @param path_length The size of the output buffer.
+ *
+ * @return - `0` - Indicates the location is ready.
+ * @return - `-1` - Indicates the cache key is invalid.
+ * @return - `-2` - Indicates cache directory creation failure.
+ */
+int prepare_partial_component(
+    const Component *component,
+    const char *version,
+    char *out_path,
+    size_t path_length
+);
+
+/**
+ * Loads a release's checksum table from the persistent cache.
+ *
+ * Release manifests are immutable once published, so a cached manifest lets
+ * later builds verify and look up cached binaries without refetching it.
+ *
+ * @param table The table to fill, keyed by its repository and version.
+ *
+ * @return - `0` - Indicates the table was loaded and is ready.
+ * @return - `-1` - Indicates the cache key is invalid.
+ * @return - `-2` - Indicates no manifest is cached for the release.
+ * @return - `-3` - Indicates the cached manifest could not be parsed.
+ */
+int load_cached_checksums(ChecksumTable *table);
+
+/**
+ * Stores a release's checksums manifest in the persistent cache.
+ *
+ * @param table The table the manifest was parsed into.
+ * @param data The raw manifest contents.
+ * @param length The length of the manifest contents in bytes.
+ *
+ * @return - `0` - Indicates the manifest was stored.
+ * @return - `-1` - Indicates the cache key is invalid.
+ * @return - `-2` - Indicates cache directory creation failure.
+ * @return - `-3` - Indicates the manifest could not be written.
+ */
+int store_cached_checksums(const ChecksumTable *table, const char *data, size_t length);
@@ -0,0 +1,269 @@
+/**
+ * This code is responsible for parsing release checksum manifests into
+ * hash-indexed tables and sharing them across every lookup in a build.
+ */
+
+#include "all.h"
+
+/** The minimum number of hash buckets in a table. */
+#define CHECKSUM_TABLE_MIN_BUCKETS 16
+
+/** The FNV-1a 64-bit offset basis. */
+#define FNV_OFFSET_BASIS 1469598103934665603ULL
+
+/** The FNV-1a 64-bit prime. */
+#define FNV_PRIME 1099511628211ULL
+
+/** The shared checksum tables acquired during the build. */
+static ChecksumTable **release_tables = NULL;
+
+/** The number of shared checksum tables acquired during the build. */
+static size_t release_table_count = 0;
+
+static size_t hash_filename(const char *filename)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (const unsigned char *c = (const unsigned char *)filename; *c; c++)
+    {
+        hash ^= *c;
+        hash *= FNV_PRIME;
+    }
+    return (size_t)hash;
+}
+
+static int is_hex_hash(const char *text)
+{
+    for (int i = 0; i < COMMON_SHA256_HEX_LENGTH - 1; i++)
+    {
+        if (!isxdigit((unsigned char)text[i]))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int resize_buckets(ChecksumTable *table, size_t bucket_count)
+{
+    // Allocate the new, empty bucket array.
+    size_t *buckets = calloc(bucket_count, sizeof(*buckets));
+    if (!buckets)
+    {
+        return -1;
+    }
+
+    // Re-index every entry (bucket values are entry index + 1; 0 is empty).
+    for (size_t i = 0; i < table->entry_count; i++)
+    {
+        size_t slot = hash_filename(table->entries[i].filename) & (bucket_count - 1);
+        while (buckets[slot] != 0)
+        {
+            slot = (slot + 1) & (bucket_count - 1);
+        }
+        buckets[slot] = i + 1;
+    }
+
+    // Swap in the new bucket array.
+    free(table->buckets);
+    table->buckets = buckets;
+    table->bucket_count = bucket_count;
+
+    return 0;
+}
+
+static int insert_entry(ChecksumTable *table, const char *filename, const char *hash)
+{
+    // Keep the load factor at or below one half.
+    if ((table->entry_count + 1) * 2 > table->bucket_count)
+    {
+        size_t bucket_count = table->bucket_count ? table->bucket_count * 2 : CHECKSUM_TABLE_MIN_BUCKETS;
+        if (resize_buckets(table, bucket_count) != 0)
+        {
+            return -1;
+        }
+    }
+
+    // Grow the entry array if needed.
+    if (table->entry_count == table->entry_capacity)
+    {
+        size_t capacity = table->entry_capacity ? table->entry_capacity * 2 : CHECKSUM_TABLE_MIN_BUCKETS;
+        ChecksumEntry *entries = realloc(table->entries, capacity * sizeof(*entries));
+        if (!entries)
+        {
+            return -1;
+        }
+        table->entries = entries;
+        table->entry_capacity = capacity;
+    }
+
+    // Probe for the filename, keeping the first entry on duplicates.
+    size_t slot = hash_filename(filename) & (table->bucket_count - 1);
+    while (table->buckets[slot] != 0)
+    {
+        if (strcmp(table->entries[table->buckets[slot] - 1].filename, filename) == 0)
+        {
+            return 0;
+        }
+        slot = (slot + 1) & (table->bucket_count - 1);
+    }
+
+    // Store the entry with a lowercase hash.
+    ChecksumEntry *entry = &table->entries[table->entry_count];
+    entry->filename = filename;
+    for (int i = 0; i < COMMON_SHA256_HEX_LENGTH - 1; i++)
+    {
+        entry->hash[i] = (char)tolower((unsigned char)hash[i]);
+    }
+    entry->hash[COMMON_SHA256_HEX_LENGTH - 1] = '\0';
+    table->buckets[slot] = ++table->entry_count;
+
+    return 0;
+}
+
+int parse_checksum_table(ChecksumTable *table, const char *data, size_t length)
+{
+    // Discard any previous entries.
+    cleanup_checksum_table(table);
+
+    // Copy the manifest so entry filenames can point into it.
+    table->text = malloc(length + 1);
+    if (!table->text)
+    {
+        return -1;
+    }
+    memcpy(table->text, data, length);
+    table->text[length] = '\0';
+
+    // Index each well-formed line (format: "hash  filename" or "hash *filename").
+    char *line = table->text;
+    while (line && *line)
+    {
+        // Terminate the current line, dropping any carriage return.
+        char *next_line = strchr(line, '\n');
+        if (next_line)
+        {
+            *next_line++ = '\0';
+        }
+        size_t line_length = strlen(line);
+        if (line_length > 0 && line[line_length - 1] == '\r')
+        {
+            line[--line_length] = '\0';
+        }
+
+        // Skip lines that do not start with a hash and a separator.
+        const size_t hash_length = COMMON_SHA256_HEX_LENGTH - 1;
+        if (line_length < hash_length + 3 || !is_hex_hash(line) ||
+            line[hash_length] != ' ' ||
+            (line[hash_length + 1] != ' ' && line[hash_length + 1] != '*'))
+        {
+            line = next_line;
+            continue;
+        }
+
+        // Index the entry by its filename.
+        if (insert_entry(table, line + hash_length + 2, line) != 0)
+        {
+            cleanup_checksum_table(table);
+            return -1;
+        }
+
+        line = next_line;
+    }
+
+    table->state = CHECKSUM_TABLE_READY;
+
+    return 0;
+}
+
+const char *find_checksum_table_entry(const ChecksumTable *table, const char *filename)
+{
+    // Treat tables without entries as empty.
+    if (table->state != CHECKSUM_TABLE_READY || table->bucket_count == 0)
+    {
+        return NULL;
+    }
+
+    // Probe until the filename or an empty bucket is found.
+    size_t slot = hash_filename(filename) & (table->bucket_count - 1);
+    while (table->buckets[slot] != 0)
+    {
+        const ChecksumEntry *entry = &table->entries[table->buckets[slot] - 1];
+        if (strcmp(entry->filename, filename) == 0)
+        {
+            return entry->hash;
+        }
+        slot = (slot + 1) & (table->bucket_count - 1);
+    }
+
+    return NULL;
+}
+
+void cleanup_checksum_table(ChecksumTable *table)
+{
+    free(table->text);
+    free(table->entries);
+    free(table->buckets);
+    table->text = NULL;
+    table->entries = NULL;
+    table->buckets = NULL;
+    table->entry_count = 0;
+    table->entry_capacity = 0;
+    table->bucket_count = 0;
+    table->state = CHECKSUM_TABLE_EMPTY;
+}
+
+ChecksumTable *acquire_release_checksums(const char *repo_name, const char *version)
+{
+    // Reject keys that do not fit the table.
+    if (strlen(repo_name) >= CHECKSUM_TABLE_KEY_MAX_LENGTH ||
+        strlen(version) >= CHECKSUM_TABLE_KEY_MAX_LENGTH)
+    {
+        return NULL;
+    }
+
+    // Return the existing table for the release, if any.
+    for (size_t i = 0; i < release_table_count; i++)
+    {
+        if (strcmp(release_tables[i]->repo_name, repo_name) == 0 &&
+            strcmp(release_tables[i]->version, version) == 0)
+        {
+            return release_tables[i];
+        }
+    }
+
+    // Grow the registry by one slot.
+    ChecksumTable **tables = realloc(
+        release_tables, (release_table_count + 1) * sizeof(*tables)
+    );
+    if (!tables)
+    {
+        return NULL;
+    }
+    release_tables = tables;
+
+    // Create an empty table for the release.
+    ChecksumTable *table = calloc(1, sizeof(*table));
+    if (!table)
+    {
+        return NULL;
+    }
+    snprintf(table->repo_name, sizeof(table->repo_name), "%s", repo_name);
+    snprintf(table->version, sizeof(table->version), "%s", version);
+    table->state = CHECKSUM_TABLE_EMPTY;
+    release_tables[release_table_count++] = table;
+
+    return table;
+}
+
+void clear_release_checksums(void)
+{
+    // Release every table and the registry itself.
+    for (size_t i = 0; i < release_table_count; i++)
+    {
+        cleanup_checksum_table(release_tables[i]);
+        free(release_tables[i]);
+    }
+    free(release_tables);
+    release_tables = NULL;
+    release_table_count = 0;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+/** The maximum length for the repository and version keys of a table. */
+#define CHECKSUM_TABLE_KEY_MAX_LENGTH 128
+
+/** A type representing one "hash  filename" entry of a checksums manifest. */
+typedef struct
+{
+    const char *filename;
+    char hash[COMMON_SHA256_HEX_LENGTH];
+} ChecksumEntry;
+
+/** A type representing how far a release's checksum table has been loaded. */
+typedef enum
+{
+    CHECKSUM_TABLE_EMPTY,
+    CHECKSUM_TABLE_FETCHING,
+    CHECKSUM_TABLE_READY,
+    CHECKSUM_TABLE_UNAVAILABLE
+} ChecksumTableState;
+
+/**
+ * A type representing the parsed checksums manifest of one release.
+ *
+ * Entries are indexed by filename in an open-addressing hash map, so every
+ * lookup is constant time regardless of how many artifacts a release ships.
+ */
+typedef struct
+{
+    char repo_name[CHECKSUM_TABLE_KEY_MAX_LENGTH];
+    char version[CHECKSUM_TABLE_KEY_MAX_LENGTH];
+    ChecksumTableState state;
+    char *text;
+    ChecksumEntry *entries;
+    size_t entry_count;
+    size_t entry_capacity;
+    size_t *buckets;
+    size_t bucket_count;
+} ChecksumTable;
+
+/**
+ * Parses a checksums manifest into a table.
+ *
+ * Accepts the `sha256sum` output format ("hash  filename" or
+ * "hash *filename"). Malformed lines are skipped; for duplicate filenames
+ * the first entry wins. On success the table becomes ready.
+ *
+ * @param table The table to fill; any previous entries are discarded.
+ * @param data The manifest contents (need not be NUL-terminated).
+ * @param length The length of the manifest contents in bytes.
+ *
+ * @return - `0` - Indicates successful parsing.
+ * @return - `-1` - Indicates a memory allocation failure.
+ */
+int parse_checksum_table(ChecksumTable *table, const char *data, size_t length);
+
+/**
+ * Finds the expected hash for a filename in a parsed table.
+ *
+ * @param table The parsed table.
+ * @param filename The artifact filename to look up.
+ *
+ * @return - The lowercase hex hash, or NULL if the filename is not listed.
+ */
+const char *find_checksum_table_entry(const ChecksumTable *table, const char *filename);
+
+/** Releases the entries of a table and resets it to empty. */
+void cleanup_checksum_table(ChecksumTable *table);
+
+/**
+ * Acquires the shared checksum table for a release.
+ *
+ * Every lookup for the same repository and version within a build receives
+ * the same table, so each manifest is fetched and parsed at most once.
+ *
+ * @param repo_name The component repository name.
+ * @param version The resolved release version tag.
+ *
+ * @return - The shared table, or NULL on allocation failure or overlong keys.
+ */
+ChecksumTable *acquire_release_checksums(const char *repo_name, const char *version);
+
+/** Releases every shared checksum table acquired during the build. */
+void clear_release_checksums(void);
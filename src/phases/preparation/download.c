@@ -1,143 +1,112 @@
 /**
  * This code is responsible for downloading LimeOS component binaries from
- * GitHub releases or loading them from the local filesystem.
+ * GitHub releases (or a release mirror) or loading them from the local
+ * filesystem.
+ *
+ * Remote components are fetched concurrently through a single curl multi
+ * handle. Each component advances through its own stages as its transfers
+ * complete, so the phase takes about as long as the slowest component
+ * rather than the sum of all of them. Binaries are hashed while they stream
+ * in, and each release's checksums manifest is fetched once into a table
+ * shared by every lookup (and by the persistent cache), alongside the
+ * binary. Only when the cache may already hold the resolved version is the
+ * manifest awaited first, so a cache hit skips the download entirely.
+ * Binaries stream into persistent partial downloads. Stalled or failed
+ * transfers are retried with backoff and resume with HTTP range requests
+ * rather than starting over.
+ *
+ * Every request in the build, including release resolution, shares one
+ * network context so DNS lookups, TLS sessions and connections are reused
+ * and transfers to the same host multiplex over HTTP/2.
  */
 
 #include "all.h"
 
-static int fetch_expected_checksum(
-    const char *repo_name,
-    const char *version,
-    const char *binary_name,
-    char *out_hash,
-    size_t hash_length
-)
-{
-    // Validate buffer size.
-    if (hash_length < COMMON_SHA256_HEX_LENGTH)
-    {
-        return -1;
-    }
+/** The maximum time in milliseconds to wait for network activity per poll. */
+#define FETCH_POLL_TIMEOUT_MS 1000
 
-    // Construct the checksums file URL.
-    char url[FETCH_URL_MAX_LENGTH];
-    snprintf(
-        url, sizeof(url),
-        "https://github.com/%s/%s/releases/download/%s/" CONFIG_CHECKSUMS_FILENAME,
-        CONFIG_GITHUB_ORG, repo_name, version
-    );
+/** The maximum time in seconds to establish a connection. */
+#define FETCH_CONNECT_TIMEOUT_SECONDS 30
 
-    // Create an in-memory stream for the checksums data.
-    char *checksums_data = NULL;
-    size_t checksums_size = 0;
-    FILE *checksums_stream = open_memstream(&checksums_data, &checksums_size);
-    if (!checksums_stream)
-    {
-        LOG_ERROR("Failed to create memory stream for checksums");
-        return -2;
-    }
+/** The transfer speed in bytes per second below which a transfer stalls. */
+#define FETCH_STALL_SPEED_BYTES 1024
 
-    // Initialize the curl session.
-    CURL *curl = curl_easy_init();
-    if (!curl)
-    {
-        fclose(checksums_stream);
-        free(checksums_data);
-        return -3;
-    }
+/** The time in seconds a transfer may stall before it is aborted. */
+#define FETCH_STALL_SECONDS 30
 
-    // Configure curl options and perform the download.
-    curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, fwrite);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, checksums_stream);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl, CURLOPT_USERAGENT, CONFIG_USER_AGENT);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, FETCH_TIMEOUT_SECONDS);
-    CURLcode result = curl_easy_perform(curl);
-    long http_code = 0;
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
-    curl_easy_cleanup(curl);
-    fclose(checksums_stream);
-
-    // Check for download errors.
-    if (result != CURLE_OK || http_code != 200)
-    {
-        free(checksums_data);
-        return -4;
-    }
+/** The maximum number of attempts per binary download, including the first. */
+#define FETCH_MAX_ATTEMPTS 5
 
-    // Parse the checksums file (format: "hash  filename").
-    char *line = checksums_data;
-    char *next_line;
-    int found = 0;
-    while (line && *line)
-    {
-        next_line = strchr(line, '\n');
-        if (next_line)
-        {
-            *next_line = '\0';
-            next_line++;
-        }
+/** The delay in seconds before the first retry, doubled for each later one. */
+#define FETCH_RETRY_DELAY_SECONDS 2
 
-        // Skip empty lines.
-        if (strlen(line) < COMMON_SHA256_HEX_LENGTH)
-        {
-            line = next_line;
-            continue;
-        }
+/** A type representing the stage a component fetch has reached. */
+typedef enum
+{
+    FETCH_STAGE_RESOLVE,
+    FETCH_STAGE_AWAIT_CHECKSUMS,
+    FETCH_STAGE_DOWNLOAD,
+    FETCH_STAGE_DONE,
+    FETCH_STAGE_FAILED
+} FetchStage;
 
-        // Check if this line is for our binary (format: "hash  filename").
-        char *filename_start = strstr(line, "  ");
-        if (filename_start)
-        {
-            filename_start += 2;
-            if (strcmp(filename_start, binary_name) == 0)
-            {
-                strncpy(out_hash, line, COMMON_SHA256_HEX_LENGTH - 1);
-                out_hash[COMMON_SHA256_HEX_LENGTH - 1] = '\0';
-                found = 1;
-                break;
-            }
-        }
+/** A type representing the in-flight state of a single component fetch. */
+typedef struct
+{
+    const Component *component;
+    const char *version;
+    const char *output_directory;
+    int required;
+    FetchStage stage;
+    CURL *resolve_handle;
+    CURL *checksum_handle;
+    CURL *binary_handle;
+    ReleasesRequest releases;
+    char resolved_version[COMMON_MAX_VERSION_LENGTH];
+    char output_path[COMMON_MAX_PATH_LENGTH];
+    char partial_path[COMMON_MAX_PATH_LENGTH];
+    FILE *output_file;
+    curl_off_t resume_offset;
+    int binary_attempts;
+    time_t binary_retry_at;
+    EVP_MD_CTX *digest_context;
+    char actual_hash[COMMON_SHA256_HEX_LENGTH];
+    int binary_complete;
+    ChecksumTable *checksums;
+    char *checksums_data;
+    size_t checksums_size;
+    FILE *checksums_stream;
+    char expected_hash[COMMON_SHA256_HEX_LENGTH];
+    int has_expected_hash;
+    int checksum_complete;
+} FetchJob;
 
-        line = next_line;
-    }
+/** The share handle pooling DNS, TLS sessions and connections for the build. */
+static CURLSH *fetch_share = NULL;
 
-    // Clean up and return the result.
-    free(checksums_data);
-    return found ? 0 : -5;
-}
+/** The multi handle driving every transfer of the build. */
+static CURLM *fetch_multi = NULL;
 
 static int verify_checksum(
-    const char *file_path,
-    const char *repo_name,
-    const char *version,
-    const char *binary_name
+    const char *binary_name,
+    const char *expected_hash,
+    const char *actual_hash
 )
 {
-    // Fetch the expected checksum from the release.
-    char expected_hash[COMMON_SHA256_HEX_LENGTH];
-    if (fetch_expected_checksum(repo_name, version, binary_name, expected_hash, sizeof(expected_hash)) != 0)
+    // Skip verification when the release publishes no checksum.
+    if (!expected_hash)
     {
         LOG_WARNING("No checksum available for %s - skipping verification", binary_name);
         return 0;
     }
 
-    // Compute the actual checksum of the downloaded file.
-    char actual_hash[COMMON_SHA256_HEX_LENGTH];
-    if (common.compute_file_sha256(file_path, actual_hash, sizeof(actual_hash)) != 0)
-    {
-        LOG_ERROR("Failed to compute checksum for %s", file_path);
-        return -1;
-    }
-
     // Compare checksums.
     if (strcasecmp(expected_hash, actual_hash) != 0)
     {
         LOG_ERROR("Checksum mismatch for %s", binary_name);
         LOG_ERROR("  Expected: %s", expected_hash);
         LOG_ERROR("  Actual:   %s", actual_hash);
-        return -2;
+        return -1;
     }
 
     LOG_INFO("Checksum verified for %s", binary_name);
@@ -165,8 +134,10 @@ static int copy_local_component(
     char output_path[COMMON_MAX_PATH_LENGTH];
     snprintf(output_path, sizeof(output_path), "%s/%s", output_directory, component->repo_name);
 
-    // Copy the local binary to the output directory.
-    if (common.copy_file(local_path, output_path) != 0)
+    // Place the local binary by hardlink or reflink, copying as a last resort.
+    unlink(output_path);
+    if (clone_file(local_path, output_path) != 0 &&
+        common.copy_file(local_path, output_path) != 0)
     {
         return -2;
     }
@@ -183,181 +154,1037 @@ static size_t write_download_chunk(
     return fwrite(data, size, count, (FILE *)stream);
 }
 
-static int download_remote(
-    const Component *component,
-    const char *version,
-    const char *output_directory
+static size_t write_binary_chunk(
+    void *data, size_t size, size_t count, void *userdata
 )
 {
-    // Resolve the version to the latest within the major version.
-    char resolved_version[COMMON_MAX_VERSION_LENGTH];
-    int resolve_result = resolve_version(
-        component->repo_name, version, resolved_version, sizeof(resolved_version)
-    );
-    if (resolve_result == -2)
+    size_t total_size = size * count;
+    FetchJob *job = (FetchJob *)userdata;
+
+    // Start over if the server ignored the range of a resumed download.
+    if (job->resume_offset > 0)
     {
-        // API failure - fall back to exact version.
-        LOG_WARNING(
-            "Version resolution failed for %s, using exact version %s",
-            component->repo_name, version
-        );
-        strncpy(resolved_version, version, sizeof(resolved_version) - 1);
-        resolved_version[sizeof(resolved_version) - 1] = '\0';
+        long http_code = 0;
+        curl_easy_getinfo(job->binary_handle, CURLINFO_RESPONSE_CODE, &http_code);
+        if (is_http_transfer(job->binary_handle) && http_code != 206)
+        {
+            if (ftruncate(fileno(job->output_file), 0) != 0 ||
+                EVP_DigestInit_ex(job->digest_context, EVP_sha256(), NULL) != 1)
+            {
+                return 0;
+            }
+        }
+        job->resume_offset = 0;
     }
-    else if (resolve_result < 0)
+
+    // Write the chunk to the output file.
+    if (fwrite(data, 1, total_size, job->output_file) != total_size)
     {
-        // Other failures (invalid format, parse error, no matching version).
-        return -1;
+        return 0;
     }
 
-    // Construct the GitHub release download URL.
-    char url[FETCH_URL_MAX_LENGTH];
-    snprintf(
-        url, sizeof(url),
-        "https://github.com/%s/%s/releases/download/%s/%s",
-        CONFIG_GITHUB_ORG, component->repo_name, resolved_version, component->repo_name
-    );
-
-    // Construct the local output file path.
-    char output_path[COMMON_MAX_PATH_LENGTH];
-    snprintf(output_path, sizeof(output_path), "%s/%s", output_directory, component->repo_name);
-
-    // Log the fetch operation.
-    LOG_INFO("Fetching %s %s", component->repo_name, resolved_version);
-
-    // Create the output directory if it does not exist.
-    common.mkdir_p(output_directory);
-
-    // Open the output file for writing.
-    FILE *output_file = fopen(output_path, "wb");
-    if (!output_file)
+    // Hash the chunk while it is still in memory.
+    if (EVP_DigestUpdate(job->digest_context, data, total_size) != 1)
     {
-        LOG_ERROR("Failed to create file %s: %s", output_path, strerror(errno));
-        return -2;
+        return 0;
     }
 
+    return total_size;
+}
+
+static CURL *create_transfer_handle(
+    FetchJob *job,
+    const char *url,
+    size_t (*write_callback)(void *, size_t, size_t, void *),
+    void *write_data
+)
+{
     // Initialize the curl session.
     CURL *curl = curl_easy_init();
     if (!curl)
     {
         LOG_ERROR("Failed to initialize curl");
-        fclose(output_file);
-        return -3;
+        return NULL;
     }
 
-    // Configure curl options for the download.
+    // Configure curl options shared by release downloads.
+    configure_fetch_handle(curl);
     curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_download_chunk);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, output_file);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, write_data);
     curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl, CURLOPT_USERAGENT, CONFIG_USER_AGENT);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, FETCH_TIMEOUT_SECONDS);
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, job);
+
+    return curl;
+}
 
-    // Perform the download.
-    CURLcode result = curl_easy_perform(curl);
+static void release_transfer(CURLM *multi, CURL **handle)
+{
+    // Detach and destroy the transfer, if any.
+    if (*handle)
+    {
+        curl_multi_remove_handle(multi, *handle);
+        curl_easy_cleanup(*handle);
+        *handle = NULL;
+    }
+}
 
-    // Get the HTTP response code.
-    long http_code = 0;
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+static void fail_fetch_job(FetchJob *job, CURLM *multi)
+{
+    // Hand an unfinished manifest fetch back so a waiting job can retry it.
+    if (job->checksum_handle)
+    {
+        job->checksums->state = CHECKSUM_TABLE_EMPTY;
+    }
 
-    // Clean up curl resources.
-    curl_easy_cleanup(curl);
-    fclose(output_file);
+    // Release every transfer still held by the job.
+    release_transfer(multi, &job->resolve_handle);
+    release_transfer(multi, &job->checksum_handle);
+    release_transfer(multi, &job->binary_handle);
+    cleanup_releases_request(&job->releases);
 
-    // Check for curl errors.
-    if (result != CURLE_OK)
+    // Release the checksum stream and its data.
+    if (job->checksums_stream)
     {
-        remove(output_path);
-        LOG_ERROR("Download failed: %s", curl_easy_strerror(result));
-        return -4;
+        fclose(job->checksums_stream);
+        job->checksums_stream = NULL;
     }
+    free(job->checksums_data);
+    job->checksums_data = NULL;
 
-    // Check for HTTP errors.
-    if (http_code != 200)
+    // Release the digest and remove any partially downloaded binary.
+    EVP_MD_CTX_free(job->digest_context);
+    job->digest_context = NULL;
+    if (job->output_file)
     {
-        remove(output_path);
-        LOG_ERROR("Download failed: HTTP %ld", http_code);
-        return -5;
+        fclose(job->output_file);
+        job->output_file = NULL;
+    }
+    if (job->stage == FETCH_STAGE_DOWNLOAD)
+    {
+        remove(job->output_path);
     }
 
-    // Validate downloaded file size.
-    struct stat file_stat;
-    if (stat(output_path, &file_stat) != 0 || file_stat.st_size == 0)
+    // The partial download itself is kept so a later build can resume it.
+    job->stage = FETCH_STAGE_FAILED;
+}
+
+static int start_resolve_transfer(FetchJob *job, CURLM *multi)
+{
+    // Prepare the releases API request for the component.
+    job->stage = FETCH_STAGE_RESOLVE;
+    int prepare_result = prepare_releases_request(
+        &job->releases, job->component->repo_name, job->version, &job->resolve_handle
+    );
+    if (prepare_result < 0)
     {
-        remove(output_path);
-        LOG_ERROR("Download failed: empty or missing file for %s", component->repo_name);
-        return -6;
+        LOG_ERROR("Failed to prepare releases request for %s", job->component->repo_name);
+        return -1;
     }
 
-    LOG_INFO("Downloaded %s (%ld bytes)", component->repo_name, (long)file_stat.st_size);
+    // Leave rate-limited requests for resume_deferred_resolve() to settle.
+    if (prepare_result == 2)
+    {
+        LOG_WARNING(
+            "GitHub API rate limit exhausted, deferring %s",
+            job->component->repo_name
+        );
+    }
+    if (!job->resolve_handle)
+    {
+        return 0;
+    }
 
-    // Verify the checksum of the downloaded file.
-    if (verify_checksum(output_path, component->repo_name, resolved_version, component->repo_name) != 0)
+    // Tag the handle with the job and hand it to the multi handle.
+    curl_easy_setopt(job->resolve_handle, CURLOPT_PRIVATE, job);
+    if (curl_multi_add_handle(multi, job->resolve_handle) != CURLM_OK)
     {
-        remove(output_path);
-        return -7;
+        return -2;
     }
 
     return 0;
 }
 
-int init_fetch(void)
+static int start_checksum_transfer(FetchJob *job, CURLM *multi)
 {
-    // Initialize the curl library globally.
-    CURLcode result = curl_global_init(CURL_GLOBAL_DEFAULT);
-    if (result != CURLE_OK)
+    // Construct the checksums file URL.
+    char url[FETCH_URL_MAX_LENGTH];
+    build_release_asset_url(
+        job->component->repo_name, job->resolved_version,
+        CONFIG_CHECKSUMS_FILENAME, url, sizeof(url)
+    );
+
+    // Create an in-memory stream for the checksums data.
+    job->checksums_stream = open_memstream(&job->checksums_data, &job->checksums_size);
+    if (!job->checksums_stream)
     {
+        LOG_ERROR("Failed to create memory stream for checksums");
         return -1;
     }
 
+    // Create the transfer and hand it to the multi handle.
+    job->checksum_handle = create_transfer_handle(
+        job, url, write_download_chunk, job->checksums_stream
+    );
+    if (!job->checksum_handle)
+    {
+        return -2;
+    }
+    if (curl_multi_add_handle(multi, job->checksum_handle) != CURLM_OK)
+    {
+        return -3;
+    }
+
+    // Claim the release's shared table so other jobs wait for this fetch.
+    // Only a fetch that is under way may claim it, since a job that fails
+    // before then would leave its siblings waiting for good.
+    job->checksums->state = CHECKSUM_TABLE_FETCHING;
+
     return 0;
 }
 
-void cleanup_fetch(void)
+static int open_partial_download(FetchJob *job)
 {
-    // Clean up the curl library globally.
-    curl_global_cleanup();
-}
+    // Choose the persistent partial download on the first attempt.
+    if (job->partial_path[0] == '\0' &&
+        prepare_partial_component(
+            job->component, job->resolved_version,
+            job->partial_path, sizeof(job->partial_path)) != 0)
+    {
+        snprintf(job->partial_path, sizeof(job->partial_path), "%s.part", job->output_path);
+    }
 
-int fetch_component(
-    const Component *component,
-    const char *version,
-    const char *output_directory
-)
-{
-    // Try local binary first.
-    if (copy_local_component(component, output_directory) == 0)
+    // Open the partial download for appending, creating it if needed.
+    job->output_file = fopen(job->partial_path, "ab");
+    if (!job->output_file)
     {
-        return 0;
+        LOG_ERROR("Failed to create file %s: %s", job->partial_path, strerror(errno));
+        return -1;
     }
 
-    // Fall back to remote download.
-    return download_remote(component, version, output_directory);
+    // Fall back to a private partial download if another build holds it.
+    if (flock(fileno(job->output_file), LOCK_EX | LOCK_NB) != 0)
+    {
+        fclose(job->output_file);
+        snprintf(job->partial_path, sizeof(job->partial_path), "%s.part", job->output_path);
+        job->output_file = fopen(job->partial_path, "wb");
+        if (!job->output_file)
+        {
+            LOG_ERROR("Failed to create file %s: %s", job->partial_path, strerror(errno));
+            return -1;
+        }
+    }
+
+    // Resume after whatever an earlier attempt already downloaded.
+    struct stat partial_stat;
+    job->resume_offset = 0;
+    if (fstat(fileno(job->output_file), &partial_stat) == 0)
+    {
+        job->resume_offset = (curl_off_t)partial_stat.st_size;
+    }
+
+    return 0;
 }
 
-int fetch_all_components(const char *version, const char *output_directory)
+static int hash_partial_download(FetchJob *job)
 {
-    LOG_INFO("Fetching LimeOS components...");
+    // Nothing to hash when starting from scratch.
+    if (job->resume_offset == 0)
+    {
+        return 0;
+    }
 
-    // Fetch required components.
-    for (int i = 0; i < CONFIG_REQUIRED_COMPONENTS_COUNT; i++)
+    // Feed the bytes downloaded so far into the digest.
+    FILE *partial_file = fopen(job->partial_path, "rb");
+    if (!partial_file)
     {
-        const Component *component = &CONFIG_REQUIRED_COMPONENTS[i];
-        if (fetch_component(component, version, output_directory) != 0)
+        return -1;
+    }
+    char buffer[65536];
+    size_t read_length;
+    curl_off_t hashed_length = 0;
+    while (hashed_length < job->resume_offset &&
+        (read_length = fread(buffer, 1, sizeof(buffer), partial_file)) > 0)
+    {
+        if (EVP_DigestUpdate(job->digest_context, buffer, read_length) != 1)
         {
-            LOG_ERROR("Required component failed: %s", component->repo_name);
+            fclose(partial_file);
             return -1;
         }
+        hashed_length += (curl_off_t)read_length;
     }
+    fclose(partial_file);
 
-    // Fetch optional components.
-    for (int i = 0; i < CONFIG_OPTIONAL_COMPONENTS_COUNT; i++)
+    return hashed_length == job->resume_offset ? 0 : -1;
+}
+
+static int start_binary_transfer(FetchJob *job, CURLM *multi)
+{
+    // Construct the release download URL.
+    char url[FETCH_URL_MAX_LENGTH];
+    build_release_asset_url(
+        job->component->repo_name, job->resolved_version,
+        job->component->repo_name, url, sizeof(url)
+    );
+
+    // Create the output directory if it does not exist.
+    job->stage = FETCH_STAGE_DOWNLOAD;
+    job->binary_attempts++;
+    common.mkdir_p(job->output_directory);
+
+    // Open the partial download, resuming any earlier attempt.
+    if (open_partial_download(job) != 0)
+    {
+        return -1;
+    }
+
+    // Initialize the digest, catching it up on the bytes already present.
+    job->digest_context = EVP_MD_CTX_new();
+    if (!job->digest_context ||
+        EVP_DigestInit_ex(job->digest_context, EVP_sha256(), NULL) != 1)
     {
-        const Component *component = &CONFIG_OPTIONAL_COMPONENTS[i];
-        if (fetch_component(component, version, output_directory) != 0)
+        LOG_ERROR("Failed to initialize checksum digest");
+        return -2;
+    }
+    if (hash_partial_download(job) != 0)
+    {
+        if (ftruncate(fileno(job->output_file), 0) != 0 ||
+            EVP_DigestInit_ex(job->digest_context, EVP_sha256(), NULL) != 1)
         {
-            LOG_WARNING("Optional component skipped: %s", component->repo_name);
+            LOG_ERROR("Failed to reset partial download %s", job->partial_path);
+            return -2;
         }
+        job->resume_offset = 0;
+    }
+
+    // Log the fetch operation.
+    if (job->resume_offset > 0)
+    {
+        LOG_INFO(
+            "Resuming %s %s at %ld bytes",
+            job->component->repo_name, job->resolved_version, (long)job->resume_offset
+        );
+    }
+    else
+    {
+        LOG_INFO("Fetching %s %s", job->component->repo_name, job->resolved_version);
+    }
+
+    // Create the transfer, requesting only the missing range and keeping
+    // error pages out of the partial download.
+    job->binary_handle = create_transfer_handle(job, url, write_binary_chunk, job);
+    if (!job->binary_handle)
+    {
+        return -3;
+    }
+    curl_easy_setopt(job->binary_handle, CURLOPT_FAILONERROR, 1L);
+    if (job->resume_offset > 0)
+    {
+        curl_easy_setopt(job->binary_handle, CURLOPT_RESUME_FROM_LARGE, job->resume_offset);
+    }
+
+    // Hand the transfer to the multi handle.
+    if (curl_multi_add_handle(multi, job->binary_handle) != CURLM_OK)
+    {
+        return -4;
+    }
+
+    return 0;
+}
+
+static int is_fetch_job_pending(const FetchJob *job)
+{
+    return job->stage != FETCH_STAGE_DONE && job->stage != FETCH_STAGE_FAILED;
+}
+
+static int finalize_fetch_job(FetchJob *job)
+{
+    // Wait until both the binary and its checksum have arrived.
+    if (!job->binary_complete || !job->checksum_complete)
+    {
+        return 0;
+    }
+
+    // Verify the streamed hash against the published checksum.
+    const char *expected_hash = job->has_expected_hash ? job->expected_hash : NULL;
+    if (verify_checksum(job->component->repo_name, expected_hash, job->actual_hash) != 0)
+    {
+        return -1;
+    }
+
+    // Store the verified binary for later builds (best-effort).
+    if (job->has_expected_hash &&
+        store_cached_component(
+            job->component, job->resolved_version,
+            job->expected_hash, job->output_path) != 0)
+    {
+        LOG_WARNING("Failed to cache %s", job->component->repo_name);
+    }
+
+    job->stage = FETCH_STAGE_DONE;
+
+    return 0;
+}
+
+static int place_release_binary(FetchJob *job, CURLM *multi)
+{
+    // Serve the binary from the persistent cache when possible.
+    common.mkdir_p(job->output_directory);
+    if (job->has_expected_hash &&
+        lookup_cached_component(
+            job->component, job->resolved_version,
+            job->expected_hash, job->output_path) == 0)
+    {
+        job->stage = FETCH_STAGE_DONE;
+        return 0;
+    }
+
+    // Otherwise download the binary.
+    return start_binary_transfer(job, multi);
+}
+
+static int apply_release_checksums(FetchJob *job, CURLM *multi)
+{
+    // Look up the expected hash in the release's shared table.
+    const char *expected_hash = find_checksum_table_entry(job->checksums, job->component->repo_name);
+    if (expected_hash)
+    {
+        snprintf(job->expected_hash, sizeof(job->expected_hash), "%s", expected_hash);
+        job->has_expected_hash = 1;
+    }
+    job->checksum_complete = 1;
+
+    // Finish verification if the binary is already downloading.
+    if (job->stage == FETCH_STAGE_DOWNLOAD)
+    {
+        return finalize_fetch_job(job);
+    }
+
+    return place_release_binary(job, multi);
+}
+
+static int start_locked_fetch_job(FetchJob *job, CURLM *multi, const ComponentLock *lock)
+{
+    // Take the pinned release and hash in place of resolution and manifests.
+    LOG_INFO("Using locked %s version: %s", job->component->repo_name, lock->version);
+    snprintf(job->resolved_version, sizeof(job->resolved_version), "%s", lock->version);
+    snprintf(job->expected_hash, sizeof(job->expected_hash), "%s", lock->sha256);
+    job->has_expected_hash = 1;
+    job->checksum_complete = 1;
+
+    // Construct the local output file path.
+    snprintf(
+        job->output_path, sizeof(job->output_path),
+        "%s/%s", job->output_directory, job->component->repo_name
+    );
+
+    return place_release_binary(job, multi);
+}
+
+static int resume_waiting_job(FetchJob *job, CURLM *multi)
+{
+    // Skip jobs that are not waiting on another job's manifest fetch.
+    if (!is_fetch_job_pending(job) || job->stage == FETCH_STAGE_RESOLVE ||
+        job->checksum_complete || job->checksum_handle)
+    {
+        return 0;
+    }
+
+    // Take over the fetch if its previous owner failed.
+    if (job->checksums->state == CHECKSUM_TABLE_EMPTY)
+    {
+        return start_checksum_transfer(job, multi);
+    }
+
+    // Apply the manifest once it has arrived.
+    if (job->checksums->state == CHECKSUM_TABLE_READY ||
+        job->checksums->state == CHECKSUM_TABLE_UNAVAILABLE)
+    {
+        return apply_release_checksums(job, multi);
+    }
+
+    return 0;
+}
+
+static int finish_resolve_transfer(FetchJob *job, CURLM *multi, CURLcode result)
+{
+    // Resolve the version to the latest within the major version.
+    int resolve_result = complete_releases_request(
+        &job->releases, job->resolve_handle, result,
+        job->component->repo_name, job->version,
+        job->resolved_version, sizeof(job->resolved_version)
+    );
+    release_transfer(multi, &job->resolve_handle);
+
+    // Request the next page of the listing if the version is not settled.
+    if (resolve_result == 1)
+    {
+        if (prepare_next_releases_page(&job->releases, &job->resolve_handle) != 0)
+        {
+            return -1;
+        }
+        curl_easy_setopt(job->resolve_handle, CURLOPT_PRIVATE, job);
+        if (curl_multi_add_handle(multi, job->resolve_handle) != CURLM_OK)
+        {
+            return -2;
+        }
+        return 0;
+    }
+    cleanup_releases_request(&job->releases);
+
+    // Leave requests refused for the rate limit to resume_deferred_resolve().
+    if (resolve_result == 2)
+    {
+        LOG_WARNING(
+            "GitHub API rate limit exhausted, deferring %s",
+            job->component->repo_name
+        );
+        return 0;
+    }
+    if (resolve_result == -2)
+    {
+        // API failure - fall back to exact version.
+        LOG_WARNING(
+            "Version resolution failed for %s, using exact version %s",
+            job->component->repo_name, job->version
+        );
+        strncpy(job->resolved_version, job->version, sizeof(job->resolved_version) - 1);
+        job->resolved_version[sizeof(job->resolved_version) - 1] = '\0';
+    }
+    else if (resolve_result < 0)
+    {
+        // Other failures (invalid format, parse error, no matching version).
+        return -1;
+    }
+
+    // Construct the local output file path.
+    snprintf(
+        job->output_path, sizeof(job->output_path),
+        "%s/%s", job->output_directory, job->component->repo_name
+    );
+
+    // Acquire the release's shared checksum table.
+    job->checksums = acquire_release_checksums(job->component->repo_name, job->resolved_version);
+    if (!job->checksums)
+    {
+        LOG_ERROR("Failed to allocate checksum table for %s", job->component->repo_name);
+        return -2;
+    }
+
+    // Load the manifest from the persistent cache if no job has yet.
+    if (job->checksums->state == CHECKSUM_TABLE_EMPTY)
+    {
+        load_cached_checksums(job->checksums);
+    }
+
+    // Use the table right away when it is already known.
+    if (job->checksums->state == CHECKSUM_TABLE_READY ||
+        job->checksums->state == CHECKSUM_TABLE_UNAVAILABLE)
+    {
+        return apply_release_checksums(job, multi);
+    }
+
+    // Fetch the manifest unless another job already is.
+    if (job->checksums->state == CHECKSUM_TABLE_EMPTY &&
+        start_checksum_transfer(job, multi) != 0)
+    {
+        return -3;
+    }
+
+    // Await the manifest first when the cache may already hold the binary.
+    if (has_cached_component_version(job->component, job->resolved_version))
+    {
+        job->stage = FETCH_STAGE_AWAIT_CHECKSUMS;
+        return 0;
+    }
+
+    // Otherwise download the binary while the manifest arrives.
+    return start_binary_transfer(job, multi);
+}
+
+static int finish_checksum_transfer(FetchJob *job, CURLM *multi, CURLcode result)
+{
+    // Get the HTTP status and release the transfer.
+    long http_code = get_transfer_status(job->checksum_handle, result);
+    release_transfer(multi, &job->checksum_handle);
+    fclose(job->checksums_stream);
+    job->checksums_stream = NULL;
+
+    // Parse the manifest into the shared table, treating a missing one as none.
+    job->checksums->state = CHECKSUM_TABLE_UNAVAILABLE;
+    if (result == CURLE_OK && http_code == 200 && job->checksums_data &&
+        parse_checksum_table(job->checksums, job->checksums_data, job->checksums_size) == 0)
+    {
+        // Keep the manifest for later builds (best-effort).
+        if (store_cached_checksums(job->checksums, job->checksums_data, job->checksums_size) != 0)
+        {
+            LOG_WARNING("Failed to cache checksums for %s", job->component->repo_name);
+        }
+    }
+    free(job->checksums_data);
+    job->checksums_data = NULL;
+
+    return apply_release_checksums(job, multi);
+}
+
+static int is_retryable_download(CURLcode result, long http_code)
+{
+    // Local write failures and missing mirror files will not resolve
+    // themselves.
+    if (result == CURLE_WRITE_ERROR || result == CURLE_FILE_COULDNT_READ_FILE)
+    {
+        return 0;
+    }
+
+    // Retry timeouts, rejected ranges, throttling and server-side errors.
+    if (result == CURLE_OK || result == CURLE_HTTP_RETURNED_ERROR)
+    {
+        return http_code == 408 || http_code == 416 ||
+            http_code == 429 || http_code >= 500;
+    }
+
+    // Network failures and stalls are always worth retrying.
+    return 1;
+}
+
+static int place_completed_download(FetchJob *job)
+{
+    // Move the finished download into the build, copying across filesystems.
+    if (rename(job->partial_path, job->output_path) == 0)
+    {
+        return 0;
+    }
+    if (clone_file(job->partial_path, job->output_path) != 0 &&
+        common.copy_file(job->partial_path, job->output_path) != 0)
+    {
+        return -1;
+    }
+    unlink(job->partial_path);
+
+    return 0;
+}
+
+static int finish_binary_transfer(FetchJob *job, CURLM *multi, CURLcode result)
+{
+    // Get the HTTP status and release the transfer.
+    long http_code = get_transfer_status(job->binary_handle, result);
+    release_transfer(multi, &job->binary_handle);
+    fclose(job->output_file);
+    job->output_file = NULL;
+
+    // Schedule a retry with backoff for transient failures.
+    if (is_retryable_download(result, http_code) && job->binary_attempts < FETCH_MAX_ATTEMPTS)
+    {
+        // A rejected range means the partial download is unusable.
+        if (http_code == 416)
+        {
+            unlink(job->partial_path);
+        }
+
+        int delay = FETCH_RETRY_DELAY_SECONDS << (job->binary_attempts - 1);
+        LOG_WARNING(
+            "Download of %s interrupted (%s), retrying in %ds (attempt %d/%d)",
+            job->component->repo_name,
+            result == CURLE_OK || result == CURLE_HTTP_RETURNED_ERROR ?
+                "server error" : curl_easy_strerror(result),
+            delay, job->binary_attempts + 1, FETCH_MAX_ATTEMPTS
+        );
+        EVP_MD_CTX_free(job->digest_context);
+        job->digest_context = NULL;
+        job->binary_retry_at = time(NULL) + delay;
+        return 0;
+    }
+
+    // Check for curl errors.
+    if (result != CURLE_OK && result != CURLE_HTTP_RETURNED_ERROR)
+    {
+        LOG_ERROR("Download failed: %s", curl_easy_strerror(result));
+        return -1;
+    }
+
+    // Check for HTTP errors.
+    if (http_code != 200 && http_code != 206)
+    {
+        LOG_ERROR("Download failed: HTTP %ld", http_code);
+        return -2;
+    }
+
+    // Move the completed download into place.
+    if (place_completed_download(job) != 0)
+    {
+        LOG_ERROR("Failed to place %s: %s", job->output_path, strerror(errno));
+        return -3;
+    }
+
+    // Validate downloaded file size.
+    struct stat file_stat;
+    if (stat(job->output_path, &file_stat) != 0 || file_stat.st_size == 0)
+    {
+        LOG_ERROR("Download failed: empty or missing file for %s", job->component->repo_name);
+        return -3;
+    }
+
+    LOG_INFO("Downloaded %s (%ld bytes)", job->component->repo_name, (long)file_stat.st_size);
+
+    // Finish the streamed digest and format it as hex.
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_length = 0;
+    int digest_result = EVP_DigestFinal_ex(job->digest_context, digest, &digest_length);
+    EVP_MD_CTX_free(job->digest_context);
+    job->digest_context = NULL;
+    if (digest_result != 1 || digest_length * 2 + 1 != COMMON_SHA256_HEX_LENGTH)
+    {
+        LOG_ERROR("Failed to compute checksum for %s", job->output_path);
+        return -4;
+    }
+    for (unsigned int i = 0; i < digest_length; i++)
+    {
+        snprintf(job->actual_hash + i * 2, 3, "%02x", digest[i]);
+    }
+    job->binary_complete = 1;
+
+    return finalize_fetch_job(job);
+}
+
+static int resume_deferred_resolve(FetchJob *job, CURLM *multi)
+{
+    // Skip jobs whose releases request is not being held back.
+    if (job->stage != FETCH_STAGE_RESOLVE || job->resolve_handle)
+    {
+        return 0;
+    }
+
+    // Resolve from cached releases when no request was needed.
+    if (job->releases.retry_at == 0)
+    {
+        return finish_resolve_transfer(job, multi, CURLE_OK);
+    }
+
+    // Retry the request once the rate limit has reset.
+    if (time(NULL) >= job->releases.retry_at)
+    {
+        return start_resolve_transfer(job, multi);
+    }
+
+    return 0;
+}
+
+static int resume_binary_retry(FetchJob *job, CURLM *multi)
+{
+    // Skip jobs without a download waiting out its backoff.
+    if (job->stage != FETCH_STAGE_DOWNLOAD || job->binary_handle ||
+        job->binary_retry_at == 0)
+    {
+        return 0;
+    }
+
+    // Restart the download once the backoff has elapsed.
+    if (time(NULL) >= job->binary_retry_at)
+    {
+        job->binary_retry_at = 0;
+        return start_binary_transfer(job, multi);
+    }
+
+    return 0;
+}
+
+static void advance_fetch_job(
+    FetchJob *job, CURLM *multi, CURL *handle, CURLcode result
+)
+{
+    int advance_result = 0;
+
+    // Finish whichever transfer completed, which may start the next one.
+    if (handle == job->resolve_handle)
+    {
+        advance_result = finish_resolve_transfer(job, multi, result);
+    }
+    else if (handle == job->checksum_handle)
+    {
+        advance_result = finish_checksum_transfer(job, multi, result);
+    }
+    else if (handle == job->binary_handle)
+    {
+        advance_result = finish_binary_transfer(job, multi, result);
+    }
+
+    // Fail the job if any transfer could not complete.
+    if (advance_result != 0)
+    {
+        fail_fetch_job(job, multi);
+    }
+}
+
+static int count_pending_fetch_jobs(const FetchJob *jobs, int job_count)
+{
+    int pending_count = 0;
+    for (int i = 0; i < job_count; i++)
+    {
+        pending_count += is_fetch_job_pending(&jobs[i]);
+    }
+    return pending_count;
+}
+
+static int run_fetch_jobs(FetchJob *jobs, int job_count)
+{
+    // Drive every transfer through the build's shared multi handle.
+    CURLM *multi = fetch_multi;
+    if (!multi)
+    {
+        LOG_ERROR("Fetch module is not initialized");
+        return -1;
+    }
+
+    // Start each job, preferring local binaries over remote downloads.
+    for (int i = 0; i < job_count; i++)
+    {
+        FetchJob *job = &jobs[i];
+        if (copy_local_component(job->component, job->output_directory) == 0)
+        {
+            job->stage = FETCH_STAGE_DONE;
+            continue;
+        }
+        const ComponentLock *lock = find_component_lock(job->component->repo_name);
+        int start_result = lock ?
+            start_locked_fetch_job(job, multi, lock) :
+            start_resolve_transfer(job, multi);
+        if (start_result != 0)
+        {
+            fail_fetch_job(job, multi);
+        }
+    }
+
+    // Drive all transfers until every job settles or a required one fails.
+    int aborted = 0;
+    while (!aborted && count_pending_fetch_jobs(jobs, job_count) > 0)
+    {
+        // Let curl progress every active transfer.
+        int running = 0;
+        if (curl_multi_perform(multi, &running) != CURLM_OK)
+        {
+            LOG_ERROR("Failed to drive component downloads");
+            aborted = 1;
+            break;
+        }
+
+        // Advance each job whose current transfer has finished.
+        CURLMsg *message;
+        int queued = 0;
+        while ((message = curl_multi_info_read(multi, &queued)) != NULL)
+        {
+            if (message->msg != CURLMSG_DONE)
+            {
+                continue;
+            }
+            char *private_data = NULL;
+            curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &private_data);
+            FetchJob *job = (FetchJob *)private_data;
+            advance_fetch_job(job, multi, message->easy_handle, message->data.result);
+        }
+
+        // Resume jobs waiting on the rate limit, a retry backoff, or a
+        // manifest another job fetched (or dropped).
+        for (int i = 0; i < job_count; i++)
+        {
+            if (resume_deferred_resolve(&jobs[i], multi) != 0 ||
+                resume_binary_retry(&jobs[i], multi) != 0 ||
+                resume_waiting_job(&jobs[i], multi) != 0)
+            {
+                fail_fetch_job(&jobs[i], multi);
+            }
+        }
+
+        // Stop early when a required job fails or the build is interrupted.
+        for (int i = 0; i < job_count; i++)
+        {
+            if (jobs[i].stage == FETCH_STAGE_FAILED && jobs[i].required)
+            {
+                aborted = 1;
+            }
+        }
+        if (common.check_interrupted())
+        {
+            aborted = 1;
+        }
+
+        // Wait for network activity on the remaining transfers.
+        if (!aborted && count_pending_fetch_jobs(jobs, job_count) > 0)
+        {
+            curl_multi_poll(multi, NULL, 0, FETCH_POLL_TIMEOUT_MS, NULL);
+        }
+    }
+
+    // Fail any jobs left unfinished by an abort.
+    for (int i = 0; i < job_count; i++)
+    {
+        if (is_fetch_job_pending(&jobs[i]))
+        {
+            fail_fetch_job(&jobs[i], multi);
+        }
+    }
+
+    // Record the release and hash of every fetched component for lockfiles.
+    for (int i = 0; i < job_count; i++)
+    {
+        const FetchJob *job = &jobs[i];
+        if (job->stage != FETCH_STAGE_DONE || job->resolved_version[0] == '\0')
+        {
+            continue;
+        }
+        const char *sha256 = job->actual_hash[0] != '\0' ? job->actual_hash : job->expected_hash;
+        if (record_component_lock(job->component->repo_name, job->resolved_version, sha256) != 0)
+        {
+            LOG_WARNING("Failed to record lock for %s", job->component->repo_name);
+        }
+    }
+
+    return aborted ? -1 : 0;
+}
+
+int init_fetch(void)
+{
+    // Initialize the curl library globally.
+    CURLcode result = curl_global_init(CURL_GLOBAL_DEFAULT);
+    if (result != CURLE_OK)
+    {
+        return -1;
+    }
+
+    // Share DNS lookups, TLS sessions and connections across every handle.
+    fetch_share = curl_share_init();
+    if (!fetch_share)
+    {
+        curl_global_cleanup();
+        return -2;
+    }
+    curl_share_setopt(fetch_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(fetch_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(fetch_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+
+    // Create the multi handle, multiplexing transfers over HTTP/2.
+    fetch_multi = curl_multi_init();
+    if (!fetch_multi)
+    {
+        curl_share_cleanup(fetch_share);
+        fetch_share = NULL;
+        curl_global_cleanup();
+        return -3;
+    }
+    curl_multi_setopt(fetch_multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+    return 0;
+}
+
+void configure_fetch_handle(CURL *handle)
+{
+    // Join the shared network context and prefer multiplexed HTTP/2.
+    if (fetch_share)
+    {
+        curl_easy_setopt(handle, CURLOPT_SHARE, fetch_share);
+    }
+    curl_easy_setopt(handle, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(handle, CURLOPT_PIPEWAIT, 1L);
+    curl_easy_setopt(handle, CURLOPT_USERAGENT, CONFIG_USER_AGENT);
+
+    // Abort connections that cannot be made and transfers that stall,
+    // however long a healthy transfer takes.
+    curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT, (long)FETCH_CONNECT_TIMEOUT_SECONDS);
+    curl_easy_setopt(handle, CURLOPT_LOW_SPEED_LIMIT, (long)FETCH_STALL_SPEED_BYTES);
+    curl_easy_setopt(handle, CURLOPT_LOW_SPEED_TIME, (long)FETCH_STALL_SECONDS);
+}
+
+void cleanup_fetch(void)
+{
+    // Release the checksum tables shared during the build.
+    clear_release_checksums();
+
+    // Release the shared network context.
+    if (fetch_multi)
+    {
+        curl_multi_cleanup(fetch_multi);
+        fetch_multi = NULL;
+    }
+    if (fetch_share)
+    {
+        curl_share_cleanup(fetch_share);
+        fetch_share = NULL;
+    }
+
+    // Clean up the curl library globally.
+    curl_global_cleanup();
+}
+
+int fetch_component(
+    const Component *component,
+    const char *version,
+    const char *output_directory
+)
+{
+    // Describe the single component as a fetch job.
+    FetchJob job;
+    memset(&job, 0, sizeof(job));
+    job.component = component;
+    job.version = version;
+    job.output_directory = output_directory;
+    job.required = 1;
+
+    // Run the job to completion.
+    run_fetch_jobs(&job, 1);
+
+    return job.stage == FETCH_STAGE_DONE ? 0 : -1;
+}
+
+int fetch_all_components(const char *version, const char *output_directory)
+{
+    FetchJob jobs[CONFIG_REQUIRED_COMPONENTS_COUNT + CONFIG_OPTIONAL_COMPONENTS_COUNT];
+    int job_count = 0;
+
+    LOG_INFO("Fetching LimeOS components...");
+
+    // Describe every required and optional component as a fetch job.
+    memset(jobs, 0, sizeof(jobs));
+    for (int i = 0; i < CONFIG_REQUIRED_COMPONENTS_COUNT; i++)
+    {
+        jobs[job_count].component = &CONFIG_REQUIRED_COMPONENTS[i];
+        jobs[job_count].required = 1;
+        job_count++;
+    }
+    for (int i = 0; i < CONFIG_OPTIONAL_COMPONENTS_COUNT; i++)
+    {
+        jobs[job_count].component = &CONFIG_OPTIONAL_COMPONENTS[i];
+        jobs[job_count].required = 0;
+        job_count++;
+    }
+    for (int i = 0; i < job_count; i++)
+    {
+        jobs[i].version = version;
+        jobs[i].output_directory = output_directory;
+    }
+
+    // Fetch all components concurrently.
+    run_fetch_jobs(jobs, job_count);
+
+    // Report failures, which are fatal only for required components.
+    int required_failed = 0;
+    for (int i = 0; i < job_count; i++)
+    {
+        if (jobs[i].stage == FETCH_STAGE_DONE)
+        {
+            continue;
+        }
+        if (jobs[i].required)
+        {
+            LOG_ERROR("Required component failed: %s", jobs[i].component->repo_name);
+            required_failed = 1;
+        }
+        else
+        {
+            LOG_WARNING("Optional component skipped: %s", jobs[i].component->repo_name);
+        }
+    }
+    if (required_failed)
+    {
+        return -1;
     }
 
     LOG_INFO("All required components fetched successfully");
@@ -3,25 +3,43 @@
 /** The maximum length for URL strings. */
 #define FETCH_URL_MAX_LENGTH 512
 
-/** Network timeout in seconds for curl operations. */
+/**
+ * Total timeout in seconds for GitHub API requests.
+ *
+ * Downloads have no total timeout. They are aborted only when they stall,
+ * then resumed.
+ */
 #define FETCH_TIMEOUT_SECONDS 60
 
 /**
  * Initializes the fetch module.
  *
  * Must be called before any other fetch functions. Initializes libcurl
- * globally.
+ * globally and creates the network context shared by every request in the
+ * build, which pools DNS lookups, TLS sessions and connections.
  *
  * @return - `0` - Indicates successful initialization.
  * @return - `-1` - Indicates initialization failure.
+ * @return - `-2` - Indicates share handle creation failure.
+ * @return - `-3` - Indicates multi handle creation failure.
  */
 int init_fetch(void);
 
+/**
+ * Attaches a curl handle to the shared network context.
+ *
+ * Sets the options common to every request: the shared DNS, TLS session and
+ * connection pools, HTTP/2 multiplexing, and the user agent.
+ *
+ * @param handle The curl handle to configure.
+ */
+void configure_fetch_handle(CURL *handle);
+
 /**
  * Cleans up the fetch module.
  *
- * Should be called when the fetch module is no longer needed. Cleans up
- * libcurl.
+ * Should be called when the fetch module is no longer needed. Releases the
+ * shared network context and cleans up libcurl.
  */
 void cleanup_fetch(void);
 
@@ -44,7 +62,9 @@ int fetch_component(
 /**
  * Fetches all LimeOS components from local cache or GitHub releases.
  *
- * Fetches window-manager, display-manager, and installation-wizard binaries.
+ * Fetches every required and optional component concurrently. A failed
+ * required component aborts the remaining fetches; a failed optional
+ * component is skipped with a warning.
  *
  * @param version The release version tag to download.
  * @param output_directory The directory to save the binaries.
@@ -0,0 +1,184 @@
+/**
+ * This code is responsible for pinning components to exact releases through
+ * a lockfile.
+ *
+ * A lockfile written by one build records the release and binary hash of
+ * every component it fetched. Passing it to a later build skips version
+ * resolution and checksum manifests entirely, so components come straight
+ * from the cache or their release, and cache keys stay stable across hosts.
+ */
+
+#include "all.h"
+
+/** The components pinned by the loaded lockfile. */
+static ComponentLock *pinned_locks = NULL;
+
+/** The number of components pinned by the loaded lockfile. */
+static size_t pinned_lock_count = 0;
+
+/** The components recorded as fetched during the build. */
+static ComponentLock *recorded_locks = NULL;
+
+/** The number of components recorded as fetched during the build. */
+static size_t recorded_lock_count = 0;
+
+static int is_sha256_hex(const char *text)
+{
+    // Require exactly 64 hexadecimal digits.
+    for (int i = 0; i < COMMON_SHA256_HEX_LENGTH - 1; i++)
+    {
+        if (!isxdigit((unsigned char)text[i]))
+        {
+            return 0;
+        }
+    }
+    return text[COMMON_SHA256_HEX_LENGTH - 1] == '\0';
+}
+
+static int append_component_lock(
+    ComponentLock **locks,
+    size_t *lock_count,
+    const char *repo_name,
+    const char *version,
+    const char *sha256
+)
+{
+    // Validate that every field fits and the hash is well-formed.
+    if (!repo_name || !version || !sha256 ||
+        repo_name[0] == '\0' || strlen(repo_name) >= LOCK_NAME_MAX_LENGTH ||
+        version[0] == '\0' || strlen(version) >= COMMON_MAX_VERSION_LENGTH ||
+        !is_sha256_hex(sha256))
+    {
+        return -1;
+    }
+
+    // Grow the list by one slot.
+    ComponentLock *grown = realloc(*locks, (*lock_count + 1) * sizeof(*grown));
+    if (!grown)
+    {
+        return -2;
+    }
+    *locks = grown;
+
+    // Fill in the new lock, normalizing the hash to lowercase.
+    ComponentLock *lock = &grown[(*lock_count)++];
+    snprintf(lock->repo_name, sizeof(lock->repo_name), "%s", repo_name);
+    snprintf(lock->version, sizeof(lock->version), "%s", version);
+    for (int i = 0; i < COMMON_SHA256_HEX_LENGTH; i++)
+    {
+        lock->sha256[i] = (char)tolower((unsigned char)sha256[i]);
+    }
+
+    return 0;
+}
+
+int load_component_locks(const char *path)
+{
+    // Open the lockfile.
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        LOG_ERROR("Failed to open lockfile %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    // Pin each component listed in the lockfile.
+    char line[COMMON_MAX_PATH_LENGTH];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), file))
+    {
+        line_number++;
+
+        // Split the line into its fields, skipping blanks and comments.
+        char *context = NULL;
+        char *repo_name = strtok_r(line, " \t\r\n", &context);
+        if (!repo_name || repo_name[0] == '#')
+        {
+            continue;
+        }
+        char *version = strtok_r(NULL, " \t\r\n", &context);
+        char *sha256 = strtok_r(NULL, " \t\r\n", &context);
+        char *extra = strtok_r(NULL, " \t\r\n", &context);
+
+        // Reject lines with missing, extra, or invalid fields.
+        int append_result = extra ? -1 : append_component_lock(
+            &pinned_locks, &pinned_lock_count, repo_name, version, sha256
+        );
+        if (append_result != 0)
+        {
+            fclose(file);
+            if (append_result == -2)
+            {
+                return -3;
+            }
+            LOG_ERROR("Malformed lockfile line %d in %s", line_number, path);
+            return -2;
+        }
+    }
+
+    fclose(file);
+    LOG_INFO("Loaded %zu pinned components from %s", pinned_lock_count, path);
+
+    return 0;
+}
+
+const ComponentLock *find_component_lock(const char *repo_name)
+{
+    for (size_t i = 0; i < pinned_lock_count; i++)
+    {
+        if (strcmp(pinned_locks[i].repo_name, repo_name) == 0)
+        {
+            return &pinned_locks[i];
+        }
+    }
+    return NULL;
+}
+
+int record_component_lock(const char *repo_name, const char *version, const char *sha256)
+{
+    return append_component_lock(
+        &recorded_locks, &recorded_lock_count, repo_name, version, sha256
+    );
+}
+
+int save_component_locks(const char *path)
+{
+    // Write the lockfile under a temporary name.
+    char staging_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(staging_path, sizeof(staging_path), "%s.%d.tmp", path, getpid());
+    FILE *file = fopen(staging_path, "w");
+    if (!file)
+    {
+        LOG_ERROR("Failed to create lockfile %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    // Write one line per recorded component.
+    int write_failed = fprintf(file, "# LimeOS ISO builder component lockfile\n") < 0;
+    for (size_t i = 0; i < recorded_lock_count && !write_failed; i++)
+    {
+        const ComponentLock *lock = &recorded_locks[i];
+        write_failed = fprintf(file, "%s %s %s\n", lock->repo_name, lock->version, lock->sha256) < 0;
+    }
+
+    // Publish the lockfile atomically.
+    if (fclose(file) != 0 || write_failed || rename(staging_path, path) != 0)
+    {
+        LOG_ERROR("Failed to write lockfile %s", path);
+        unlink(staging_path);
+        return -2;
+    }
+    LOG_INFO("Wrote %zu component locks to %s", recorded_lock_count, path);
+
+    return 0;
+}
+
+void clear_component_locks(void)
+{
+    free(pinned_locks);
+    pinned_locks = NULL;
+    pinned_lock_count = 0;
+    free(recorded_locks);
+    recorded_locks = NULL;
+    recorded_lock_count = 0;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "../all.h"
+
+/** The maximum length of a component repository name in a lockfile. */
+#define LOCK_NAME_MAX_LENGTH 128
+
+/** A type representing a component pinned to a release and binary hash. */
+typedef struct
+{
+    char repo_name[LOCK_NAME_MAX_LENGTH];
+    char version[COMMON_MAX_VERSION_LENGTH];
+    char sha256[COMMON_SHA256_HEX_LENGTH];
+} ComponentLock;
+
+/**
+ * Loads the component versions to pin from a lockfile.
+ *
+ * Each non-blank line that is not a `#` comment holds a repository name,
+ * a release version tag, and the SHA-256 of the component binary,
+ * separated by whitespace.
+ *
+ * @param path The path to the lockfile.
+ *
+ * @return - `0` - Indicates the lockfile was loaded.
+ * @return - `-1` - Indicates the lockfile could not be opened.
+ * @return - `-2` - Indicates a malformed line.
+ * @return - `-3` - Indicates memory allocation failure.
+ */
+int load_component_locks(const char *path);
+
+/**
+ * Finds the pinned release of a component.
+ *
+ * @param repo_name The component repository name.
+ *
+ * @return The component's lock, or `NULL` if it is not pinned.
+ */
+const ComponentLock *find_component_lock(const char *repo_name);
+
+/**
+ * Records the release and binary hash a component was fetched at.
+ *
+ * @param repo_name The component repository name.
+ * @param version The resolved release version tag.
+ * @param sha256 The SHA-256 of the component binary (hex).
+ *
+ * @return - `0` - Indicates the component was recorded.
+ * @return - `-1` - Indicates an invalid name, version, or hash.
+ * @return - `-2` - Indicates memory allocation failure.
+ */
+int record_component_lock(const char *repo_name, const char *version, const char *sha256);
+
+/**
+ * Writes every recorded component to a lockfile.
+ *
+ * @param path The path to write the lockfile to.
+ *
+ * @return - `0` - Indicates the lockfile was written.
+ * @return - `-1` - Indicates the lockfile could not be created.
+ * @return - `-2` - Indicates the lockfile could not be written.
+ */
+int save_component_locks(const char *path);
+
+/** Releases every pinned and recorded component lock. */
+void clear_component_locks(void);
@@ -1,26 +1,311 @@
 /**
  * This code is responsible for resolving component versions via the GitHub API.
+ *
+ * Releases listings are parsed incrementally as they stream in, following
+ * pagination until the target major version is found and a page ends past
+ * it, so memory stays flat however many releases a repository has. Each
+ * listing is reduced to the newest stable tag per major version and kept on
+ * disk with its ETag, keyed by URL. Later requests send If-None-Match, so an
+ * unchanged listing comes back as an empty 304 rather than being downloaded
+ * and parsed again. The builder sends no credentials, and GitHub only exempts
+ * a 304 from the rate limit for authenticated requests, so it still counts
+ * as a request. When the rate limit is exhausted, cached listings are reused
+ * and uncached requests are deferred until the limit resets, whether the
+ * exhaustion was known beforehand or reported by the refused request itself.
  */
 
 #include "all.h"
 
 /**
- * The initial buffer size for API response data.
+ * The longest wait in seconds for a rate limit reset before giving up.
  *
- * 8KB is sufficient for typical GitHub releases API responses containing
- * 10-20 releases. The buffer grows dynamically if needed.
+ * Beyond this, resolving a listing that is not cached fails rather than
+ * stalling the build or settling for the exact version.
  */
-#define API_BUFFER_SIZE 8192
+#define RATE_LIMIT_MAX_WAIT_SECONDS 60
 
-/**
- * A type representing a dynamically growing buffer for HTTP response data.
- */
-typedef struct
+/** The remaining API requests reported by the latest response, or -1. */
+static long rate_limit_remaining = -1;
+
+/** The time the API rate limit resets, as reported by the latest response. */
+static time_t rate_limit_reset = 0;
+
+static int has_release_candidate(
+    const ReleaseCandidate *candidates,
+    int candidate_count,
+    int major
+)
+{
+    for (int i = 0; i < candidate_count; i++)
+    {
+        if (candidates[i].major == major)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void add_release_candidate(ReleasesRequest *request, const char *tag_name)
+{
+    // Ignore tags that are not versions.
+    int major = common.get_version_major(tag_name);
+    if (major < 0)
+    {
+        return;
+    }
+
+    // Keep the newer tag when the major version is already known.
+    for (int i = 0; i < request->candidate_count; i++)
+    {
+        ReleaseCandidate *candidate = &request->candidates[i];
+        if (candidate->major == major)
+        {
+            if (common.compare_versions(tag_name, candidate->tag) > 0)
+            {
+                snprintf(candidate->tag, sizeof(candidate->tag), "%s", tag_name);
+            }
+            return;
+        }
+    }
+
+    // Otherwise remember it as the first tag of its major version.
+    if (request->candidate_count < RESOLVE_MAX_MAJOR_VERSIONS)
+    {
+        ReleaseCandidate *candidate = &request->candidates[request->candidate_count++];
+        candidate->major = major;
+        snprintf(candidate->tag, sizeof(candidate->tag), "%s", tag_name);
+    }
+}
+
+static void append_parser_token(ReleasesParser *parser, char character)
+{
+    // Keep only what fits, remembering that the token was cut short.
+    if (parser->token_length < sizeof(parser->token) - 1)
+    {
+        parser->token[parser->token_length++] = character;
+    }
+    else
+    {
+        parser->is_token_truncated = 1;
+    }
+}
+
+static void finish_parser_string(ReleasesParser *parser)
+{
+    parser->token[parser->token_length] = '\0';
+
+    // Remember keys so the value that follows can be recognized.
+    if (parser->expects_key)
+    {
+        if (parser->is_token_truncated || parser->token_length >= sizeof(parser->key))
+        {
+            parser->key[0] = '\0';
+        }
+        else
+        {
+            memcpy(parser->key, parser->token, parser->token_length + 1);
+        }
+    }
+
+    // Capture the release tag, discarding any that did not fit.
+    else if (strcmp(parser->key, "tag_name") == 0)
+    {
+        if (parser->is_token_truncated)
+        {
+            parser->tag[0] = '\0';
+        }
+        else
+        {
+            memcpy(parser->tag, parser->token, parser->token_length + 1);
+        }
+    }
+
+    parser->token_length = 0;
+    parser->is_token_truncated = 0;
+}
+
+static void finish_parser_literal(ReleasesParser *parser)
+{
+    parser->token[parser->token_length] = '\0';
+
+    // Capture the release flags.
+    if (strcmp(parser->key, "prerelease") == 0)
+    {
+        parser->is_prerelease = strcmp(parser->token, "true") == 0;
+    }
+    else if (strcmp(parser->key, "draft") == 0)
+    {
+        parser->is_draft = strcmp(parser->token, "true") == 0;
+    }
+
+    parser->token_length = 0;
+    parser->is_token_truncated = 0;
+}
+
+semistatic void feed_releases_parser(
+    ReleasesRequest *request,
+    const char *data,
+    size_t length
+)
+{
+    ReleasesParser *parser = &request->parser;
+
+    for (size_t i = 0; i < length && parser->status == 0; i++)
+    {
+        char character = data[i];
+
+        // Consume string contents, keeping only those of release fields.
+        if (parser->is_in_string)
+        {
+            if (parser->is_escaped)
+            {
+                parser->is_escaped = 0;
+            }
+            else if (character == '\\')
+            {
+                parser->is_escaped = 1;
+                continue;
+            }
+            else if (character == '"')
+            {
+                parser->is_in_string = 0;
+                if (parser->depth == 2)
+                {
+                    finish_parser_string(parser);
+                }
+                continue;
+            }
+            if (parser->depth == 2)
+            {
+                append_parser_token(parser, character);
+            }
+            continue;
+        }
+
+        // Skip whitespace between tokens.
+        int is_whitespace = isspace((unsigned char)character);
+
+        // Require the listing to be a single array.
+        if (!parser->has_started)
+        {
+            if (is_whitespace)
+            {
+                continue;
+            }
+            if (character != '[')
+            {
+                parser->status = -4;
+                return;
+            }
+            parser->has_started = 1;
+            parser->depth = 1;
+            continue;
+        }
+        if (parser->depth == 0)
+        {
+            if (!is_whitespace)
+            {
+                parser->status = -3;
+            }
+            continue;
+        }
+
+        // Accumulate literal values of release fields.
+        if (parser->depth == 2 && !parser->expects_key &&
+            (isalnum((unsigned char)character) || character == '-' ||
+             character == '+' || character == '.'))
+        {
+            append_parser_token(parser, character);
+            continue;
+        }
+        if (parser->token_length > 0)
+        {
+            finish_parser_literal(parser);
+        }
+        if (is_whitespace)
+        {
+            continue;
+        }
+
+        // Track the structure, finishing each release as it closes.
+        switch (character)
+        {
+            case '"':
+                parser->is_in_string = 1;
+                break;
+            case '{':
+                parser->depth++;
+                if (parser->depth == 2)
+                {
+                    parser->expects_key = 1;
+                    parser->key[0] = '\0';
+                    parser->tag[0] = '\0';
+                    parser->is_prerelease = 0;
+                    parser->is_draft = 0;
+                }
+                break;
+            case '[':
+                parser->depth++;
+                break;
+            case '}':
+                if (parser->depth < 2)
+                {
+                    parser->status = -3;
+                    return;
+                }
+                if (parser->depth == 2 && parser->tag[0] != '\0')
+                {
+                    // Remember the major version the page has reached.
+                    parser->last_major = common.get_version_major(parser->tag);
+                    if (!parser->is_prerelease && !parser->is_draft)
+                    {
+                        add_release_candidate(request, parser->tag);
+                    }
+                }
+                parser->depth--;
+                break;
+            case ']':
+                parser->depth--;
+                break;
+            case ':':
+                if (parser->depth == 2)
+                {
+                    parser->expects_key = 0;
+                }
+                break;
+            case ',':
+                if (parser->depth == 2)
+                {
+                    parser->expects_key = 1;
+                }
+                break;
+            default:
+                if (parser->depth <= 2)
+                {
+                    parser->status = -3;
+                }
+                break;
+        }
+    }
+}
+
+semistatic int finish_releases_parser(const ReleasesParser *parser)
 {
-    char *data;
-    size_t size;
-    size_t capacity;
-} ResponseBuffer;
+    // Report malformed or truncated listings.
+    if (parser->status == -4)
+    {
+        LOG_ERROR("Unexpected GitHub API response format");
+        return -4;
+    }
+    if (parser->status != 0 || !parser->has_started || parser->depth != 0 ||
+        parser->is_in_string)
+    {
+        LOG_ERROR("Failed to parse GitHub API response");
+        return -3;
+    }
+    return 0;
+}
 
 static size_t append_api_response_chunk(
     void *contents,
@@ -30,221 +315,521 @@ static size_t append_api_response_chunk(
 )
 {
     size_t total_size = size * count;
-    ResponseBuffer *buffer = (ResponseBuffer *)userdata;
+    ReleasesRequest *request = (ReleasesRequest *)userdata;
 
-    // Expand the buffer if needed.
-    while (buffer->size + total_size >= buffer->capacity)
+    // Parse the chunk in place rather than buffering the listing.
+    feed_releases_parser(request, (const char *)contents, total_size);
+
+    return total_size;
+}
+
+semistatic void read_next_page_link(
+    ReleasesRequest *request,
+    const char *value,
+    size_t value_length
+)
+{
+    const char *end = value + value_length;
+    const char *cursor = value;
+
+    // Walk each "<url>; rel=..." entry of the Link header.
+    while (cursor < end)
     {
-        size_t new_capacity = buffer->capacity * 2;
-        char *new_data = realloc(buffer->data, new_capacity);
-        if (!new_data)
+        const char *open = memchr(cursor, '<', (size_t)(end - cursor));
+        if (!open)
         {
-            return 0;
+            return;
+        }
+        const char *close = memchr(open, '>', (size_t)(end - open));
+        if (!close)
+        {
+            return;
+        }
+        const char *next = memchr(close, ',', (size_t)(end - close));
+        if (!next)
+        {
+            next = end;
+        }
+
+        // Take the URL of the entry whose relation is the next page.
+        char parameters[64];
+        size_t parameters_length = (size_t)(next - close - 1);
+        if (parameters_length >= sizeof(parameters))
+        {
+            parameters_length = sizeof(parameters) - 1;
+        }
+        memcpy(parameters, close + 1, parameters_length);
+        parameters[parameters_length] = '\0';
+        size_t url_length = (size_t)(close - open - 1);
+        if (strstr(parameters, "rel=\"next\"") && url_length < sizeof(request->next_url))
+        {
+            memcpy(request->next_url, open + 1, url_length);
+            request->next_url[url_length] = '\0';
+            return;
         }
-        buffer->data = new_data;
-        buffer->capacity = new_capacity;
+
+        cursor = next + 1;
+    }
+}
+
+semistatic size_t read_api_response_header(
+    char *header,
+    size_t size,
+    size_t count,
+    void *userdata
+)
+{
+    size_t total_size = size * count;
+    ReleasesRequest *request = (ReleasesRequest *)userdata;
+
+    // Forget what earlier responses in a redirect chain reported.
+    if (total_size > 5 && strncmp(header, "HTTP/", 5) == 0)
+    {
+        request->next_url[0] = '\0';
+        request->rate_limit_remaining = -1;
+        request->rate_limit_reset = 0;
+        if (request->page_count == 0)
+        {
+            request->response_etag[0] = '\0';
+        }
+        return total_size;
+    }
+
+    // Split the header into its name and trimmed value.
+    const char *separator = memchr(header, ':', total_size);
+    if (!separator)
+    {
+        return total_size;
+    }
+    size_t name_length = (size_t)(separator - header);
+    const char *value = separator + 1;
+    const char *end = header + total_size;
+    while (value < end && (*value == ' ' || *value == '\t'))
+    {
+        value++;
+    }
+    while (end > value && (end[-1] == '\r' || end[-1] == '\n' || end[-1] == ' '))
+    {
+        end--;
+    }
+    size_t value_length = (size_t)(end - value);
+
+    // Record the first page's entity tag for conditional requests.
+    if (name_length == 4 && strncasecmp(header, "ETag", 4) == 0 &&
+        request->page_count == 0 && value_length < sizeof(request->response_etag))
+    {
+        memcpy(request->response_etag, value, value_length);
+        request->response_etag[value_length] = '\0';
+    }
+
+    // Record the next page of the listing, if any.
+    if (name_length == 4 && strncasecmp(header, "Link", 4) == 0)
+    {
+        read_next_page_link(request, value, value_length);
     }
 
-    // Append the new data to the buffer.
-    memcpy(buffer->data + buffer->size, contents, total_size);
-    buffer->size += total_size;
-    buffer->data[buffer->size] = '\0';
+    // Track the rate limit shared by every API request in the build, and
+    // what this response reported of it.
+    if (name_length == 21 && strncasecmp(header, "X-RateLimit-Remaining", 21) == 0)
+    {
+        request->rate_limit_remaining = strtol(value, NULL, 10);
+        rate_limit_remaining = request->rate_limit_remaining;
+    }
+    if (name_length == 17 && strncasecmp(header, "X-RateLimit-Reset", 17) == 0)
+    {
+        request->rate_limit_reset = (time_t)strtoll(value, NULL, 10);
+        rate_limit_reset = request->rate_limit_reset;
+    }
 
     return total_size;
 }
 
-static int fetch_releases_json(
+static void build_cache_path(const char *url, char *out_path, size_t path_length)
+{
+    // Key the entry by the SHA-256 of the URL so any URL maps to a filename.
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_length = 0;
+    char hex[EVP_MAX_MD_SIZE * 2 + 1] = {0};
+    EVP_Digest(url, strlen(url), digest, &digest_length, EVP_sha256(), NULL);
+    for (unsigned int i = 0; i < digest_length; i++)
+    {
+        snprintf(hex + i * 2, 3, "%02x", digest[i]);
+    }
+
+    snprintf(out_path, path_length, CONFIG_CACHE_DIR "/releases/%s.json", hex);
+}
+
+static void load_cached_releases(ReleasesRequest *request)
+{
+    // Read the cache entry, if any.
+    json_object *root = json_object_from_file(request->cache_path);
+    if (!root)
+    {
+        return;
+    }
+
+    // Restore the entity tag and whether every page was read.
+    json_object *etag_obj;
+    json_object *complete_obj;
+    if (json_object_object_get_ex(root, "etag", &etag_obj))
+    {
+        snprintf(request->etag, sizeof(request->etag), "%s", json_object_get_string(etag_obj));
+    }
+    int is_complete = json_object_object_get_ex(root, "complete", &complete_obj) &&
+        json_object_get_boolean(complete_obj);
+
+    // Restore the newest stable tag per major version.
+    json_object *candidates_obj;
+    if (json_object_object_get_ex(root, "candidates", &candidates_obj) &&
+        json_object_is_type(candidates_obj, json_type_array))
+    {
+        size_t candidate_count = json_object_array_length(candidates_obj);
+        for (size_t i = 0; i < candidate_count && i < RESOLVE_MAX_MAJOR_VERSIONS; i++)
+        {
+            json_object *candidate_obj = json_object_array_get_idx(candidates_obj, i);
+            json_object *major_obj;
+            json_object *tag_obj;
+            if (!json_object_object_get_ex(candidate_obj, "major", &major_obj) ||
+                !json_object_object_get_ex(candidate_obj, "tag", &tag_obj))
+            {
+                continue;
+            }
+            ReleaseCandidate *candidate =
+                &request->cached_candidates[request->cached_candidate_count++];
+            candidate->major = (int)json_object_get_int64(major_obj);
+            snprintf(candidate->tag, sizeof(candidate->tag), "%s", json_object_get_string(tag_obj));
+        }
+
+        // Trust the entry only if it can answer for the target major version.
+        request->has_cached_candidates = is_complete || has_release_candidate(
+            request->cached_candidates, request->cached_candidate_count,
+            request->target_major
+        );
+    }
+
+    json_object_put(root);
+}
+
+static void store_cached_releases(const ReleasesRequest *request)
+{
+    // Describe the entity tag and candidates as JSON.
+    json_object *root = json_object_new_object();
+    json_object *candidates_obj = json_object_new_array();
+    json_object_object_add(root, "etag", json_object_new_string(request->response_etag));
+    json_object_object_add(root, "complete", json_object_new_boolean(request->next_url[0] == '\0'));
+    for (int i = 0; i < request->candidate_count; i++)
+    {
+        json_object *candidate_obj = json_object_new_object();
+        json_object_object_add(candidate_obj, "major", json_object_new_int64(request->candidates[i].major));
+        json_object_object_add(candidate_obj, "tag", json_object_new_string(request->candidates[i].tag));
+        json_object_array_add(candidates_obj, candidate_obj);
+    }
+    json_object_object_add(root, "candidates", candidates_obj);
+
+    // Write the entry under a temporary name, then publish it atomically.
+    char staging_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(staging_path, sizeof(staging_path), "%s.%d.tmp", request->cache_path, getpid());
+    common.mkdir_p(CONFIG_CACHE_DIR "/releases");
+    if (json_object_to_file_ext(staging_path, root, JSON_C_TO_STRING_PLAIN) != 0 ||
+        rename(staging_path, request->cache_path) != 0)
+    {
+        unlink(staging_path);
+        LOG_WARNING("Failed to cache GitHub API response");
+    }
+
+    json_object_put(root);
+}
+
+static int select_release_version(
+    const ReleaseCandidate *candidates,
+    int candidate_count,
     const char *component,
-    char **out_json_data
+    int target_major,
+    char *out_resolved,
+    size_t buffer_length
 )
 {
-    // Construct the GitHub API URL.
-    char url[FETCH_URL_MAX_LENGTH];
-    snprintf(
-        url, sizeof(url),
-        "%s/%s/%s/releases",
-        CONFIG_GITHUB_API_BASE, CONFIG_GITHUB_ORG, component
+    // Find the newest stable tag for the target major version.
+    for (int i = 0; i < candidate_count; i++)
+    {
+        if (candidates[i].major == target_major)
+        {
+            strncpy(out_resolved, candidates[i].tag, buffer_length - 1);
+            out_resolved[buffer_length - 1] = '\0';
+            return 0;
+        }
+    }
+
+    LOG_WARNING(
+        "No release found for %s with major version %d",
+        component, target_major
     );
+    return -5;
+}
+
+semistatic int has_next_releases_page(const ReleasesRequest *request)
+{
+    // Stop at the last page.
+    if (request->next_url[0] == '\0')
+    {
+        return 0;
+    }
 
-    // Allocate the initial response buffer.
-    ResponseBuffer buffer = {0};
-    buffer.data = malloc(API_BUFFER_SIZE);
-    if (!buffer.data)
+    // Read on until the target major version turns up, and on while a page
+    // still ends inside it. Releases are listed by creation date rather than
+    // version, so a newer tag of the major may follow on a later page. A tag
+    // published long before the releases of other majors that follow it can
+    // still be missed.
+    return !has_release_candidate(
+        request->candidates, request->candidate_count, request->target_major
+    ) || request->parser.last_major == request->target_major;
+}
+
+semistatic int defer_rate_limited_request(
+    ReleasesRequest *request,
+    long http_code,
+    time_t now
+)
+{
+    // Only a refusal that reports the limit as used up is a rate limit.
+    if ((http_code != 403 && http_code != 429) || request->rate_limit_remaining != 0)
+    {
+        return 0;
+    }
+
+    // Retry once the limit resets, if the response says that is soon.
+    if (request->rate_limit_reset > 0 &&
+        request->rate_limit_reset - now <= RATE_LIMIT_MAX_WAIT_SECONDS)
+    {
+        request->retry_at = request->rate_limit_reset + 1;
+        return 2;
+    }
+
+    // Otherwise fail rather than guess at the release.
+    if (request->rate_limit_reset > now)
+    {
+        LOG_ERROR(
+            "GitHub API rate limit exhausted, resetting in %lld seconds",
+            (long long)(request->rate_limit_reset - now)
+        );
+    }
+    else
     {
-        return -1;
+        LOG_ERROR("GitHub API rate limit exhausted");
     }
-    buffer.data[0] = '\0';
-    buffer.size = 0;
-    buffer.capacity = API_BUFFER_SIZE;
+    return -6;
+}
 
+static int create_releases_handle(
+    ReleasesRequest *request,
+    const char *url,
+    CURL **out_handle
+)
+{
     // Initialize the curl session.
     CURL *curl = curl_easy_init();
     if (!curl)
     {
-        free(buffer.data);
         return -2;
     }
 
+    // Reset the parser and headers left by the previous page.
+    memset(&request->parser, 0, sizeof(request->parser));
+    request->parser.last_major = -1;
+    request->next_url[0] = '\0';
+    request->rate_limit_remaining = -1;
+    request->rate_limit_reset = 0;
+    curl_slist_free_all(request->headers);
+    request->headers = NULL;
+
     // Set up required headers for GitHub API.
-    struct curl_slist *headers = NULL;
-    headers = curl_slist_append(headers, "Accept: application/vnd.github+json");
-    headers = curl_slist_append(headers, "X-GitHub-Api-Version: " CONFIG_GITHUB_API_VERSION);
+    request->headers = curl_slist_append(
+        request->headers, "Accept: application/vnd.github+json"
+    );
+    request->headers = curl_slist_append(
+        request->headers, "X-GitHub-Api-Version: " CONFIG_GITHUB_API_VERSION
+    );
+
+    // Make the first page conditional on the cached entity tag.
+    if (request->page_count == 0 && request->has_cached_candidates &&
+        request->etag[0] != '\0')
+    {
+        char condition[RESOLVE_ETAG_MAX_LENGTH + 32];
+        snprintf(condition, sizeof(condition), "If-None-Match: %s", request->etag);
+        request->headers = curl_slist_append(request->headers, condition);
+    }
 
     // Configure curl options for the API request.
+    configure_fetch_handle(curl);
     curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, request->headers);
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, append_api_response_chunk);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &buffer);
-    curl_easy_setopt(curl, CURLOPT_USERAGENT, CONFIG_USER_AGENT);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, request);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, read_api_response_header);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, request);
     curl_easy_setopt(curl, CURLOPT_TIMEOUT, FETCH_TIMEOUT_SECONDS);
 
-    // Perform the API request.
-    CURLcode result = curl_easy_perform(curl);
+    *out_handle = curl;
 
-    // Get the HTTP response code.
-    long http_code = 0;
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+    return 0;
+}
 
-    // Clean up curl resources.
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
+int prepare_releases_request(
+    ReleasesRequest *request,
+    const char *component,
+    const char *version,
+    CURL **out_handle
+)
+{
+    memset(request, 0, sizeof(*request));
+    *out_handle = NULL;
 
-    // Check for curl errors.
-    if (result != CURLE_OK)
+    // Extract the target major version from the user-provided version.
+    request->target_major = common.get_version_major(version);
+    if (request->target_major < 0)
     {
-        LOG_ERROR("GitHub API request failed: %s", curl_easy_strerror(result));
-        free(buffer.data);
+        LOG_ERROR("Invalid version format: %s", version);
         return -3;
     }
 
-    // Check for HTTP errors.
-    if (http_code != 200)
+    // Construct the releases index URL for the selected source.
+    char url[FETCH_URL_MAX_LENGTH];
+    build_releases_url(component, url, sizeof(url));
+
+    // Load any cached response for the URL.
+    build_cache_path(url, request->cache_path, sizeof(request->cache_path));
+    load_cached_releases(request);
+
+    // Avoid the API entirely while its rate limit is exhausted.
+    time_t now = time(NULL);
+    if (rate_limit_remaining == 0 && now < rate_limit_reset)
     {
-        LOG_ERROR("GitHub API returned HTTP %ld", http_code);
-        free(buffer.data);
-        return -4;
+        // Defer uncached requests when the limit resets soon.
+        if (!request->has_cached_candidates &&
+            rate_limit_reset - now <= RATE_LIMIT_MAX_WAIT_SECONDS)
+        {
+            request->retry_at = rate_limit_reset + 1;
+            return 2;
+        }
+        return 1;
     }
 
-    // Transfer ownership of the buffer to the caller.
-    *out_json_data = buffer.data;
+    return create_releases_handle(request, url, out_handle);
+}
 
-    return 0;
+int prepare_next_releases_page(ReleasesRequest *request, CURL **out_handle)
+{
+    char url[FETCH_URL_MAX_LENGTH];
+    snprintf(url, sizeof(url), "%s", request->next_url);
+    return create_releases_handle(request, url, out_handle);
 }
 
-int resolve_version(
+int complete_releases_request(
+    ReleasesRequest *request,
+    CURL *handle,
+    CURLcode result,
     const char *component,
     const char *version,
     char *out_resolved,
     size_t buffer_length
 )
 {
-    // Extract the target major version from the user-provided version.
-    int target_major = common.get_version_major(version);
-    if (target_major < 0)
-    {
-        LOG_ERROR("Invalid version format: %s", version);
-        return -1;
-    }
-
-    // Fetch the releases JSON from GitHub API.
-    char *json_data = NULL;
-    if (fetch_releases_json(component, &json_data) != 0)
-    {
-        return -2;
-    }
-
-    // Parse the JSON response.
-    json_object *root = json_tokener_parse(json_data);
-    if (!root)
-    {
-        LOG_ERROR("Failed to parse GitHub API response");
-        free(json_data);
-        return -3;
-    }
-
-    // Validate the response is an array.
-    if (!json_object_is_type(root, json_type_array))
+    // Get the HTTP status, if a request was made.
+    long http_code = 0;
+    if (handle)
     {
-        LOG_ERROR("Unexpected GitHub API response format");
-        json_object_put(root);
-        free(json_data);
-        return -4;
+        http_code = get_transfer_status(handle, result);
     }
 
-    // Iterate through releases to find the best matching version.
-    const char *best_version = NULL;
-    size_t release_count = json_object_array_length(root);
-    for (size_t i = 0; i < release_count; i++)
+    // Pick the candidates to resolve from.
+    const ReleaseCandidate *candidates = request->candidates;
+    int candidate_count = request->candidate_count;
+    if (handle && result == CURLE_OK && http_code == 200)
     {
-        json_object *release = json_object_array_get_idx(root, i);
-        json_object *tag_name_obj;
-
-        // Extract the tag_name field.
-        if (!json_object_object_get_ex(release, "tag_name", &tag_name_obj))
+        // Validate the page that was just parsed.
+        int parse_result = finish_releases_parser(&request->parser);
+        if (parse_result != 0)
         {
-            continue;
+            return parse_result;
         }
+        request->page_count++;
 
-        const char *tag_name = json_object_get_string(tag_name_obj);
-        if (!tag_name)
+        // Follow the listing until the target major version is settled.
+        if (has_next_releases_page(request))
         {
-            continue;
+            return 1;
         }
 
-        // Check if this release matches the target major version.
-        int release_major = common.get_version_major(tag_name);
-        if (release_major != target_major)
+        store_cached_releases(request);
+    }
+    else if (handle && result == CURLE_OK && http_code == 304 &&
+        request->has_cached_candidates)
+    {
+        // Reuse the cached candidates of an unchanged listing.
+        candidates = request->cached_candidates;
+        candidate_count = request->cached_candidate_count;
+    }
+    else if (has_release_candidate(
+        request->candidates, request->candidate_count, request->target_major))
+    {
+        // Settle for the pages already read when a later one fails.
+        LOG_WARNING("GitHub API unavailable, using partial releases for %s", component);
+    }
+    else if (request->has_cached_candidates)
+    {
+        // Fall back to the cached candidates while the API is unavailable.
+        LOG_WARNING("GitHub API unavailable, using cached releases for %s", component);
+        candidates = request->cached_candidates;
+        candidate_count = request->cached_candidate_count;
+    }
+    else
+    {
+        // Wait out a rate limit the refusal itself reported, since falling
+        // back to the exact version would build a different release.
+        if (handle && result == CURLE_OK)
         {
-            continue;
+            int rate_limit_result = defer_rate_limited_request(request, http_code, time(NULL));
+            if (rate_limit_result != 0)
+            {
+                return rate_limit_result;
+            }
         }
 
-        // Check if this is a prerelease or draft (skip them).
-        json_object *prerelease_obj;
-        json_object *draft_obj;
-        if (json_object_object_get_ex(release, "prerelease", &prerelease_obj))
+        if (!handle)
         {
-            if (json_object_get_boolean(prerelease_obj))
-            {
-                continue;
-            }
+            LOG_ERROR("GitHub API rate limit exhausted");
+            return -6;
         }
-        if (json_object_object_get_ex(release, "draft", &draft_obj))
+        if (result != CURLE_OK)
         {
-            if (json_object_get_boolean(draft_obj))
-            {
-                continue;
-            }
+            LOG_ERROR("GitHub API request failed: %s", curl_easy_strerror(result));
         }
-
-        // Update the best version if this one is newer.
-        if (!best_version || common.compare_versions(tag_name, best_version) > 0)
+        else
         {
-            best_version = tag_name;
+            LOG_ERROR("GitHub API returned HTTP %ld", http_code);
         }
+        return -2;
     }
 
-    // Check if a matching version was found.
-    if (!best_version)
+    // Select the newest matching release.
+    int select_result = select_release_version(
+        candidates, candidate_count, component, request->target_major,
+        out_resolved, buffer_length
+    );
+    if (select_result != 0)
     {
-        LOG_WARNING(
-            "No release found for %s with major version %d",
-            component, target_major
-        );
-        json_object_put(root);
-        free(json_data);
-        return -5;
+        return select_result;
     }
 
-    // Copy the resolved version to the output buffer.
-    strncpy(out_resolved, best_version, buffer_length - 1);
-    out_resolved[buffer_length - 1] = '\0';
-
     // Log the resolution result.
     LOG_INFO("Resolved %s version: %s -> %s", component, version, out_resolved);
 
-    // Clean up JSON resources.
-    json_object_put(root);
-    free(json_data);
-
     return 0;
 }
+
+void cleanup_releases_request(ReleasesRequest *request)
+{
+    // Release the request headers.
+    curl_slist_free_all(request->headers);
+    request->headers = NULL;
+}
@@ -1,28 +1,150 @@
 #pragma once
 #include "../all.h"
 
+/** The maximum length of a stored HTTP entity tag. */
+#define RESOLVE_ETAG_MAX_LENGTH 256
+
+/** The maximum number of major versions remembered per releases listing. */
+#define RESOLVE_MAX_MAJOR_VERSIONS 32
+
+/** The maximum length of an object key the releases parser distinguishes. */
+#define RESOLVE_KEY_MAX_LENGTH 32
+
+/** A type representing the newest stable release tag of a major version. */
+typedef struct
+{
+    int major;
+    char tag[COMMON_MAX_VERSION_LENGTH];
+} ReleaseCandidate;
+
+/**
+ * A type representing the incremental state of the releases listing parser.
+ *
+ * Tracks just enough of the JSON structure to read the fields of each
+ * top-level release object, so memory stays constant however long the
+ * listing is.
+ */
+typedef struct
+{
+    int has_started;
+    int depth;
+    int is_in_string;
+    int is_escaped;
+    int expects_key;
+    char key[RESOLVE_KEY_MAX_LENGTH];
+    char token[COMMON_MAX_VERSION_LENGTH];
+    size_t token_length;
+    int is_token_truncated;
+    char tag[COMMON_MAX_VERSION_LENGTH];
+    int is_prerelease;
+    int is_draft;
+    int last_major;
+    int status;
+} ReleasesParser;
+
 /**
- * Resolves the latest release version within a major version for a component.
+ * A type representing an in-flight GitHub releases API request.
  *
- * Queries the GitHub API for the specified component repository and finds the
- * latest release that shares the same major version as the provided version.
+ * Holds the streaming parser and request headers so the transfer can be
+ * driven by any curl handle owner, including a multi handle, along with the
+ * cached listing used to make the request conditional.
+ */
+typedef struct
+{
+    struct curl_slist *headers;
+    ReleasesParser parser;
+    int target_major;
+    int page_count;
+    char next_url[FETCH_URL_MAX_LENGTH];
+    char cache_path[COMMON_MAX_PATH_LENGTH];
+    char etag[RESOLVE_ETAG_MAX_LENGTH];
+    char response_etag[RESOLVE_ETAG_MAX_LENGTH];
+    ReleaseCandidate candidates[RESOLVE_MAX_MAJOR_VERSIONS];
+    int candidate_count;
+    ReleaseCandidate cached_candidates[RESOLVE_MAX_MAJOR_VERSIONS];
+    int cached_candidate_count;
+    int has_cached_candidates;
+    long rate_limit_remaining;
+    time_t rate_limit_reset;
+    time_t retry_at;
+} ReleasesRequest;
+
+/**
+ * Prepares a GitHub releases API request for a component.
  *
- * @param component The component name (without `limeos` suffix, 
+ * @param request The request state to initialize.
+ * @param component The component name (without `limeos` suffix,
  * e.g., "window-manager").
  * @param version The user-provided version (e.g., "1.0.0").
+ * @param out_handle The configured curl handle, ready to be performed, or
+ * `NULL` when no request should be made.
+ *
+ * @return - `0` - Indicates the request is ready.
+ * @return - `1` - Indicates the API rate limit is exhausted, so the caller
+ * should complete the request with a `NULL` handle to use cached releases.
+ * @return - `2` - Indicates the API rate limit resets soon, so the caller
+ * should prepare the request again after `request->retry_at`.
+ * @return - `-1` - Indicates response buffer allocation failure.
+ * @return - `-2` - Indicates curl initialization failure.
+ * @return - `-3` - Indicates invalid version format.
+ *
+ * @note The caller owns the returned handle and must release the request
+ * with cleanup_releases_request() after the handle is cleaned up.
+ */
+int prepare_releases_request(
+    ReleasesRequest *request,
+    const char *component,
+    const char *version,
+    CURL **out_handle
+);
+
+/**
+ * Prepares the request for the next page of a releases listing.
+ *
+ * @param request The request whose previous page asked for another.
+ * @param out_handle The configured curl handle, ready to be performed.
+ *
+ * @return - `0` - Indicates the request is ready.
+ * @return - `-2` - Indicates curl initialization failure.
+ *
+ * @note The previous page's handle must be cleaned up first.
+ */
+int prepare_next_releases_page(ReleasesRequest *request, CURL **out_handle);
+
+/**
+ * Resolves the latest matching version from a finished releases request.
+ *
+ * @param request The request whose transfer has finished.
+ * @param handle The curl handle that performed the transfer, or `NULL` if
+ * prepare_releases_request() made no request.
+ * @param result The curl result code of the transfer.
+ * @param component The component name, used for logging.
+ * @param version The user-provided version (e.g., "1.0.0").
  * @param out_resolved The buffer to store the resolved version string.
  * @param buffer_length The size of the output buffer.
  *
  * @return - `0` - Indicates successful resolution.
- * @return - `-1` - Indicates invalid version format.
+ * @return - `1` - Indicates the listing continues, so the caller should
+ * perform prepare_next_releases_page() and complete it in turn.
+ * @return - `2` - Indicates the API refused the request for its rate limit,
+ * which resets soon, so the caller should prepare the request again after
+ * `request->retry_at`.
  * @return - `-2` - Indicates a network or API failure.
  * @return - `-3` - Indicates JSON parsing failure.
  * @return - `-4` - Indicates unexpected API response format.
  * @return - `-5` - Indicates no matching version was found.
+ * @return - `-6` - Indicates the API rate limit is exhausted and does not
+ * reset soon enough to wait for, with no cached releases to fall back on.
  */
-int resolve_version(
+int complete_releases_request(
+    ReleasesRequest *request,
+    CURL *handle,
+    CURLcode result,
     const char *component,
     const char *version,
     char *out_resolved,
     size_t buffer_length
 );
+
+/** Releases the headers held by a releases request. */
+void cleanup_releases_request(ReleasesRequest *request);
@@ -0,0 +1,74 @@
+#pragma once
+#include "../all.h"
+
+/**
+ * Selects where component releases are fetched from.
+ *
+ * By default releases come from GitHub. A mirror holds the same releases
+ * under a fixed layout and may be a local directory, a `file://` URL, or an
+ * `http(s)://` URL (e.g., a server on localhost).
+ *
+ * @param location The mirror location, or `NULL` to use GitHub.
+ *
+ * @return - `0` - Indicates the source was selected.
+ * @return - `-1` - Indicates the mirror directory does not exist.
+ * @return - `-2` - Indicates the mirror location is too long.
+ */
+int set_release_source(const char *location);
+
+/**
+ * Checks whether releases are fetched from a mirror rather than GitHub.
+ *
+ * @return - `1` - Indicates a mirror is in use.
+ * @return - `0` - Indicates GitHub is in use.
+ */
+int is_release_mirror(void);
+
+/**
+ * Builds the URL of a repository's releases index.
+ *
+ * @param repo_name The component repository name.
+ * @param out_url The buffer to store the URL.
+ * @param url_length The size of the output buffer.
+ */
+void build_releases_url(const char *repo_name, char *out_url, size_t url_length);
+
+/**
+ * Builds the URL of a file attached to a release.
+ *
+ * @param repo_name The component repository name.
+ * @param version The release version tag.
+ * @param asset_name The name of the release asset.
+ * @param out_url The buffer to store the URL.
+ * @param url_length The size of the output buffer.
+ */
+void build_release_asset_url(
+    const char *repo_name,
+    const char *version,
+    const char *asset_name,
+    char *out_url,
+    size_t url_length
+);
+
+/**
+ * Checks whether a transfer speaks HTTP rather than reading a local file.
+ *
+ * @param handle The curl handle of the transfer.
+ *
+ * @return - `1` - Indicates an HTTP or HTTPS transfer.
+ * @return - `0` - Indicates another protocol, such as `file://`.
+ */
+int is_http_transfer(CURL *handle);
+
+/**
+ * Gets the HTTP status of a finished transfer, whatever its protocol.
+ *
+ * Local mirror reads have no response code, so their outcome is mapped onto
+ * the equivalent HTTP status, letting callers treat every source alike.
+ *
+ * @param handle The curl handle of the transfer.
+ * @param result The curl result code of the transfer.
+ *
+ * @return The HTTP response code, or `0` if none applies.
+ */
+long get_transfer_status(CURL *handle, CURLcode result);
@@ -0,0 +1,319 @@
+/**
+ * This code is responsible for packaging the target rootfs into a compact
+ * ext4 image that the installer can block-copy to disk.
+ */
+
+#include "all.h"
+
+/** The offset of the ext4 superblock within the image. */
+#define EXT4_SUPERBLOCK_OFFSET 1024
+
+/** The size of the ext4 superblock. */
+#define EXT4_SUPERBLOCK_SIZE 1024
+
+/** The incompatible feature flag for 64-bit block counts. */
+#define EXT4_FEATURE_INCOMPAT_64BIT 0x80
+
+/** The length of a UUID in its text form, with its terminator. */
+#define IMAGE_UUID_LENGTH 37
+
+/** The first inode mkfs.ext4 -d fills from the rootfs, after lost+found. */
+#define IMAGE_FIRST_FILE_INODE 12
+
+/** The commands the image is built with. */
+static const char *const IMAGE_COMMANDS[] = {
+    "mkfs.ext4", "e2fsck", "resize2fs", "debugfs", NULL
+};
+
+static void measure_rootfs(
+    const char *path,
+    unsigned long long *out_bytes,
+    unsigned long long *out_entries
+)
+{
+    struct stat path_stat;
+    if (lstat(path, &path_stat) != 0)
+    {
+        return;
+    }
+    *out_bytes += (unsigned long long)path_stat.st_blocks * 512;
+    *out_entries += 1;
+    if (!S_ISDIR(path_stat.st_mode))
+    {
+        return;
+    }
+
+    // Add up everything beneath the directory.
+    DIR *directory = opendir(path);
+    if (!directory)
+    {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(directory)) != NULL)
+    {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+        {
+            continue;
+        }
+        char entry_path[COMMON_MAX_PATH_LENGTH];
+        snprintf(entry_path, sizeof(entry_path), "%s/%s", path, entry->d_name);
+        measure_rootfs(entry_path, out_bytes, out_entries);
+    }
+    closedir(directory);
+}
+
+static unsigned long long read_le32(const unsigned char *bytes)
+{
+    return (unsigned long long)bytes[0] |
+           (unsigned long long)bytes[1] << 8 |
+           (unsigned long long)bytes[2] << 16 |
+           (unsigned long long)bytes[3] << 24;
+}
+
+static int read_image_geometry(
+    const char *image_path,
+    unsigned long long *out_block_size,
+    unsigned long long *out_block_count
+)
+{
+    int fd = open(image_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    unsigned char superblock[EXT4_SUPERBLOCK_SIZE];
+    ssize_t bytes = pread(fd, superblock, sizeof(superblock), EXT4_SUPERBLOCK_OFFSET);
+    close(fd);
+    if (bytes != (ssize_t)sizeof(superblock) || superblock[0x38] != 0x53 || superblock[0x39] != 0xef)
+    {
+        return -1;
+    }
+
+    // Read the block size and count, including the high half of the count
+    // on 64-bit filesystems.
+    *out_block_size = 1024ULL << read_le32(superblock + 0x18);
+    *out_block_count = read_le32(superblock + 0x04);
+    if (read_le32(superblock + 0x60) & EXT4_FEATURE_INCOMPAT_64BIT)
+    {
+        *out_block_count |= read_le32(superblock + 0x150) << 32;
+    }
+
+    return 0;
+}
+
+static int build_image_uuid(time_t source_date_epoch, char *out_uuid)
+{
+    // Derive the UUID from the epoch instead of drawing it at random, so
+    // rebuilding the image gives the same bytes.
+    char seed[64];
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_length = 0;
+    int seed_length = snprintf(seed, sizeof(seed), "limeos-rootfs-%lld", (long long)source_date_epoch);
+    if (EVP_Digest(seed, (size_t)seed_length, digest, &digest_length, EVP_sha256(), NULL) != 1)
+    {
+        return -1;
+    }
+
+    // Mark it as a version 4, variant 1 UUID.
+    digest[6] = (digest[6] & 0x0f) | 0x40;
+    digest[8] = (digest[8] & 0x3f) | 0x80;
+    snprintf(
+        out_uuid, IMAGE_UUID_LENGTH,
+        "%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+        digest[0], digest[1], digest[2], digest[3], digest[4], digest[5], digest[6], digest[7],
+        digest[8], digest[9], digest[10], digest[11], digest[12], digest[13], digest[14], digest[15]
+    );
+
+    return 0;
+}
+
+static int check_image_times(const char *quoted_image, time_t source_date_epoch)
+{
+    // Read the times of the first inode filled from the rootfs.
+    char command[COMMON_MAX_COMMAND_LENGTH];
+    snprintf(
+        command, sizeof(command), "debugfs -R 'stat <%d>' %s 2>/dev/null",
+        IMAGE_FIRST_FILE_INODE, quoted_image
+    );
+    FILE *output = popen(command, "r");
+    if (!output)
+    {
+        return -1;
+    }
+
+    // Require every time to be clamped to the epoch, which only versions
+    // of mkfs.ext4 that honor SOURCE_DATE_EPOCH do.
+    char line[256];
+    int time_count = 0;
+    int result = 0;
+    while (fgets(line, sizeof(line), output))
+    {
+        static const char *const FIELDS[] = { "ctime: 0x", "atime: 0x", "mtime: 0x" };
+        for (size_t i = 0; i < sizeof(FIELDS) / sizeof(FIELDS[0]); i++)
+        {
+            const char *field = strstr(line, FIELDS[i]);
+            unsigned long long seconds = 0;
+            if (field && sscanf(field + strlen(FIELDS[i]), "%llx", &seconds) == 1)
+            {
+                time_count++;
+                if ((long long)seconds > (long long)source_date_epoch)
+                {
+                    result = -1;
+                }
+            }
+        }
+    }
+    if (pclose(output) != 0 || time_count == 0)
+    {
+        return -1;
+    }
+
+    return result;
+}
+
+int image_target_rootfs(
+    const char *rootfs_path,
+    const char *image_path,
+    const char *manifest_path,
+    time_t source_date_epoch
+)
+{
+    LOG_INFO("Packaging target rootfs to %s (ext4)", image_path);
+
+    // Verify the ext4 tools are installed.
+    for (int i = 0; IMAGE_COMMANDS[i]; i++)
+    {
+        if (!common.is_command_available(IMAGE_COMMANDS[i]))
+        {
+            LOG_ERROR("Missing required command for the ext4 payload: %s", IMAGE_COMMANDS[i]);
+            return -1;
+        }
+    }
+
+    // Quote paths for shell safety.
+    char quoted_rootfs[COMMON_MAX_QUOTED_LENGTH];
+    char quoted_image[COMMON_MAX_QUOTED_LENGTH];
+    if (common.shell_escape_path(rootfs_path, quoted_rootfs, sizeof(quoted_rootfs)) != 0 ||
+        common.shell_escape_path(image_path, quoted_image, sizeof(quoted_image)) != 0)
+    {
+        LOG_ERROR("Failed to quote image paths");
+        return -2;
+    }
+
+    // Size the image for the rootfs with room to spare, since mkfs.ext4
+    // cannot grow it while populating. The file is sparse, so the spare
+    // room costs nothing on disk.
+    unsigned long long rootfs_bytes = 0;
+    unsigned long long entry_count = 0;
+    measure_rootfs(rootfs_path, &rootfs_bytes, &entry_count);
+    unsigned long long image_bytes = rootfs_bytes + rootfs_bytes / 4 + CONFIG_TARGET_IMAGE_HEADROOM;
+    image_bytes -= image_bytes % CONFIG_TARGET_IMAGE_BLOCK_SIZE;
+    unsigned long long inode_count = entry_count + entry_count / 4 + 1024;
+
+    // Create the sparse image file, dropping any image of an earlier attempt.
+    int fd = open(image_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        LOG_ERROR("Failed to create image file: %s", image_path);
+        return -3;
+    }
+    if (ftruncate(fd, (off_t)image_bytes) != 0)
+    {
+        close(fd);
+        LOG_ERROR("Failed to size image file: %s", image_path);
+        return -3;
+    }
+    close(fd);
+
+    // Pin the filesystem UUID and the times e2fsprogs records to the epoch,
+    // including the inode times mkfs.ext4 copies from the rootfs.
+    char uuid[IMAGE_UUID_LENGTH];
+    char environment[192];
+    if (build_image_uuid(source_date_epoch, uuid) != 0)
+    {
+        LOG_ERROR("Failed to derive image UUID");
+        return -4;
+    }
+    snprintf(
+        environment, sizeof(environment),
+        "E2FSPROGS_FAKE_TIME=%lld E2FSCK_TIME=%lld SOURCE_DATE_EPOCH=%lld",
+        (long long)source_date_epoch, (long long)source_date_epoch,
+        (long long)source_date_epoch
+    );
+
+    // Create the filesystem populated from the rootfs, keeping ownership,
+    // permissions, extended attributes and hardlinks.
+    char command[COMMON_MAX_COMMAND_LENGTH];
+    snprintf(
+        command, sizeof(command),
+        "%s mkfs.ext4 -q -F -b %d -N %llu -m 0 -U %s -E hash_seed=%s -d %s %s",
+        environment, CONFIG_TARGET_IMAGE_BLOCK_SIZE, inode_count, uuid, uuid,
+        quoted_rootfs, quoted_image
+    );
+    if (common.run_command_indented(command) != 0)
+    {
+        LOG_ERROR("Failed to create ext4 filesystem from %s", rootfs_path);
+        return -4;
+    }
+
+    // Refuse an image that kept the rootfs inode times, since their ctimes
+    // record when the rootfs was written rather than anything reproducible.
+    if (check_image_times(quoted_image, source_date_epoch) != 0)
+    {
+        LOG_ERROR(
+            "mkfs.ext4 did not clamp inode times to SOURCE_DATE_EPOCH, "
+            "e2fsprogs 1.47.1 or later is required for the ext4 payload"
+        );
+        return -4;
+    }
+
+    // Check the filesystem, which resize2fs requires before shrinking.
+    snprintf(command, sizeof(command), "%s e2fsck -f -p %s", environment, quoted_image);
+    if (common.run_command_indented(command) != 0)
+    {
+        LOG_ERROR("Failed to check ext4 filesystem: %s", image_path);
+        return -5;
+    }
+
+    // Shrink the filesystem to its minimum size and cut the file to match.
+    unsigned long long block_size = 0;
+    unsigned long long block_count = 0;
+    snprintf(command, sizeof(command), "%s resize2fs -M %s", environment, quoted_image);
+    if (common.run_command_indented(command) != 0 ||
+        read_image_geometry(image_path, &block_size, &block_count) != 0 ||
+        truncate(image_path, (off_t)(block_size * block_count)) != 0)
+    {
+        LOG_ERROR("Failed to shrink ext4 filesystem: %s", image_path);
+        return -6;
+    }
+
+    // Record the geometry for the installer, which needs a partition at
+    // least as large as the image, and have it replace the shared UUID.
+    char manifest[256];
+    snprintf(
+        manifest, sizeof(manifest),
+        "format=ext4\nblock_size=%llu\nblock_count=%llu\nminimum_bytes=%llu\n"
+        "regenerate_uuid=1\n",
+        block_size, block_count, block_size * block_count
+    );
+    if (common.write_file(manifest_path, manifest) != 0)
+    {
+        LOG_ERROR("Failed to write image manifest: %s", manifest_path);
+        return -7;
+    }
+
+    // Report the image size, and how much of it the sparse file occupies.
+    struct stat image_stat;
+    unsigned long long allocated_bytes = 0;
+    if (stat(image_path, &image_stat) == 0)
+    {
+        allocated_bytes = (unsigned long long)image_stat.st_blocks * 512;
+    }
+    LOG_INFO(
+        "Target rootfs image is %.1f MB (%.1f MB allocated) for %.1f MB of files",
+        block_size * block_count / 1e6, allocated_bytes / 1e6, rootfs_bytes / 1e6
+    );
+
+    return 0;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+/**
+ * Packages the target rootfs into a compact ext4 image.
+ *
+ * Creates a sparse image file sized generously for the rootfs, populates a
+ * fresh ext4 filesystem from the tree with mkfs.ext4, checks it, and shrinks
+ * it to its minimum size, so the image carries next to no free space. The
+ * installer block-copies the image to the target partition and grows the
+ * filesystem to fill it, instead of extracting a tarball file by file.
+ *
+ * The image is reproducible for the same rootfs: its UUID and directory hash
+ * seed are derived from the source date epoch, which also stands in for the
+ * current time in every timestamp e2fsprogs records, and clamps the inode
+ * times copied from the rootfs. Packaging fails on e2fsprogs older than
+ * 1.47.1, whose mkfs.ext4 copies them as is.
+ *
+ * The geometry of the image is written to the manifest as "key=value"
+ * lines: the format ("ext4"), the block size, the block count, the
+ * smallest partition in bytes the image can be copied to, and
+ * "regenerate_uuid=1", since every copy of the image shares its UUID until
+ * the installer replaces it.
+ *
+ * @param rootfs_path The path to the target rootfs directory.
+ * @param image_path The path where the image will be created.
+ * @param manifest_path The path where the manifest will be written.
+ * @param source_date_epoch The time recorded by the filesystem tools.
+ *
+ * @return - `0` - Indicates successful packaging.
+ * @return - `-1` - Indicates missing ext4 tools.
+ * @return - `-2` - Indicates path quoting failure.
+ * @return - `-3` - Indicates image file creation failure.
+ * @return - `-4` - Indicates filesystem creation failure, including inode
+ * times mkfs.ext4 did not clamp.
+ * @return - `-5` - Indicates filesystem check failure.
+ * @return - `-6` - Indicates filesystem shrink failure.
+ * @return - `-7` - Indicates manifest write failure.
+ */
+int image_target_rootfs(
+    const char *rootfs_path,
+    const char *image_path,
+    const char *manifest_path,
+    time_t source_date_epoch
+);
@@ -4,39 +4,153 @@
 
 #include "all.h"
 
-int package_target_rootfs(const char *rootfs_path, const char *output_path)
+/** The names of the payload formats, indexed by PayloadFormat. */
+static const char *const PAYLOAD_FORMAT_NAMES[] = {
+    "tar",
+    "ext4"
+};
+
+/** The names of the tarball compressions, indexed by TarballCompression. */
+static const char *const TARBALL_COMPRESSION_NAMES[] = {
+    "gzip",
+    "zstd",
+    "none"
+};
+
+/** The file extension of each tarball compression, after ".tar". */
+static const char *const TARBALL_COMPRESSION_EXTENSIONS[] = {
+    ".gz",
+    ".zst",
+    ""
+};
+
+int parse_payload_format(const char *name, PayloadFormat *out_format)
+{
+    for (int i = 0; i <= PAYLOAD_FORMAT_EXT4; i++)
+    {
+        if (strcmp(name, PAYLOAD_FORMAT_NAMES[i]) == 0)
+        {
+            *out_format = (PayloadFormat)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *get_payload_format_name(PayloadFormat format)
 {
-    LOG_INFO("Packaging target rootfs to %s", output_path);
+    return PAYLOAD_FORMAT_NAMES[format];
+}
 
-    // Quote the rootfs path for shell safety.
-    char quoted_rootfs[COMMON_MAX_QUOTED_LENGTH];
-    if (common.shell_escape_path(rootfs_path, quoted_rootfs, sizeof(quoted_rootfs)) != 0)
+int parse_tarball_compression(const char *name, TarballCompression *out_compression)
+{
+    for (int i = 0; i <= TARBALL_COMPRESSION_NONE; i++)
     {
-        LOG_ERROR("Failed to quote rootfs path");
-        return -1;
+        if (strcmp(name, TARBALL_COMPRESSION_NAMES[i]) == 0)
+        {
+            *out_compression = (TarballCompression)i;
+            return 0;
+        }
     }
+    return -1;
+}
+
+const char *get_tarball_compression_name(TarballCompression compression)
+{
+    return TARBALL_COMPRESSION_NAMES[compression];
+}
 
-    // Quote the output path for shell safety.
-    char quoted_output[COMMON_MAX_QUOTED_LENGTH];
-    if (common.shell_escape_path(output_path, quoted_output, sizeof(quoted_output)) != 0)
+const char *get_tarball_compression_extension(TarballCompression compression)
+{
+    return TARBALL_COMPRESSION_EXTENSIONS[compression];
+}
+
+static int build_compress_program(
+    TarballCompression compression,
+    char *out_program,
+    size_t program_length
+)
+{
+    long thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (thread_count < 1)
     {
-        LOG_ERROR("Failed to quote output path");
-        return -2;
+        thread_count = 1;
     }
 
-    // Create a compressed tarball of the rootfs.
-    // Use --numeric-owner to preserve UIDs/GIDs without mapping to names.
-    // Use -C to change to the rootfs directory so paths are relative.
-    char command[COMMON_MAX_COMMAND_LENGTH];
+    // Prefer the compressors that split the output into independent blocks,
+    // falling back to the stock ones, which write the same format. gzip
+    // headers leave out the name and time, so the output is reproducible.
+    if (compression == TARBALL_COMPRESSION_GZIP)
+    {
+        if (common.is_command_available("pigz"))
+        {
+            snprintf(
+                out_program, program_length, "pigz -%d -n -m --independent -p %ld",
+                CONFIG_TARGET_GZIP_LEVEL, thread_count
+            );
+            return 0;
+        }
+        if (!common.is_command_available("gzip"))
+        {
+            LOG_ERROR("Missing required command for gzip compression: pigz or gzip");
+            return -1;
+        }
+        LOG_WARNING("pigz is not installed, compressing with a single thread");
+        snprintf(out_program, program_length, "gzip -%d -n", CONFIG_TARGET_GZIP_LEVEL);
+        return 0;
+    }
+    if (common.is_command_available("pzstd"))
+    {
+        snprintf(
+            out_program, program_length, "pzstd -%d -p %ld -c",
+            CONFIG_TARGET_ZSTD_LEVEL, thread_count
+        );
+        return 0;
+    }
+    if (!common.is_command_available("zstd"))
+    {
+        LOG_ERROR("Missing required command for zstd compression: pzstd or zstd");
+        return -1;
+    }
+    LOG_WARNING("pzstd is not installed, writing a single zstd frame");
     snprintf(
-        command, sizeof(command),
-        "tar --numeric-owner -czf %s -C %s .",
-        quoted_output, quoted_rootfs
+        out_program, program_length, "zstd -%d -T%ld -c",
+        CONFIG_TARGET_ZSTD_LEVEL, thread_count
+    );
+
+    return 0;
+}
+
+int package_target_rootfs(
+    const char *rootfs_path,
+    const char *output_path,
+    TarballCompression compression,
+    time_t source_date_epoch
+)
+{
+    LOG_INFO(
+        "Packaging target rootfs to %s (%s)",
+        output_path, get_tarball_compression_name(compression)
     );
-    if (common.run_command_indented(command) != 0)
+
+    // Pick the compressor the archive is streamed through, verifying it is
+    // installed before any of the rootfs is read.
+    char program[COMMON_MAX_PATH_LENGTH];
+    const char *compress_program = NULL;
+    if (compression != TARBALL_COMPRESSION_NONE)
+    {
+        if (build_compress_program(compression, program, sizeof(program)) != 0)
+        {
+            return -2;
+        }
+        compress_program = program;
+    }
+
+    // Write the archive of the rootfs straight to its destination.
+    if (write_tree_archive(rootfs_path, compress_program, output_path, source_date_epoch) != 0)
     {
         LOG_ERROR("Failed to create rootfs tarball");
-        return -3;
+        return -1;
     }
 
     LOG_INFO("Target rootfs packaged successfully");
@@ -1,17 +1,101 @@
 #pragma once
 
 /**
- * Packages the target rootfs into a compressed tarball.
+ * A type representing the form the target rootfs is shipped in.
+ */
+typedef enum PayloadFormat
+{
+    PAYLOAD_FORMAT_TAR,
+    PAYLOAD_FORMAT_EXT4
+} PayloadFormat;
+
+/**
+ * A type representing how the target rootfs tarball is compressed.
+ */
+typedef enum TarballCompression
+{
+    TARBALL_COMPRESSION_GZIP,
+    TARBALL_COMPRESSION_ZSTD,
+    TARBALL_COMPRESSION_NONE
+} TarballCompression;
+
+/**
+ * Parses the name of a payload format ("tar" or "ext4").
+ *
+ * @param name The format name.
+ * @param out_format The parsed format.
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates an unknown format name.
+ */
+int parse_payload_format(const char *name, PayloadFormat *out_format);
+
+/**
+ * Gets the name of a payload format.
+ *
+ * @param format The format.
+ *
+ * @return The format name ("tar" or "ext4").
+ */
+const char *get_payload_format_name(PayloadFormat format);
+
+/**
+ * Parses the name of a tarball compression ("gzip", "zstd" or "none").
+ *
+ * @param name The compression name.
+ * @param out_compression The parsed compression.
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates an unknown compression name.
+ */
+int parse_tarball_compression(const char *name, TarballCompression *out_compression);
+
+/**
+ * Gets the name of a tarball compression, as recorded for the installer.
+ *
+ * @param compression The compression.
+ *
+ * @return The compression name ("gzip", "zstd" or "none").
+ */
+const char *get_tarball_compression_name(TarballCompression compression);
+
+/**
+ * Gets the file extension of a tarball compression, appended to ".tar".
+ *
+ * @param compression The compression.
+ *
+ * @return The extension (".gz", ".zst", or "" when uncompressed).
+ */
+const char *get_tarball_compression_extension(TarballCompression compression);
+
+/**
+ * Packages the target rootfs into a tarball.
+ *
+ * Creates a tarball of the target rootfs for the installer to extract to
+ * disk. The archive is written in process by write_tree_archive() and
+ * streamed through the compressor straight to the output path, with no
+ * intermediate file. Compression runs on every core: gzip through pigz with
+ * independent blocks, and zstd through pzstd, which writes independent
+ * frames the installer can decompress in parallel. If either is missing,
+ * the single-threaded gzip or the multi-threaded zstd is used instead,
+ * producing the same format.
  *
- * Creates a gzipped tarball of the target rootfs that will be embedded
- * in the live environment for the installer to extract to disk.
+ * The tarball is reproducible: entries are sorted, owners are numeric, and
+ * mtimes are clamped to the source date epoch, so the same rootfs always
+ * packages to the same bytes.
  *
  * @param rootfs_path The path to the target rootfs directory.
  * @param output_path The path where the tarball will be created.
+ * @param compression The compression of the tarball.
+ * @param source_date_epoch The latest mtime stored in the tarball.
  *
  * @return - `0` - Indicates successful packaging.
- * @return - `-1` - Indicates rootfs path quoting failure.
- * @return - `-2` - Indicates output path quoting failure.
- * @return - `-3` - Indicates tarball creation failure.
+ * @return - `-1` - Indicates tarball creation failure.
+ * @return - `-2` - Indicates no compressor for the compression is installed.
  */
-int package_target_rootfs(const char *rootfs_path, const char *output_path);
+int package_target_rootfs(
+    const char *rootfs_path,
+    const char *output_path,
+    TarballCompression compression,
+    time_t source_date_epoch
+);
@@ -5,8 +5,9 @@
 #include "all.h"
 
 int run_target_phase(
-    const char *base_rootfs_dir, const char *rootfs_dir,
-    const char *tarball_path, const char *version
+    const char *base_rootfs_dir,
+    const char *rootfs_dir,
+    const char *version
 )
 {
     if (create_target_rootfs(base_rootfs_dir, rootfs_dir) != 0)
@@ -27,16 +28,25 @@ int run_target_phase(
         return -3;
     }
 
-    if (package_target_rootfs(rootfs_dir, tarball_path) != 0)
+    // Collapse identical files into hardlinks, so the payload stores each
+    // one once. Under an overlay, only files already in its upper layer are
+    // linked, and none when the phase changed nothing under the path.
+    char dedup_path[COMMON_MAX_PATH_LENGTH];
+    char layer_path[COMMON_MAX_PATH_LENGTH];
+    char upper_path[COMMON_MAX_PATH_LENGTH];
+    unsigned long long saved_bytes = 0;
+    snprintf(dedup_path, sizeof(dedup_path), "%s%s", rootfs_dir, CONFIG_TARGET_DEDUP_PATH);
+    snprintf(layer_path, sizeof(layer_path), "%s.layer/upper", rootfs_dir);
+    snprintf(upper_path, sizeof(upper_path), "%s%s", layer_path, CONFIG_TARGET_DEDUP_PATH);
+    int is_overlay = common.file_exists(layer_path);
+    if ((!is_overlay || common.file_exists(upper_path)) &&
+        deduplicate_tree(dedup_path, is_overlay ? upper_path : NULL, &saved_bytes) != 0)
     {
-        LOG_ERROR("Failed to package target rootfs");
+        LOG_ERROR("Failed to deduplicate target rootfs files");
         return -4;
     }
 
-    // Remove the target rootfs directory.
-    common.rm_rf(rootfs_dir);
-
-    LOG_INFO("Phase 3 complete: Target rootfs packaged");
+    LOG_INFO("Phase 3 complete: Target rootfs configured");
     
     return 0;
 }
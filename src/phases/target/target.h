@@ -1,23 +1,32 @@
 #pragma once
 
+/**
+ * The revision of the target phase.
+ *
+ * The stored target rootfs is keyed by it, so bump it whenever the target
+ * phase, or the branding it applies, changes what it produces.
+ */
+#define TARGET_PHASE_REVISION 4
+
 /**
  * Runs the target phase.
  *
- * Copies the base rootfs, installs target-specific packages, applies OS
- * branding, and packages the result as a tarball for embedding in the live.
+ * Derives from the base rootfs, installs target-specific packages and applies
+ * OS branding, then collapses identical package files into hardlinks. The
+ * live phase packages the result straight into the live rootfs.
  *
- * @param base_rootfs_dir The path to the base rootfs to copy from.
+ * @param base_rootfs_dir The path to the base rootfs to derive from.
  * @param rootfs_dir The directory for the target rootfs.
- * @param tarball_path The output path for the packaged tarball.
  * @param version The version string for OS branding.
  *
  * @return - `0` - Indicates success.
  * @return - `-1` - Indicates target rootfs creation failure.
  * @return - `-2` - Indicates target rootfs configuration failure.
  * @return - `-3` - Indicates APT directory cleanup failure.
- * @return - `-4` - Indicates tarball packaging failure.
+ * @return - `-4` - Indicates file deduplication failure.
  */
 int run_target_phase(
-    const char *base_rootfs_dir, const char *rootfs_dir,
-    const char *tarball_path, const char *version
+    const char *base_rootfs_dir,
+    const char *rootfs_dir,
+    const char *version
 );
@@ -0,0 +1,538 @@
+/**
+ * This code is responsible for writing directory trees as tar archives in
+ * process, streaming them straight to their destination instead of going
+ * through `tar` and an intermediate file.
+ */
+
+#include "all.h"
+
+/**
+ * A type representing a tar header block, in GNU format.
+ */
+typedef struct ArchiveHeader
+{
+    char name[100];
+    char mode[8];
+    char uid[8];
+    char gid[8];
+    char size[12];
+    char mtime[12];
+    char checksum[8];
+    char type;
+    char link_name[100];
+    char magic[6];
+    char version[2];
+    char user_name[32];
+    char group_name[32];
+    char device_major[8];
+    char device_minor[8];
+    char prefix[155];
+    char padding[12];
+} ArchiveHeader;
+
+_Static_assert(sizeof(ArchiveHeader) == ARCHIVE_BLOCK_SIZE, "tar headers fill one block");
+
+/**
+ * A type representing a file with several hardlinks, and the name its first
+ * link was archived under.
+ */
+typedef struct ArchiveLink
+{
+    dev_t device;
+    ino_t inode;
+    char *name;
+} ArchiveLink;
+
+/**
+ * A type representing the state of a write_tree_archive() call.
+ */
+typedef struct ArchiveWriter
+{
+    int output_fd;
+    unsigned char *buffer;
+    size_t buffer_length;
+    ArchiveLink *links;
+    size_t link_count;
+    time_t max_mtime;
+    int has_failed;
+} ArchiveWriter;
+
+static int flush_archive_buffer(ArchiveWriter *writer)
+{
+    // Write the whole buffer, resuming after partial writes.
+    size_t written = 0;
+    while (!writer->has_failed && written < writer->buffer_length)
+    {
+        ssize_t length = write(writer->output_fd, writer->buffer + written, writer->buffer_length - written);
+        if (length < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (length <= 0)
+        {
+            writer->has_failed = 1;
+            break;
+        }
+        written += (size_t)length;
+    }
+    writer->buffer_length = 0;
+
+    return writer->has_failed ? -1 : 0;
+}
+
+static int append_archive_bytes(ArchiveWriter *writer, const void *data, size_t length)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    while (length > 0)
+    {
+        if (writer->buffer_length == ARCHIVE_BUFFER_SIZE && flush_archive_buffer(writer) != 0)
+        {
+            return -1;
+        }
+        size_t chunk_length = ARCHIVE_BUFFER_SIZE - writer->buffer_length;
+        if (chunk_length > length)
+        {
+            chunk_length = length;
+        }
+        if (bytes)
+        {
+            memcpy(writer->buffer + writer->buffer_length, bytes, chunk_length);
+            bytes += chunk_length;
+        }
+        else
+        {
+            memset(writer->buffer + writer->buffer_length, 0, chunk_length);
+        }
+        writer->buffer_length += chunk_length;
+        length -= chunk_length;
+    }
+    return 0;
+}
+
+static int append_archive_padding(ArchiveWriter *writer, unsigned long long length)
+{
+    // Pad data up to the next block with zeros.
+    size_t remainder = (size_t)(length % ARCHIVE_BLOCK_SIZE);
+    if (remainder == 0)
+    {
+        return 0;
+    }
+    return append_archive_bytes(writer, NULL, ARCHIVE_BLOCK_SIZE - remainder);
+}
+
+static void format_archive_number(char *field, size_t field_size, unsigned long long value)
+{
+    // Use octal when the value fits, and GNU base-256 otherwise.
+    int digit_count = (int)field_size - 1;
+    if (digit_count * 3 >= 64 || value < (1ULL << (digit_count * 3)))
+    {
+        char digits[32];
+        snprintf(digits, sizeof(digits), "%0*llo", digit_count, value);
+        memcpy(field, digits, (size_t)digit_count);
+        field[digit_count] = '\0';
+        return;
+    }
+    memset(field, 0, field_size);
+    field[0] = (char)0x80;
+    for (size_t i = field_size - 1; i > 0 && value > 0; i--)
+    {
+        field[i] = (char)(value & 0xff);
+        value >>= 8;
+    }
+}
+
+static int append_archive_header(ArchiveWriter *writer, ArchiveHeader *header)
+{
+    // Sum the header with the checksum field counted as spaces.
+    memcpy(header->magic, "ustar ", sizeof(header->magic));
+    memcpy(header->version, " ", sizeof(header->version));
+    memset(header->checksum, ' ', sizeof(header->checksum));
+    unsigned int checksum = 0;
+    const unsigned char *bytes = (const unsigned char *)header;
+    for (size_t i = 0; i < sizeof(*header); i++)
+    {
+        checksum += bytes[i];
+    }
+    snprintf(header->checksum, sizeof(header->checksum), "%06o", checksum);
+    header->checksum[7] = ' ';
+
+    return append_archive_bytes(writer, header, sizeof(*header));
+}
+
+static int append_long_name(ArchiveWriter *writer, char type, const char *name)
+{
+    // Store a name too long for its header field in a record of its own,
+    // which applies to the next header.
+    ArchiveHeader header;
+    memset(&header, 0, sizeof(header));
+    snprintf(header.name, sizeof(header.name), "././@LongLink");
+    format_archive_number(header.mode, sizeof(header.mode), 0);
+    format_archive_number(header.uid, sizeof(header.uid), 0);
+    format_archive_number(header.gid, sizeof(header.gid), 0);
+    format_archive_number(header.size, sizeof(header.size), strlen(name) + 1);
+    format_archive_number(header.mtime, sizeof(header.mtime), 0);
+    header.type = type;
+    if (append_archive_header(writer, &header) != 0 ||
+        append_archive_bytes(writer, name, strlen(name) + 1) != 0 ||
+        append_archive_padding(writer, strlen(name) + 1) != 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+static int append_entry_header(
+    ArchiveWriter *writer,
+    const char *name,
+    const struct stat *entry_stat,
+    char type,
+    const char *link_name,
+    unsigned long long size
+)
+{
+    if (strlen(name) > sizeof(((ArchiveHeader *)0)->name) && append_long_name(writer, 'L', name) != 0)
+    {
+        return -1;
+    }
+    if (link_name && strlen(link_name) > sizeof(((ArchiveHeader *)0)->link_name) &&
+        append_long_name(writer, 'K', link_name) != 0)
+    {
+        return -1;
+    }
+
+    // Fill in the header, keeping owners numeric and clamping the mtime.
+    ArchiveHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.name, name, strnlen(name, sizeof(header.name)));
+    if (link_name)
+    {
+        memcpy(header.link_name, link_name, strnlen(link_name, sizeof(header.link_name)));
+    }
+    format_archive_number(header.mode, sizeof(header.mode), entry_stat->st_mode & 07777);
+    format_archive_number(header.uid, sizeof(header.uid), entry_stat->st_uid);
+    format_archive_number(header.gid, sizeof(header.gid), entry_stat->st_gid);
+    format_archive_number(header.size, sizeof(header.size), size);
+    time_t mtime = entry_stat->st_mtime < writer->max_mtime ? entry_stat->st_mtime : writer->max_mtime;
+    format_archive_number(header.mtime, sizeof(header.mtime), mtime > 0 ? (unsigned long long)mtime : 0);
+    header.type = type;
+    if (type == '3' || type == '4')
+    {
+        format_archive_number(header.device_major, sizeof(header.device_major), major(entry_stat->st_rdev));
+        format_archive_number(header.device_minor, sizeof(header.device_minor), minor(entry_stat->st_rdev));
+    }
+
+    return append_archive_header(writer, &header);
+}
+
+static const char *find_archived_link(const ArchiveWriter *writer, const struct stat *entry_stat)
+{
+    // Find the name an earlier link of the same inode was archived under.
+    for (size_t i = 0; i < writer->link_count; i++)
+    {
+        if (writer->links[i].inode == entry_stat->st_ino && writer->links[i].device == entry_stat->st_dev)
+        {
+            return writer->links[i].name;
+        }
+    }
+    return NULL;
+}
+
+static int remember_archived_link(ArchiveWriter *writer, const struct stat *entry_stat, const char *name)
+{
+    ArchiveLink *grown = realloc(writer->links, (writer->link_count + 1) * sizeof(*grown));
+    if (!grown)
+    {
+        return -1;
+    }
+    writer->links = grown;
+    writer->links[writer->link_count].device = entry_stat->st_dev;
+    writer->links[writer->link_count].inode = entry_stat->st_ino;
+    writer->links[writer->link_count].name = strdup(name);
+    if (!writer->links[writer->link_count].name)
+    {
+        return -1;
+    }
+    writer->link_count++;
+    return 0;
+}
+
+static int append_file_data(ArchiveWriter *writer, const char *path, unsigned long long size)
+{
+    int fd = open(path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    // Read the file straight into the output buffer.
+    unsigned long long remaining = size;
+    while (remaining > 0)
+    {
+        if (writer->buffer_length == ARCHIVE_BUFFER_SIZE && flush_archive_buffer(writer) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+        size_t chunk_length = ARCHIVE_BUFFER_SIZE - writer->buffer_length;
+        if (chunk_length > remaining)
+        {
+            chunk_length = (size_t)remaining;
+        }
+        ssize_t length = read(fd, writer->buffer + writer->buffer_length, chunk_length);
+        if (length < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (length < 0)
+        {
+            close(fd);
+            return -1;
+        }
+        if (length == 0)
+        {
+            break;
+        }
+        writer->buffer_length += (size_t)length;
+        remaining -= (unsigned long long)length;
+    }
+    close(fd);
+
+    // Keep the archive consistent with the header if the file shrank.
+    if (remaining > 0)
+    {
+        LOG_WARNING("%s shrank while being archived, padding it with zeros", path);
+        while (remaining > 0)
+        {
+            size_t chunk_length = remaining > ARCHIVE_BUFFER_SIZE ? ARCHIVE_BUFFER_SIZE : (size_t)remaining;
+            if (append_archive_bytes(writer, NULL, chunk_length) != 0)
+            {
+                return -1;
+            }
+            remaining -= chunk_length;
+        }
+    }
+
+    return append_archive_padding(writer, size);
+}
+
+static int append_tree_entry(ArchiveWriter *writer, const char *path, const char *name)
+{
+    struct stat entry_stat;
+    if (lstat(path, &entry_stat) != 0)
+    {
+        return -1;
+    }
+
+    if (S_ISREG(entry_stat.st_mode))
+    {
+        // Archive further links of a file as hardlinks to the first.
+        if (entry_stat.st_nlink > 1)
+        {
+            const char *link_name = find_archived_link(writer, &entry_stat);
+            if (link_name)
+            {
+                return append_entry_header(writer, name, &entry_stat, '1', link_name, 0);
+            }
+            if (remember_archived_link(writer, &entry_stat, name) != 0)
+            {
+                return -1;
+            }
+        }
+        unsigned long long size = (unsigned long long)entry_stat.st_size;
+        if (append_entry_header(writer, name, &entry_stat, '0', NULL, size) != 0)
+        {
+            return -1;
+        }
+        return append_file_data(writer, path, size);
+    }
+    if (S_ISLNK(entry_stat.st_mode))
+    {
+        char target[COMMON_MAX_PATH_LENGTH];
+        ssize_t target_length = readlink(path, target, sizeof(target) - 1);
+        if (target_length < 0)
+        {
+            return -1;
+        }
+        target[target_length] = '\0';
+        return append_entry_header(writer, name, &entry_stat, '2', target, 0);
+    }
+    if (S_ISCHR(entry_stat.st_mode))
+    {
+        return append_entry_header(writer, name, &entry_stat, '3', NULL, 0);
+    }
+    if (S_ISBLK(entry_stat.st_mode))
+    {
+        return append_entry_header(writer, name, &entry_stat, '4', NULL, 0);
+    }
+    if (S_ISFIFO(entry_stat.st_mode))
+    {
+        return append_entry_header(writer, name, &entry_stat, '6', NULL, 0);
+    }
+    if (!S_ISDIR(entry_stat.st_mode))
+    {
+        // Leave out sockets, like tar does.
+        return 0;
+    }
+
+    // Archive the directory, then its entries in sorted order.
+    char directory_name[COMMON_MAX_PATH_LENGTH];
+    snprintf(directory_name, sizeof(directory_name), "%s/", name);
+    if (append_entry_header(writer, directory_name, &entry_stat, '5', NULL, 0) != 0)
+    {
+        return -1;
+    }
+    struct dirent **entries = NULL;
+    int entry_count = scandir(path, &entries, NULL, alphasort);
+    if (entry_count < 0)
+    {
+        return -1;
+    }
+    int result = 0;
+    for (int i = 0; i < entry_count; i++)
+    {
+        const char *entry_name = entries[i]->d_name;
+        if (result != 0 || strcmp(entry_name, ".") == 0 || strcmp(entry_name, "..") == 0)
+        {
+            continue;
+        }
+        char entry_path[COMMON_MAX_PATH_LENGTH];
+        char entry_archive_name[COMMON_MAX_PATH_LENGTH];
+        snprintf(entry_path, sizeof(entry_path), "%s/%s", path, entry_name);
+        int length = snprintf(
+            entry_archive_name, sizeof(entry_archive_name), "%s/%s", name, entry_name
+        );
+        if (length < 0 || (size_t)length >= sizeof(entry_archive_name))
+        {
+            result = -1;
+            continue;
+        }
+        result = append_tree_entry(writer, entry_path, entry_archive_name);
+    }
+    for (int i = 0; i < entry_count; i++)
+    {
+        free(entries[i]);
+    }
+    free(entries);
+
+    return result;
+}
+
+static pid_t start_compressor(const char *compress_program, int output_fd, int *out_input_fd)
+{
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0)
+    {
+        return -1;
+    }
+    fcntl(pipe_fds[1], F_SETFD, FD_CLOEXEC);
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        return -1;
+    }
+    if (pid == 0)
+    {
+        // Compress the pipe into the output file.
+        dup2(pipe_fds[0], STDIN_FILENO);
+        dup2(output_fd, STDOUT_FILENO);
+        execl("/bin/sh", "sh", "-c", compress_program, (char *)NULL);
+        _exit(127);
+    }
+
+    close(pipe_fds[0]);
+    *out_input_fd = pipe_fds[1];
+
+    return pid;
+}
+
+int write_tree_archive(
+    const char *root_path,
+    const char *compress_program,
+    const char *output_path,
+    time_t max_mtime
+)
+{
+    int output_fd = open(output_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (output_fd < 0)
+    {
+        return -1;
+    }
+
+    // Send the archive through the compressor, if there is one.
+    ArchiveWriter writer;
+    memset(&writer, 0, sizeof(writer));
+    writer.output_fd = output_fd;
+    writer.max_mtime = max_mtime;
+    pid_t compressor = -1;
+    if (compress_program)
+    {
+        compressor = start_compressor(compress_program, output_fd, &writer.output_fd);
+        close(output_fd);
+        if (compressor < 0)
+        {
+            return -2;
+        }
+    }
+
+    // Ignore SIGPIPE, so a compressor that dies shows up as a failed write
+    // rather than killing the builder.
+    struct sigaction ignore_action;
+    struct sigaction previous_action;
+    memset(&ignore_action, 0, sizeof(ignore_action));
+    ignore_action.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &ignore_action, &previous_action);
+
+    // Archive the tree, then end it with two zero blocks.
+    int walk_result = -1;
+    writer.buffer = malloc(ARCHIVE_BUFFER_SIZE);
+    if (!writer.buffer)
+    {
+        writer.has_failed = 1;
+    }
+    else
+    {
+        walk_result = append_tree_entry(&writer, root_path, ".");
+        if (walk_result == 0)
+        {
+            append_archive_bytes(&writer, NULL, 2 * ARCHIVE_BLOCK_SIZE);
+        }
+        flush_archive_buffer(&writer);
+    }
+    close(writer.output_fd);
+    sigaction(SIGPIPE, &previous_action, NULL);
+
+    // Wait for the compressor to finish the output.
+    int compressor_status = 0;
+    if (compressor > 0)
+    {
+        while (waitpid(compressor, &compressor_status, 0) < 0 && errno == EINTR)
+        {
+            continue;
+        }
+    }
+
+    free(writer.buffer);
+    for (size_t i = 0; i < writer.link_count; i++)
+    {
+        free(writer.links[i].name);
+    }
+    free(writer.links);
+
+    if (compressor > 0 && !(WIFEXITED(compressor_status) && WEXITSTATUS(compressor_status) == 0))
+    {
+        return -5;
+    }
+    if (writer.has_failed)
+    {
+        return -4;
+    }
+    if (walk_result != 0)
+    {
+        return -3;
+    }
+
+    return 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "../all.h"
+
+/** The size of a tar block, which headers and file data are padded to. */
+#define ARCHIVE_BLOCK_SIZE 512
+
+/** The size of the buffer collecting archive output before it is written. */
+#define ARCHIVE_BUFFER_SIZE (1024 * 1024)
+
+/**
+ * Writes a directory tree as a tar archive, without running `tar`.
+ *
+ * The archive matches `tar --numeric-owner -cf <output> -C <root_path> .`
+ * in GNU format: entries are named "./<path>", owners are stored as numeric
+ * IDs only, hardlinks are kept, and sockets are left out. Entries are
+ * written in sorted order and mtimes are clamped to `max_mtime`, so the same
+ * tree always gives the same archive. The archive is streamed straight to
+ * its output, through the compressor if one is given, so no intermediate
+ * file is written.
+ *
+ * @param root_path The path to the directory to archive.
+ * @param compress_program A shell command compressing stdin to stdout, or
+ * NULL to write the archive uncompressed.
+ * @param output_path The path of the archive to create.
+ * @param max_mtime The latest mtime stored, such as the SOURCE_DATE_EPOCH.
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates the output file could not be created.
+ * @return - `-2` - Indicates the compressor could not be started.
+ * @return - `-3` - Indicates a path in the tree could not be read.
+ * @return - `-4` - Indicates the archive could not be written.
+ * @return - `-5` - Indicates the compressor failed.
+ */
+int write_tree_archive(
+    const char *root_path,
+    const char *compress_program,
+    const char *output_path,
+    time_t max_mtime
+);
@@ -0,0 +1,544 @@
+/**
+ * This code is responsible for cloning files by hardlink or reflink so
+ * cached artifacts can be placed into a build without copying their bytes,
+ * and for copying whole trees with as little data movement as the
+ * filesystem allows.
+ */
+
+#include "all.h"
+
+/** The maximum number of threads copying file data in copy_tree(). */
+#define CLONE_MAX_THREADS 8
+
+/** The number of tree entries allocated at a time. */
+#define CLONE_ENTRY_CHUNK 1024
+
+/** The size of the buffer used when the kernel cannot copy the data. */
+#define CLONE_BUFFER_SIZE 65536
+
+/** The size of the buffer listing a file's extended attribute names. */
+#define CLONE_XATTR_LIST_SIZE 65536
+
+/** The size of the buffer holding one extended attribute value. */
+#define CLONE_XATTR_VALUE_SIZE 65536
+
+/**
+ * A type representing a path of a tree being copied.
+ */
+typedef struct TreeEntry
+{
+    char *source_path;
+    char *destination_path;
+    struct stat source_stat;
+} TreeEntry;
+
+/**
+ * A type representing the state of a copy_tree() call.
+ */
+typedef struct TreeCopy
+{
+    TreeEntry *files;
+    size_t file_count;
+    TreeEntry *links;
+    size_t link_count;
+    TreeEntry *directories;
+    size_t directory_count;
+    pthread_mutex_t lock;
+    size_t next_file;
+    int has_failed;
+} TreeCopy;
+
+int clone_file(const char *source_path, const char *destination_path)
+{
+    // Try a hardlink first, which shares the inode outright.
+    if (link(source_path, destination_path) == 0)
+    {
+        return 0;
+    }
+
+    // Open the source file for a reflink attempt.
+    int source_fd = open(source_path, O_RDONLY | O_CLOEXEC);
+    if (source_fd < 0)
+    {
+        return -1;
+    }
+
+    // Create the destination file with the source file's permissions.
+    struct stat source_stat;
+    mode_t mode = 0644;
+    if (fstat(source_fd, &source_stat) == 0)
+    {
+        mode = source_stat.st_mode & 07777;
+    }
+    int destination_fd = open(
+        destination_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode
+    );
+    if (destination_fd < 0)
+    {
+        close(source_fd);
+        return -2;
+    }
+
+    // Share the source extents on copy-on-write filesystems.
+    int clone_result = ioctl(destination_fd, FICLONE, source_fd);
+    close(destination_fd);
+    close(source_fd);
+    if (clone_result != 0)
+    {
+        unlink(destination_path);
+        return -3;
+    }
+
+    return 0;
+}
+
+static int copy_file_data(int source_fd, int destination_fd, off_t size)
+{
+    // Share the source extents on copy-on-write filesystems.
+    if (ioctl(destination_fd, FICLONE, source_fd) == 0)
+    {
+        return 0;
+    }
+
+    // Let the kernel copy the data, which avoids a round trip through user
+    // space and may still share extents or offload the copy.
+    off_t copied = 0;
+    while (copied < size)
+    {
+        ssize_t length = syscall(
+            SYS_copy_file_range, source_fd, NULL, destination_fd, NULL,
+            (size_t)(size - copied), 0
+        );
+        if (length <= 0)
+        {
+            break;
+        }
+        copied += length;
+    }
+    if (copied >= size)
+    {
+        return 0;
+    }
+
+    // Copy the remainder through a buffer.
+    if (lseek(source_fd, copied, SEEK_SET) < 0 || lseek(destination_fd, copied, SEEK_SET) < 0)
+    {
+        return -1;
+    }
+    char buffer[CLONE_BUFFER_SIZE];
+    ssize_t read_length;
+    while ((read_length = read(source_fd, buffer, sizeof(buffer))) > 0)
+    {
+        ssize_t written = 0;
+        while (written < read_length)
+        {
+            ssize_t length = write(destination_fd, buffer + written, (size_t)(read_length - written));
+            if (length < 0)
+            {
+                return -1;
+            }
+            written += length;
+        }
+    }
+
+    return read_length == 0 ? 0 : -1;
+}
+
+int clone_or_copy_file(const char *source_path, const char *destination_path)
+{
+    // Open the source file.
+    int source_fd = open(source_path, O_RDONLY | O_CLOEXEC);
+    if (source_fd < 0)
+    {
+        return -1;
+    }
+    struct stat source_stat;
+    if (fstat(source_fd, &source_stat) != 0)
+    {
+        close(source_fd);
+        return -1;
+    }
+
+    // Create the destination file with the source file's permissions.
+    int destination_fd = open(
+        destination_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+        source_stat.st_mode & 07777
+    );
+    if (destination_fd < 0)
+    {
+        close(source_fd);
+        return -2;
+    }
+
+    // Copy the data, sharing extents where possible.
+    int copy_result = copy_file_data(source_fd, destination_fd, source_stat.st_size);
+    close(source_fd);
+    if (close(destination_fd) != 0 || copy_result != 0)
+    {
+        unlink(destination_path);
+        return -3;
+    }
+
+    return 0;
+}
+
+static void copy_extended_attributes(const char *source_path, const char *destination_path)
+{
+    // List the attributes, including POSIX ACLs and file capabilities.
+    char names[CLONE_XATTR_LIST_SIZE];
+    ssize_t names_length = llistxattr(source_path, names, sizeof(names));
+    if (names_length <= 0)
+    {
+        return;
+    }
+
+    // Copy each attribute. Failures are ignored, as with `cp -a`, since the
+    // destination filesystem may not support every namespace.
+    char value[CLONE_XATTR_VALUE_SIZE];
+    for (char *name = names; name < names + names_length; name += strlen(name) + 1)
+    {
+        ssize_t value_length = lgetxattr(source_path, name, value, sizeof(value));
+        if (value_length >= 0)
+        {
+            lsetxattr(destination_path, name, value, (size_t)value_length, 0);
+        }
+    }
+}
+
+static int apply_metadata(const TreeEntry *entry)
+{
+    const char *source_path = entry->source_path;
+    const char *destination_path = entry->destination_path;
+    const struct stat *source_stat = &entry->source_stat;
+
+    // Set the owner first, since it clears set-ID bits and capabilities.
+    if (lchown(destination_path, source_stat->st_uid, source_stat->st_gid) != 0)
+    {
+        return -1;
+    }
+    copy_extended_attributes(source_path, destination_path);
+
+    // Set the permissions, which symlinks do not have.
+    if (!S_ISLNK(source_stat->st_mode) &&
+        chmod(destination_path, source_stat->st_mode & 07777) != 0)
+    {
+        return -1;
+    }
+
+    // Set the timestamps last, since every change above updates them.
+    struct timespec times[2] = { source_stat->st_atim, source_stat->st_mtim };
+    if (utimensat(AT_FDCWD, destination_path, times, AT_SYMLINK_NOFOLLOW) != 0)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int create_special_entry(const TreeEntry *entry)
+{
+    // Recreate the symlink or node.
+    if (S_ISLNK(entry->source_stat.st_mode))
+    {
+        char target[COMMON_MAX_PATH_LENGTH];
+        ssize_t target_length = readlink(entry->source_path, target, sizeof(target) - 1);
+        if (target_length < 0)
+        {
+            return -1;
+        }
+        target[target_length] = '\0';
+        if (symlink(target, entry->destination_path) != 0)
+        {
+            return -1;
+        }
+    }
+    else if (mknod(
+        entry->destination_path, entry->source_stat.st_mode, entry->source_stat.st_rdev) != 0)
+    {
+        return -1;
+    }
+
+    return apply_metadata(entry);
+}
+
+static int append_tree_entry(
+    TreeEntry **entries,
+    size_t *entry_count,
+    const char *source_path,
+    const char *destination_path,
+    const struct stat *source_stat
+)
+{
+    // Grow the list in chunks, since a rootfs holds tens of thousands of
+    // entries.
+    if (*entry_count % CLONE_ENTRY_CHUNK == 0)
+    {
+        TreeEntry *grown = realloc(
+            *entries, (*entry_count + CLONE_ENTRY_CHUNK) * sizeof(*grown)
+        );
+        if (!grown)
+        {
+            return -1;
+        }
+        *entries = grown;
+    }
+
+    // Store the entry with its own copies of the paths.
+    TreeEntry *entry = &(*entries)[*entry_count];
+    entry->source_path = strdup(source_path);
+    entry->destination_path = strdup(destination_path);
+    entry->source_stat = *source_stat;
+    if (!entry->source_path || !entry->destination_path)
+    {
+        free(entry->source_path);
+        free(entry->destination_path);
+        return -1;
+    }
+    (*entry_count)++;
+
+    return 0;
+}
+
+static void free_tree_entries(TreeEntry *entries, size_t entry_count)
+{
+    for (size_t i = 0; i < entry_count; i++)
+    {
+        free(entries[i].source_path);
+        free(entries[i].destination_path);
+    }
+    free(entries);
+}
+
+static const TreeEntry *find_linked_file(const TreeCopy *copy, const struct stat *source_stat)
+{
+    // Find an earlier path of the same inode, to keep hardlinks intact.
+    for (size_t i = 0; i < copy->file_count; i++)
+    {
+        const struct stat *file_stat = &copy->files[i].source_stat;
+        if (file_stat->st_ino == source_stat->st_ino && file_stat->st_dev == source_stat->st_dev)
+        {
+            return &copy->files[i];
+        }
+    }
+    return NULL;
+}
+
+static int walk_tree(TreeCopy *copy, const char *source_path, const char *destination_path)
+{
+    // Open the source directory.
+    DIR *directory = opendir(source_path);
+    if (!directory)
+    {
+        return -1;
+    }
+
+    struct dirent *entry;
+    int result = 0;
+    while (result == 0 && (entry = readdir(directory)) != NULL)
+    {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+        {
+            continue;
+        }
+
+        // Construct both paths and inspect the source entry.
+        char entry_source[COMMON_MAX_PATH_LENGTH];
+        char entry_destination[COMMON_MAX_PATH_LENGTH];
+        snprintf(entry_source, sizeof(entry_source), "%s/%s", source_path, entry->d_name);
+        snprintf(entry_destination, sizeof(entry_destination), "%s/%s", destination_path, entry->d_name);
+        struct stat entry_stat;
+        if (lstat(entry_source, &entry_stat) != 0)
+        {
+            result = -1;
+            break;
+        }
+
+        // Recreate directories now and fix their metadata once filled.
+        if (S_ISDIR(entry_stat.st_mode))
+        {
+            if ((mkdir(entry_destination, 0700) != 0 && errno != EEXIST) ||
+                append_tree_entry(
+                    &copy->directories, &copy->directory_count,
+                    entry_source, entry_destination, &entry_stat) != 0)
+            {
+                result = -1;
+                break;
+            }
+            result = walk_tree(copy, entry_source, entry_destination);
+            continue;
+        }
+
+        // Link further paths of a hardlinked file once its data is copied.
+        unlink(entry_destination);
+        if (S_ISREG(entry_stat.st_mode))
+        {
+            const TreeEntry *linked_file = entry_stat.st_nlink > 1
+                ? find_linked_file(copy, &entry_stat)
+                : NULL;
+            if (linked_file)
+            {
+                result = append_tree_entry(
+                    &copy->links, &copy->link_count,
+                    linked_file->destination_path, entry_destination, &entry_stat
+                );
+            }
+            else
+            {
+                result = append_tree_entry(
+                    &copy->files, &copy->file_count,
+                    entry_source, entry_destination, &entry_stat
+                );
+            }
+            continue;
+        }
+
+        // Recreate symlinks, device nodes, FIFOs and sockets in place.
+        TreeEntry special_entry = {
+            .source_path = entry_source,
+            .destination_path = entry_destination,
+            .source_stat = entry_stat
+        };
+        result = create_special_entry(&special_entry);
+    }
+    closedir(directory);
+
+    return result;
+}
+
+static void *copy_tree_files(void *argument)
+{
+    TreeCopy *copy = (TreeCopy *)argument;
+    while (1)
+    {
+        // Claim the next file, unless another thread has failed.
+        pthread_mutex_lock(&copy->lock);
+        if (copy->has_failed || copy->next_file >= copy->file_count)
+        {
+            pthread_mutex_unlock(&copy->lock);
+            return NULL;
+        }
+        const TreeEntry *file = &copy->files[copy->next_file++];
+        pthread_mutex_unlock(&copy->lock);
+
+        // Copy the data and metadata of the file.
+        int result = clone_or_copy_file(file->source_path, file->destination_path);
+        if (result == 0)
+        {
+            result = apply_metadata(file);
+        }
+        if (result != 0)
+        {
+            pthread_mutex_lock(&copy->lock);
+            copy->has_failed = 1;
+            pthread_mutex_unlock(&copy->lock);
+        }
+    }
+}
+
+int copy_tree(const char *source_path, const char *destination_path)
+{
+    TreeCopy copy = {0};
+    pthread_mutex_init(&copy.lock, NULL);
+
+    // Create the destination root and record the whole tree.
+    struct stat root_stat;
+    int result = 0;
+    if (lstat(source_path, &root_stat) != 0 || !S_ISDIR(root_stat.st_mode) ||
+        (mkdir(destination_path, 0700) != 0 && errno != EEXIST) ||
+        append_tree_entry(
+            &copy.directories, &copy.directory_count,
+            source_path, destination_path, &root_stat) != 0 ||
+        walk_tree(&copy, source_path, destination_path) != 0)
+    {
+        result = -1;
+    }
+
+    // Copy file data on several threads, since filesystems without
+    // reflinks are bound by per-file latency rather than bandwidth.
+    if (result == 0)
+    {
+        long processor_count = sysconf(_SC_NPROCESSORS_ONLN);
+        int thread_count = processor_count < 1 ? 1
+            : processor_count > CLONE_MAX_THREADS ? CLONE_MAX_THREADS
+            : (int)processor_count;
+        pthread_t threads[CLONE_MAX_THREADS];
+        int started_count = 0;
+        for (int i = 0; i < thread_count; i++)
+        {
+            if (pthread_create(&threads[i], NULL, copy_tree_files, &copy) != 0)
+            {
+                break;
+            }
+            started_count++;
+        }
+        if (started_count == 0)
+        {
+            copy_tree_files(&copy);
+        }
+        for (int i = 0; i < started_count; i++)
+        {
+            pthread_join(threads[i], NULL);
+        }
+        if (copy.has_failed)
+        {
+            result = -2;
+        }
+    }
+
+    // Recreate the remaining paths of hardlinked files.
+    for (size_t i = 0; result == 0 && i < copy.link_count; i++)
+    {
+        if (link(copy.links[i].source_path, copy.links[i].destination_path) != 0)
+        {
+            result = -1;
+        }
+    }
+
+    // Fix directory metadata deepest first, after their contents exist.
+    for (size_t i = copy.directory_count; result == 0 && i > 0; i--)
+    {
+        if (apply_metadata(&copy.directories[i - 1]) != 0)
+        {
+            result = -1;
+        }
+    }
+
+    free_tree_entries(copy.files, copy.file_count);
+    free_tree_entries(copy.links, copy.link_count);
+    free_tree_entries(copy.directories, copy.directory_count);
+    pthread_mutex_destroy(&copy.lock);
+
+    return result;
+}
+
+int copy_path(const char *source_path, const char *destination_path)
+{
+    // Copy directories as whole trees.
+    struct stat source_stat;
+    if (lstat(source_path, &source_stat) != 0)
+    {
+        return -1;
+    }
+    if (S_ISDIR(source_stat.st_mode))
+    {
+        return copy_tree(source_path, destination_path);
+    }
+
+    // Replace anything else with a copy, keeping its metadata.
+    TreeEntry entry = {
+        .source_path = (char *)source_path,
+        .destination_path = (char *)destination_path,
+        .source_stat = source_stat
+    };
+    unlink(destination_path);
+    if (!S_ISREG(source_stat.st_mode))
+    {
+        return create_special_entry(&entry);
+    }
+    if (clone_or_copy_file(source_path, destination_path) != 0)
+    {
+        return -2;
+    }
+
+    return apply_metadata(&entry);
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "../all.h"
+
+/**
+ * Clones a file without copying its bytes, when the filesystem allows it.
+ *
+ * Tries a hardlink first, then a reflink (FICLONE) on copy-on-write
+ * filesystems such as btrfs and XFS. Callers fall back to a regular copy
+ * when neither is possible.
+ *
+ * @param source_path The path to the existing file.
+ * @param destination_path The path to create.
+ *
+ * @return - `0` - Indicates the file was hardlinked or reflinked.
+ * @return - `-1` - Indicates the source file could not be opened.
+ * @return - `-2` - Indicates the destination file could not be created.
+ * @return - `-3` - Indicates the filesystem supports neither method.
+ */
+int clone_file(const char *source_path, const char *destination_path);
+
+/**
+ * Copies a file, sharing its extents when the filesystem allows it.
+ *
+ * Tries a reflink (FICLONE) first, then `copy_file_range`, then a buffered
+ * copy. Unlike clone_file(), the destination is always a separate inode, so
+ * it can be modified without affecting the source. The destination gets the
+ * source file's permissions.
+ *
+ * @param source_path The path to the existing file.
+ * @param destination_path The path to create or overwrite.
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates the source file could not be opened.
+ * @return - `-2` - Indicates the destination file could not be created.
+ * @return - `-3` - Indicates the data could not be copied.
+ */
+int clone_or_copy_file(const char *source_path, const char *destination_path);
+
+/**
+ * Copies a directory tree, sharing extents when the filesystem allows it.
+ *
+ * Keeps ownership, permissions, timestamps, hardlinks, extended attributes
+ * (including POSIX ACLs and file capabilities), symlinks, device nodes and
+ * FIFOs intact, like `cp -a`. File data is copied by clone_or_copy_file()
+ * on several threads. The destination directory is created if missing.
+ *
+ * @param source_path The path to the directory to copy.
+ * @param destination_path The path to copy the directory's contents to.
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates a path could not be read or recreated.
+ * @return - `-2` - Indicates file data could not be copied.
+ */
+int copy_tree(const char *source_path, const char *destination_path);
+
+/**
+ * Copies a file, symlink, special file or directory tree, like `cp -a`.
+ *
+ * Directories are copied with copy_tree(). Anything else replaces whatever
+ * is at the destination, keeping its ownership, permissions, timestamps
+ * and extended attributes.
+ *
+ * @param source_path The path to copy.
+ * @param destination_path The path to create or overwrite.
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates a path could not be read or recreated.
+ * @return - `-2` - Indicates file data could not be copied.
+ */
+int copy_path(const char *source_path, const char *destination_path);
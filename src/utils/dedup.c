@@ -0,0 +1,329 @@
+/**
+ * This code is responsible for collapsing identical files of a tree into
+ * hardlinks, so archives and images built from it store each one once.
+ */
+
+#include "all.h"
+
+/** The maximum number of threads hashing files in deduplicate_tree(). */
+#define DEDUP_MAX_THREADS 8
+
+/** The number of files allocated at a time. */
+#define DEDUP_FILE_CHUNK 1024
+
+/** The size of a file digest. */
+#define DEDUP_DIGEST_SIZE 32
+
+/**
+ * A type representing a file that may be linked to an identical one.
+ */
+typedef struct DedupFile
+{
+    char *path;
+    struct stat file_stat;
+    unsigned char digest[DEDUP_DIGEST_SIZE];
+} DedupFile;
+
+/**
+ * A type representing the state of a deduplicate_tree() call.
+ */
+typedef struct TreeDedup
+{
+    DedupFile *files;
+    size_t file_count;
+    pthread_mutex_t lock;
+    size_t next_file;
+    int has_failed;
+} TreeDedup;
+
+static int is_linkable_file(const char *path, const struct stat *file_stat)
+{
+    // Leave out empty files, which hold no data to save, and files that are
+    // already hardlinked, since linking them elsewhere would change what
+    // their other paths share.
+    if (!S_ISREG(file_stat->st_mode) || file_stat->st_size == 0 || file_stat->st_nlink != 1)
+    {
+        return 0;
+    }
+
+    // Leave out files with extended attributes, such as file capabilities,
+    // which would otherwise be lost on one path or gained on another.
+    return llistxattr(path, NULL, 0) == 0;
+}
+
+static int append_dedup_file(TreeDedup *dedup, const char *path, const struct stat *file_stat)
+{
+    // Grow the list in chunks, since a rootfs holds tens of thousands of
+    // files.
+    if (dedup->file_count % DEDUP_FILE_CHUNK == 0)
+    {
+        DedupFile *grown = realloc(
+            dedup->files, (dedup->file_count + DEDUP_FILE_CHUNK) * sizeof(*grown)
+        );
+        if (!grown)
+        {
+            return -1;
+        }
+        dedup->files = grown;
+    }
+
+    // Store the file with its own copy of the path.
+    DedupFile *file = &dedup->files[dedup->file_count];
+    file->path = strdup(path);
+    file->file_stat = *file_stat;
+    if (!file->path)
+    {
+        return -1;
+    }
+    dedup->file_count++;
+
+    return 0;
+}
+
+static int walk_tree(TreeDedup *dedup, const char *scan_path, const char *path)
+{
+    // Open the directory listing the entries to consider.
+    DIR *directory = opendir(scan_path);
+    if (!directory)
+    {
+        return -1;
+    }
+
+    struct dirent *entry;
+    int result = 0;
+    while (result == 0 && (entry = readdir(directory)) != NULL)
+    {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+        {
+            continue;
+        }
+
+        // Construct both paths and inspect the entry in the tree itself. An
+        // upper layer entry missing from the tree is a whiteout.
+        char scan_entry_path[COMMON_MAX_PATH_LENGTH];
+        char entry_path[COMMON_MAX_PATH_LENGTH];
+        snprintf(scan_entry_path, sizeof(scan_entry_path), "%s/%s", scan_path, entry->d_name);
+        snprintf(entry_path, sizeof(entry_path), "%s/%s", path, entry->d_name);
+        struct stat entry_stat;
+        if (lstat(entry_path, &entry_stat) != 0)
+        {
+            if (errno == ENOENT && strcmp(scan_path, path) != 0)
+            {
+                continue;
+            }
+            result = -1;
+            break;
+        }
+
+        // Descend into directories and record the files that can be linked.
+        if (S_ISDIR(entry_stat.st_mode))
+        {
+            result = walk_tree(dedup, scan_entry_path, entry_path);
+        }
+        else if (is_linkable_file(entry_path, &entry_stat))
+        {
+            result = append_dedup_file(dedup, entry_path, &entry_stat);
+        }
+    }
+    closedir(directory);
+
+    return result;
+}
+
+static void *hash_dedup_files(void *argument)
+{
+    TreeDedup *dedup = (TreeDedup *)argument;
+    EVP_MD_CTX *digest_context = EVP_MD_CTX_new();
+    while (1)
+    {
+        // Claim the next file, unless another thread has failed.
+        pthread_mutex_lock(&dedup->lock);
+        if (!digest_context)
+        {
+            dedup->has_failed = 1;
+        }
+        if (dedup->has_failed || dedup->next_file >= dedup->file_count)
+        {
+            pthread_mutex_unlock(&dedup->lock);
+            EVP_MD_CTX_free(digest_context);
+            return NULL;
+        }
+        DedupFile *file = &dedup->files[dedup->next_file++];
+        pthread_mutex_unlock(&dedup->lock);
+
+        // Hash the contents of the file.
+        unsigned int digest_length = 0;
+        if (EVP_DigestInit_ex(digest_context, EVP_sha256(), NULL) != 1 ||
+            hash_file_contents(digest_context, file->path) != 0 ||
+            EVP_DigestFinal_ex(digest_context, file->digest, &digest_length) != 1 ||
+            digest_length != DEDUP_DIGEST_SIZE)
+        {
+            pthread_mutex_lock(&dedup->lock);
+            dedup->has_failed = 1;
+            pthread_mutex_unlock(&dedup->lock);
+        }
+    }
+}
+
+static int compare_metadata(const DedupFile *left, const DedupFile *right)
+{
+    const struct stat *left_stat = &left->file_stat;
+    const struct stat *right_stat = &right->file_stat;
+    if (left_stat->st_size != right_stat->st_size)
+    {
+        return left_stat->st_size < right_stat->st_size ? -1 : 1;
+    }
+    if (left_stat->st_mode != right_stat->st_mode)
+    {
+        return left_stat->st_mode < right_stat->st_mode ? -1 : 1;
+    }
+    if (left_stat->st_uid != right_stat->st_uid)
+    {
+        return left_stat->st_uid < right_stat->st_uid ? -1 : 1;
+    }
+    if (left_stat->st_gid != right_stat->st_gid)
+    {
+        return left_stat->st_gid < right_stat->st_gid ? -1 : 1;
+    }
+    return memcmp(left->digest, right->digest, DEDUP_DIGEST_SIZE);
+}
+
+static int compare_dedup_files(const void *left, const void *right)
+{
+    // Group identical files, ordering each group by path so the same file
+    // is kept on every run.
+    const DedupFile *left_file = (const DedupFile *)left;
+    const DedupFile *right_file = (const DedupFile *)right;
+    int result = compare_metadata(left_file, right_file);
+    return result != 0 ? result : strcmp(left_file->path, right_file->path);
+}
+
+static int replace_with_link(const char *kept_path, const char *path)
+{
+    // Link the kept file beside the duplicate and rename it over the
+    // duplicate, so the path never goes missing.
+    char link_path[COMMON_MAX_PATH_LENGTH];
+    if (snprintf(link_path, sizeof(link_path), "%s.dedup", path) >= (int)sizeof(link_path))
+    {
+        return -1;
+    }
+    unlink(link_path);
+    if (link(kept_path, link_path) != 0)
+    {
+        return errno == EMLINK ? 1 : -1;
+    }
+    if (rename(link_path, path) != 0)
+    {
+        unlink(link_path);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void free_dedup_files(DedupFile *files, size_t file_count)
+{
+    for (size_t i = 0; i < file_count; i++)
+    {
+        free(files[i].path);
+    }
+    free(files);
+}
+
+int deduplicate_tree(
+    const char *root_path,
+    const char *upper_path,
+    unsigned long long *out_saved_bytes
+)
+{
+    TreeDedup dedup = {0};
+    pthread_mutex_init(&dedup.lock, NULL);
+    *out_saved_bytes = 0;
+
+    // Record every file that can be linked. Under an overlay, only files
+    // already in its upper layer are considered, since linking one that is
+    // only in the lower layer copies it up in full.
+    int result = 0;
+    if (walk_tree(&dedup, upper_path ? upper_path : root_path, root_path) != 0)
+    {
+        result = -1;
+    }
+
+    // Hash the files on several threads, since reading a rootfs is bound by
+    // per-file latency rather than bandwidth.
+    if (result == 0)
+    {
+        long processor_count = sysconf(_SC_NPROCESSORS_ONLN);
+        int thread_count = processor_count < 1 ? 1
+            : processor_count > DEDUP_MAX_THREADS ? DEDUP_MAX_THREADS
+            : (int)processor_count;
+        pthread_t threads[DEDUP_MAX_THREADS];
+        int started_count = 0;
+        for (int i = 0; i < thread_count; i++)
+        {
+            if (pthread_create(&threads[i], NULL, hash_dedup_files, &dedup) != 0)
+            {
+                break;
+            }
+            started_count++;
+        }
+        if (started_count == 0)
+        {
+            hash_dedup_files(&dedup);
+        }
+        for (int i = 0; i < started_count; i++)
+        {
+            pthread_join(threads[i], NULL);
+        }
+        if (dedup.has_failed)
+        {
+            result = -2;
+        }
+    }
+
+    // Link each duplicate to the first file of its group. A file that has
+    // reached the filesystem's link limit starts a new group.
+    size_t linked_count = 0;
+    if (result == 0)
+    {
+        qsort(dedup.files, dedup.file_count, sizeof(*dedup.files), compare_dedup_files);
+    }
+    const DedupFile *kept_file = NULL;
+    for (size_t i = 0; result == 0 && i < dedup.file_count; i++)
+    {
+        const DedupFile *file = &dedup.files[i];
+        if (!kept_file || compare_metadata(kept_file, file) != 0)
+        {
+            kept_file = file;
+            continue;
+        }
+        int link_result = replace_with_link(kept_file->path, file->path);
+        if (link_result < 0)
+        {
+            LOG_ERROR("Failed to link %s to %s", file->path, kept_file->path);
+            result = -3;
+        }
+        else if (link_result > 0)
+        {
+            kept_file = file;
+        }
+        else
+        {
+            *out_saved_bytes += (unsigned long long)file->file_stat.st_blocks * 512;
+            linked_count++;
+        }
+    }
+
+    if (result == 0)
+    {
+        LOG_INFO(
+            "Linked %zu identical files of %zu in %s, saving %.1f MB",
+            linked_count, dedup.file_count, root_path, *out_saved_bytes / 1e6
+        );
+    }
+
+    free_dedup_files(dedup.files, dedup.file_count);
+    pthread_mutex_destroy(&dedup.lock);
+
+    return result;
+}
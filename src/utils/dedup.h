@@ -0,0 +1,33 @@
+#pragma once
+#include "../all.h"
+
+/**
+ * Collapses byte-identical files of a directory tree into hardlinks.
+ *
+ * Hashes every regular file on several threads and replaces each duplicate
+ * with a hardlink to the first of its group in path order, so the result is
+ * the same on every run. Only files that are indistinguishable apart from
+ * their path are linked: they must match in size, permissions, owner and
+ * group, have no extended attributes, and not already be hardlinked. Empty
+ * files are left alone. Archives of the tree store each group once.
+ *
+ * When the tree lies in an overlay, only files already in its upper layer
+ * are linked, through the overlay. Linking a file that is only in the lower
+ * layer would copy it up in full, growing the upper layer by more than the
+ * archives save.
+ *
+ * @param root_path The path to the directory tree.
+ * @param upper_path The same directory within the overlay's upper layer, or
+ * `NULL` when the tree is not an overlay.
+ * @param out_saved_bytes Receives the disk space the duplicates occupied.
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates the tree could not be read.
+ * @return - `-2` - Indicates a file could not be hashed.
+ * @return - `-3` - Indicates a duplicate could not be replaced.
+ */
+int deduplicate_tree(
+    const char *root_path,
+    const char *upper_path,
+    unsigned long long *out_saved_bytes
+);
@@ -17,7 +17,6 @@ const char *const REQUIRED_COMMANDS[] = {
     "debootstrap",
     "mksquashfs",
     "grub-mkrescue",
-    "tar",
     "chroot"
 };
 const int REQUIRED_COMMANDS_COUNT =
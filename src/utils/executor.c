@@ -0,0 +1,306 @@
+/**
+ * This code is responsible for running child processes concurrently while
+ * keeping their output readable: every line is tagged with its task name,
+ * full output goes to per-task log files, and the console gets a condensed
+ * view.
+ */
+
+#include "all.h"
+
+int init_executor(Executor *executor, const char *log_dir)
+{
+    memset(executor, 0, sizeof(*executor));
+    snprintf(executor->log_dir, sizeof(executor->log_dir), "%s", log_dir);
+    if (common.mkdir_p(log_dir) != 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+static void forward_line(ExecutorTask *task)
+{
+    task->line[task->line_length] = '\0';
+
+    // Keep every line in the task's log.
+    if (task->log_file)
+    {
+        fprintf(task->log_file, "%s\n", task->line);
+    }
+
+    // Show only the builder's own log lines on the console, since
+    // subprocess output is indented.
+    if (task->line_length > 0 && task->line[0] != ' ' && task->line[0] != '\t')
+    {
+        printf("[%s] %s\n", task->name, task->line);
+        fflush(stdout);
+    }
+
+    task->line_length = 0;
+}
+
+static void pump_task_output(ExecutorTask *task)
+{
+    if (task->output_fd < 0)
+    {
+        return;
+    }
+
+    // Read everything available without blocking.
+    char buffer[4096];
+    ssize_t length;
+    while ((length = read(task->output_fd, buffer, sizeof(buffer))) > 0)
+    {
+        // Split the output into lines, breaking overlong ones.
+        for (ssize_t i = 0; i < length; i++)
+        {
+            if (buffer[i] == '\n')
+            {
+                forward_line(task);
+                continue;
+            }
+            if (buffer[i] == '\r')
+            {
+                continue;
+            }
+            task->line[task->line_length++] = buffer[i];
+            if (task->line_length == sizeof(task->line) - 1)
+            {
+                forward_line(task);
+            }
+        }
+    }
+
+    // Close the pipe once every writer has closed it.
+    if (length == 0)
+    {
+        close(task->output_fd);
+        task->output_fd = -1;
+    }
+}
+
+static void finish_task(ExecutorTask *task, int status)
+{
+    // Forward the output left in the pipe, including an unterminated line.
+    pump_task_output(task);
+    if (task->line_length > 0)
+    {
+        forward_line(task);
+    }
+    if (task->output_fd >= 0)
+    {
+        close(task->output_fd);
+        task->output_fd = -1;
+    }
+    if (task->log_file)
+    {
+        fclose(task->log_file);
+        task->log_file = NULL;
+    }
+
+    // Record how the task ended and how long it took.
+    struct timespec finished_at;
+    clock_gettime(CLOCK_MONOTONIC, &finished_at);
+    task->elapsed_seconds = (double)(finished_at.tv_sec - task->started_at.tv_sec) +
+        (double)(finished_at.tv_nsec - task->started_at.tv_nsec) / 1e9;
+    task->exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    task->is_running = 0;
+}
+
+static int reap_finished_task(Executor *executor)
+{
+    // Reap the first task that has exited, with its resource usage.
+    for (int i = 0; i < executor->task_count; i++)
+    {
+        ExecutorTask *task = &executor->tasks[i];
+        if (!task->is_running)
+        {
+            continue;
+        }
+        int status;
+        if (wait4(task->pid, &status, WNOHANG, &task->usage) == task->pid)
+        {
+            finish_task(task, status);
+            return i;
+        }
+    }
+    return -1;
+}
+
+int start_executor_task(
+    Executor *executor,
+    const char *name,
+    const char *log_name,
+    int (*run)(void *context),
+    void *context
+)
+{
+    // Reuse the slot of a task that has finished and been reported, or take
+    // a new one.
+    int task_index = 0;
+    while (task_index < executor->task_count && executor->tasks[task_index].is_running)
+    {
+        task_index++;
+    }
+    if (task_index >= EXECUTOR_MAX_TASKS)
+    {
+        return -1;
+    }
+
+    // Open the task's log and the pipe capturing its output.
+    ExecutorTask *task = &executor->tasks[task_index];
+    memset(task, 0, sizeof(*task));
+    snprintf(task->name, sizeof(task->name), "%s", name);
+    snprintf(task->log_path, sizeof(task->log_path), "%s/%s.log", executor->log_dir, log_name);
+    task->log_file = fopen(task->log_path, "we");
+    int pipe_fds[2];
+    if (!task->log_file || pipe(pipe_fds) != 0)
+    {
+        if (task->log_file)
+        {
+            fclose(task->log_file);
+        }
+        return -2;
+    }
+
+    // Flush buffered output so the child does not print it again.
+    fflush(NULL);
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        fclose(task->log_file);
+        return -3;
+    }
+    if (pid == 0)
+    {
+        // Send all output into the pipe unbuffered, so the task's own lines
+        // stay in order with its subprocesses' output.
+        dup2(pipe_fds[1], STDOUT_FILENO);
+        dup2(pipe_fds[1], STDERR_FILENO);
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        setvbuf(stdout, NULL, _IONBF, 0);
+
+        // Run in its own process group, so the task can be stopped together
+        // with its subprocesses, and die with the builder.
+        setpgid(0, 0);
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+
+        int result = run(context);
+        fflush(NULL);
+        _exit(result == 0 ? 0 : 1);
+    }
+
+    // Put the child in its own group from the parent too, to avoid racing a
+    // termination against the child's own setpgid().
+    setpgid(pid, pid);
+    close(pipe_fds[1]);
+    fcntl(pipe_fds[0], F_SETFL, fcntl(pipe_fds[0], F_GETFL) | O_NONBLOCK);
+    fcntl(pipe_fds[0], F_SETFD, FD_CLOEXEC);
+
+    task->pid = pid;
+    task->output_fd = pipe_fds[0];
+    task->is_running = 1;
+    clock_gettime(CLOCK_MONOTONIC, &task->started_at);
+    if (task_index == executor->task_count)
+    {
+        executor->task_count++;
+    }
+
+    return task_index;
+}
+
+int wait_executor_task(Executor *executor, int timeout_ms)
+{
+    // Report a task that already exited.
+    int finished = reap_finished_task(executor);
+    if (finished >= 0)
+    {
+        return finished;
+    }
+
+    // Wait for output from any running task.
+    struct pollfd poll_fds[EXECUTOR_MAX_TASKS];
+    int task_indices[EXECUTOR_MAX_TASKS];
+    int poll_count = 0;
+    for (int i = 0; i < executor->task_count; i++)
+    {
+        if (executor->tasks[i].is_running && executor->tasks[i].output_fd >= 0)
+        {
+            poll_fds[poll_count].fd = executor->tasks[i].output_fd;
+            poll_fds[poll_count].events = POLLIN;
+            task_indices[poll_count] = i;
+            poll_count++;
+        }
+    }
+    if (poll(poll_fds, (nfds_t)poll_count, timeout_ms) > 0)
+    {
+        for (int i = 0; i < poll_count; i++)
+        {
+            if (poll_fds[i].revents)
+            {
+                pump_task_output(&executor->tasks[task_indices[i]]);
+            }
+        }
+    }
+
+    return reap_finished_task(executor);
+}
+
+void print_executor_log_tail(const Executor *executor, int task_index)
+{
+    const ExecutorTask *task = &executor->tasks[task_index];
+    FILE *log_file = fopen(task->log_path, "r");
+    if (!log_file)
+    {
+        return;
+    }
+
+    // Keep the last lines in a ring buffer.
+    static char lines[EXECUTOR_FAILURE_TAIL_LINES][EXECUTOR_LINE_MAX_LENGTH];
+    int line_count = 0;
+    while (fgets(lines[line_count % EXECUTOR_FAILURE_TAIL_LINES], sizeof(lines[0]), log_file))
+    {
+        line_count++;
+    }
+    fclose(log_file);
+
+    // Show them in order, tagged like the rest of the task's output.
+    int first = line_count > EXECUTOR_FAILURE_TAIL_LINES ? line_count - EXECUTOR_FAILURE_TAIL_LINES : 0;
+    printf("[%s] Last lines of %s:\n", task->name, task->log_path);
+    for (int i = first; i < line_count; i++)
+    {
+        const char *line = lines[i % EXECUTOR_FAILURE_TAIL_LINES];
+        size_t length = strlen(line);
+        printf("[%s] %s%s", task->name, line, length > 0 && line[length - 1] == '\n' ? "" : "\n");
+    }
+    fflush(stdout);
+}
+
+void stop_executor_tasks(Executor *executor)
+{
+    // Terminate every running task with its subprocesses.
+    for (int i = 0; i < executor->task_count; i++)
+    {
+        if (executor->tasks[i].is_running)
+        {
+            killpg(executor->tasks[i].pid, SIGTERM);
+        }
+    }
+
+    // Reap them so no task outlives the builder's cleanup.
+    for (int i = 0; i < executor->task_count; i++)
+    {
+        ExecutorTask *task = &executor->tasks[i];
+        int status;
+        if (task->is_running && wait4(task->pid, &status, 0, &task->usage) == task->pid)
+        {
+            finish_task(task, status);
+        }
+    }
+}
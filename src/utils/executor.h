@@ -0,0 +1,114 @@
+#pragma once
+#include "../all.h"
+
+/** The maximum number of tasks an executor runs at once. */
+#define EXECUTOR_MAX_TASKS 16
+
+/** The maximum length of a task name. */
+#define EXECUTOR_NAME_MAX_LENGTH 64
+
+/** The maximum length of an output line; longer lines are split. */
+#define EXECUTOR_LINE_MAX_LENGTH 1024
+
+/** The number of log lines shown on the console when a task fails. */
+#define EXECUTOR_FAILURE_TAIL_LINES 20
+
+/**
+ * A type representing a child process run by an executor.
+ */
+typedef struct ExecutorTask
+{
+    char name[EXECUTOR_NAME_MAX_LENGTH];
+    char log_path[COMMON_MAX_PATH_LENGTH];
+    pid_t pid;
+    int output_fd;
+    FILE *log_file;
+    char line[EXECUTOR_LINE_MAX_LENGTH];
+    size_t line_length;
+    int is_running;
+    int exit_status;
+    struct rusage usage;
+    struct timespec started_at;
+    double elapsed_seconds;
+} ExecutorTask;
+
+/**
+ * A type representing a set of concurrently running child processes.
+ */
+typedef struct Executor
+{
+    ExecutorTask tasks[EXECUTOR_MAX_TASKS];
+    int task_count;
+    char log_dir[COMMON_MAX_PATH_LENGTH];
+} Executor;
+
+/**
+ * Initializes an executor.
+ *
+ * @param executor The executor to initialize.
+ * @param log_dir The directory for per-task logs, created if missing.
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates log directory creation failure.
+ */
+int init_executor(Executor *executor, const char *log_dir);
+
+/**
+ * Starts a function in a child process.
+ *
+ * The child runs in its own process group with its standard output and
+ * error captured. Every line it prints is written to
+ * `<log_dir>/<log_name>.log`, and lines that are not indented (the builder's
+ * own log lines, as opposed to subprocess output from
+ * `run_command_indented`) are also shown on the console, prefixed with the
+ * task name. The task takes the slot of one that has finished and been
+ * reported, if any, so the index stays valid only until the next start.
+ *
+ * @param executor The executor.
+ * @param name The task name, used for the prefix.
+ * @param log_name The log file name, without its `.log` extension.
+ * @param run The function to run in the child; its return value becomes
+ * the exit status (zero for success, one otherwise).
+ * @param context The value passed to the function.
+ *
+ * @return - `>=0` - Indicates the index of the started task.
+ * @return - `-1` - Indicates the executor is full.
+ * @return - `-2` - Indicates log file or pipe creation failure.
+ * @return - `-3` - Indicates fork failure.
+ */
+int start_executor_task(
+    Executor *executor,
+    const char *name,
+    const char *log_name,
+    int (*run)(void *context),
+    void *context
+);
+
+/**
+ * Forwards task output until a task finishes or the timeout expires.
+ *
+ * A finished task has its exit status, resource usage (from `wait4`) and
+ * wall time filled in and is no longer running.
+ *
+ * @param executor The executor.
+ * @param timeout_ms The maximum time to wait, in milliseconds.
+ *
+ * @return - `>=0` - Indicates the index of a task that finished.
+ * @return - `-1` - Indicates no task finished within the timeout.
+ */
+int wait_executor_task(Executor *executor, int timeout_ms);
+
+/**
+ * Shows the last lines of a task's log on the console.
+ *
+ * @param executor The executor.
+ * @param task_index The index of the task.
+ */
+void print_executor_log_tail(const Executor *executor, int task_index);
+
+/**
+ * Terminates every running task with its subprocesses and reaps it.
+ *
+ * @param executor The executor.
+ */
+void stop_executor_tasks(Executor *executor);
@@ -0,0 +1,448 @@
+/**
+ * This code is responsible for the content-addressed layer store, which
+ * keeps the output of each build step across builds so a rebuild only
+ * reruns the steps whose inputs changed.
+ *
+ * Layers live at LAYERS_STORE_DIR/<key>/, where the key hashes every input
+ * of the step that produced them. Copies go through the clone engine, so
+ * on copy-on-write filesystems storing and replaying a layer shares its
+ * extents.
+ */
+
+#include "all.h"
+
+/**
+ * A type representing a layer in the store, for pruning.
+ */
+typedef struct LayerEntry
+{
+    char path[COMMON_MAX_PATH_LENGTH];
+    unsigned long long size;
+    time_t last_used;
+} LayerEntry;
+
+int find_layer(const char *key, char *out_path, size_t path_length)
+{
+    snprintf(out_path, path_length, LAYERS_STORE_DIR "/%s", key);
+    struct stat layer_stat;
+    if (stat(out_path, &layer_stat) != 0 || !S_ISDIR(layer_stat.st_mode))
+    {
+        return -1;
+    }
+
+    // Mark the layer as recently used, so pruning keeps it.
+    utimensat(AT_FDCWD, out_path, NULL, 0);
+
+    return 0;
+}
+
+int begin_layer(const char *key, char *out_path, size_t path_length)
+{
+    snprintf(out_path, path_length, LAYERS_STORE_DIR "/.%s.%d.tmp", key, (int)getpid());
+
+    // Start from an empty directory, in case an earlier attempt left one.
+    if (common.rm_rf(out_path) != 0 || common.mkdir_p(out_path) != 0)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+static unsigned long long measure_tree_size(const char *path)
+{
+    struct stat path_stat;
+    if (lstat(path, &path_stat) != 0)
+    {
+        return 0;
+    }
+    unsigned long long size = (unsigned long long)path_stat.st_blocks * 512;
+    if (!S_ISDIR(path_stat.st_mode))
+    {
+        return size;
+    }
+
+    // Add up everything beneath the directory.
+    DIR *directory = opendir(path);
+    if (!directory)
+    {
+        return size;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(directory)) != NULL)
+    {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+        {
+            continue;
+        }
+        char entry_path[COMMON_MAX_PATH_LENGTH];
+        snprintf(entry_path, sizeof(entry_path), "%s/%s", path, entry->d_name);
+        size += measure_tree_size(entry_path);
+    }
+    closedir(directory);
+
+    return size;
+}
+
+static void write_layer_size(const char *layer_path, unsigned long long size)
+{
+    // Record the size beside the layer, so pruning need not measure it.
+    char size_path[COMMON_MAX_PATH_LENGTH];
+    char content[32];
+    snprintf(size_path, sizeof(size_path), "%s.size", layer_path);
+    snprintf(content, sizeof(content), "%llu\n", size);
+    if (common.write_file(size_path, content) != 0)
+    {
+        LOG_WARNING("Failed to record the size of layer %s", layer_path);
+    }
+}
+
+static unsigned long long read_layer_size(const char *layer_path)
+{
+    // Read the size recorded when the layer was published.
+    char size_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(size_path, sizeof(size_path), "%s.size", layer_path);
+    unsigned long long size = 0;
+    FILE *file = fopen(size_path, "r");
+    int is_recorded = file && fscanf(file, "%llu", &size) == 1;
+    if (file)
+    {
+        fclose(file);
+    }
+
+    // Measure and record layers stored without one, only this once.
+    if (!is_recorded)
+    {
+        size = measure_tree_size(layer_path);
+        write_layer_size(layer_path, size);
+    }
+
+    return size;
+}
+
+static int remove_layer(const char *layer_path)
+{
+    // Remove the layer, then the size record that described it.
+    if (common.rm_rf(layer_path) != 0)
+    {
+        return -1;
+    }
+    char size_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(size_path, sizeof(size_path), "%s.size", layer_path);
+    unlink(size_path);
+
+    return 0;
+}
+
+static int compare_layer_entries(const void *left, const void *right)
+{
+    const LayerEntry *left_entry = (const LayerEntry *)left;
+    const LayerEntry *right_entry = (const LayerEntry *)right;
+    if (left_entry->last_used != right_entry->last_used)
+    {
+        return left_entry->last_used < right_entry->last_used ? -1 : 1;
+    }
+    return strcmp(left_entry->path, right_entry->path);
+}
+
+static void prune_layer_store(const char *kept_key)
+{
+    DIR *directory = opendir(LAYERS_STORE_DIR);
+    if (!directory)
+    {
+        return;
+    }
+
+    // Collect every layer with its size and last use.
+    LayerEntry *entries = NULL;
+    size_t entry_count = 0;
+    unsigned long long total_size = 0;
+    struct dirent *entry;
+    while ((entry = readdir(directory)) != NULL)
+    {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+        {
+            continue;
+        }
+        LayerEntry layer_entry;
+        snprintf(layer_entry.path, sizeof(layer_entry.path), LAYERS_STORE_DIR "/%s", entry->d_name);
+
+        // Remove staging directories left by builds that are gone, and
+        // leave those of builds that are still running.
+        if (entry->d_name[0] == '.')
+        {
+            const char *pid_start = strrchr(entry->d_name, '.');
+            while (pid_start > entry->d_name && pid_start[-1] != '.')
+            {
+                pid_start--;
+            }
+            pid_t owner = (pid_t)strtol(pid_start, NULL, 10);
+            if (owner <= 0 || kill(owner, 0) != 0)
+            {
+                common.rm_rf(layer_entry.path);
+            }
+            continue;
+        }
+
+        // Skip size records, removing those whose layer is gone.
+        struct stat entry_stat;
+        if (stat(layer_entry.path, &entry_stat) != 0)
+        {
+            continue;
+        }
+        if (!S_ISDIR(entry_stat.st_mode))
+        {
+            size_t name_length = strlen(layer_entry.path);
+            if (name_length > 5 && strcmp(layer_entry.path + name_length - 5, ".size") == 0)
+            {
+                layer_entry.path[name_length - 5] = '\0';
+                if (!common.file_exists(layer_entry.path))
+                {
+                    layer_entry.path[name_length - 5] = '.';
+                    unlink(layer_entry.path);
+                }
+            }
+            continue;
+        }
+        LayerEntry *grown = realloc(entries, (entry_count + 1) * sizeof(*grown));
+        if (!grown)
+        {
+            break;
+        }
+        entries = grown;
+        layer_entry.size = read_layer_size(layer_entry.path);
+        layer_entry.last_used = entry_stat.st_mtime;
+        entries[entry_count++] = layer_entry;
+        total_size += layer_entry.size;
+    }
+    closedir(directory);
+
+    // Remove the least recently used layers until under the cap.
+    qsort(entries, entry_count, sizeof(*entries), compare_layer_entries);
+    size_t removed_count = 0;
+    for (size_t i = 0; i < entry_count && total_size > CONFIG_LAYER_STORE_MAX_BYTES; i++)
+    {
+        const char *name = strrchr(entries[i].path, '/') + 1;
+        if (strcmp(name, kept_key) == 0)
+        {
+            continue;
+        }
+        if (remove_layer(entries[i].path) == 0)
+        {
+            total_size -= entries[i].size;
+            removed_count++;
+        }
+    }
+    free(entries);
+
+    if (removed_count > 0)
+    {
+        LOG_INFO("Pruned %zu layers from the layer store", removed_count);
+    }
+}
+
+int publish_layer(const char *key, const char *staging_path)
+{
+    char layer_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(layer_path, sizeof(layer_path), LAYERS_STORE_DIR "/%s", key);
+
+    // Measure the layer once, as it is published, for later pruning.
+    unsigned long long size = measure_tree_size(staging_path);
+
+    // Rename the layer into place. Losing the race to another build that
+    // stored the same layer is fine, since layers are content-addressed.
+    if (rename(staging_path, layer_path) != 0)
+    {
+        common.rm_rf(staging_path);
+        if (!common.file_exists(layer_path))
+        {
+            return -1;
+        }
+    }
+    else
+    {
+        write_layer_size(layer_path, size);
+    }
+
+    // Keep the store within its size cap.
+    prune_layer_store(key);
+
+    return 0;
+}
+
+int hash_file_contents(EVP_MD_CTX *digest_context, const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        return -1;
+    }
+
+    // Feed the whole file into the digest.
+    unsigned char buffer[8192];
+    size_t read_length;
+    int result = 0;
+    while ((read_length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        if (EVP_DigestUpdate(digest_context, buffer, read_length) != 1)
+        {
+            result = -1;
+            break;
+        }
+    }
+    if (ferror(file))
+    {
+        result = -1;
+    }
+    fclose(file);
+
+    return result;
+}
+
+int hash_tree_contents(EVP_MD_CTX *digest_context, const char *path)
+{
+    // List the entries sorted, so the digest does not depend on the order
+    // the filesystem returns them in.
+    struct dirent **entries = NULL;
+    int entry_count = scandir(path, &entries, NULL, alphasort);
+    if (entry_count < 0)
+    {
+        return -1;
+    }
+
+    int result = 0;
+    for (int i = 0; i < entry_count; i++)
+    {
+        const char *name = entries[i]->d_name;
+        if (result != 0 || strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+        {
+            continue;
+        }
+        char entry_path[COMMON_MAX_PATH_LENGTH];
+        snprintf(entry_path, sizeof(entry_path), "%s/%s", path, name);
+        struct stat entry_stat;
+        if (lstat(entry_path, &entry_stat) != 0)
+        {
+            result = -1;
+            continue;
+        }
+
+        // Hash the name and permissions, then what the entry holds.
+        unsigned int mode = (unsigned int)entry_stat.st_mode;
+        if (EVP_DigestUpdate(digest_context, name, strlen(name) + 1) != 1 ||
+            EVP_DigestUpdate(digest_context, &mode, sizeof(mode)) != 1)
+        {
+            result = -1;
+        }
+        else if (S_ISDIR(entry_stat.st_mode))
+        {
+            result = hash_tree_contents(digest_context, entry_path);
+        }
+        else if (S_ISREG(entry_stat.st_mode))
+        {
+            result = hash_file_contents(digest_context, entry_path);
+        }
+        else if (S_ISLNK(entry_stat.st_mode))
+        {
+            char target[COMMON_MAX_PATH_LENGTH];
+            ssize_t target_length = readlink(entry_path, target, sizeof(target));
+            if (target_length < 0 ||
+                EVP_DigestUpdate(digest_context, target, (size_t)target_length) != 1)
+            {
+                result = -1;
+            }
+        }
+    }
+    for (int i = 0; i < entry_count; i++)
+    {
+        free(entries[i]);
+    }
+    free(entries);
+
+    return result;
+}
+
+static int create_parent_directory(const char *path)
+{
+    char parent_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(parent_path, sizeof(parent_path), "%s", path);
+    char *separator = strrchr(parent_path, '/');
+    if (separator && separator != parent_path)
+    {
+        *separator = '\0';
+        return common.mkdir_p(parent_path);
+    }
+    return 0;
+}
+
+int record_rootfs_paths(
+    const char *rootfs_path,
+    const char *const *paths,
+    const char *layer_path
+)
+{
+    for (int i = 0; paths[i]; i++)
+    {
+        char source_path[COMMON_MAX_PATH_LENGTH];
+        char destination_path[COMMON_MAX_PATH_LENGTH];
+        snprintf(source_path, sizeof(source_path), "%s%s", rootfs_path, paths[i]);
+        snprintf(destination_path, sizeof(destination_path), "%s/tree%s", layer_path, paths[i]);
+
+        // Leave out paths the step removed.
+        struct stat source_stat;
+        if (lstat(source_path, &source_stat) != 0)
+        {
+            continue;
+        }
+
+        // Copy the path under its place within the rootfs.
+        if (create_parent_directory(destination_path) != 0)
+        {
+            return -1;
+        }
+        int copy_result = copy_path(source_path, destination_path);
+        if (copy_result != 0)
+        {
+            return copy_result == -1 ? -1 : -2;
+        }
+    }
+
+    return 0;
+}
+
+int replay_rootfs_paths(
+    const char *rootfs_path,
+    const char *const *paths,
+    const char *layer_path
+)
+{
+    for (int i = 0; paths[i]; i++)
+    {
+        char source_path[COMMON_MAX_PATH_LENGTH];
+        char destination_path[COMMON_MAX_PATH_LENGTH];
+        snprintf(source_path, sizeof(source_path), "%s/tree%s", layer_path, paths[i]);
+        snprintf(destination_path, sizeof(destination_path), "%s%s", rootfs_path, paths[i]);
+
+        // Replace the path with its recorded copy, if there is one.
+        struct stat source_stat;
+        if (common.rm_rf(destination_path) != 0)
+        {
+            return -1;
+        }
+        if (lstat(source_path, &source_stat) != 0)
+        {
+            continue;
+        }
+        if (create_parent_directory(destination_path) != 0)
+        {
+            return -1;
+        }
+        int copy_result = copy_path(source_path, destination_path);
+        if (copy_result != 0)
+        {
+            return copy_result == -1 ? -1 : -2;
+        }
+    }
+
+    return 0;
+}
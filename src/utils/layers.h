@@ -0,0 +1,114 @@
+#pragma once
+#include "../all.h"
+
+/** The host directory holding the layer store shared across builds. */
+#define LAYERS_STORE_DIR CONFIG_CACHE_DIR "/layers"
+
+/**
+ * Finds the layer stored under a key and marks it as recently used.
+ *
+ * @param key The layer key (hex).
+ * @param out_path The buffer to store the layer directory path.
+ * @param path_length The size of the path buffer.
+ *
+ * @return - `0` - Indicates the layer exists.
+ * @return - `-1` - Indicates no layer is stored under the key.
+ */
+int find_layer(const char *key, char *out_path, size_t path_length);
+
+/**
+ * Creates an empty staging directory for a new layer.
+ *
+ * The staging directory sits inside the store, so publish_layer() can
+ * rename it into place.
+ *
+ * @param key The layer key (hex).
+ * @param out_path The buffer to store the staging directory path.
+ * @param path_length The size of the path buffer.
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates directory creation failure.
+ */
+int begin_layer(const char *key, char *out_path, size_t path_length);
+
+/**
+ * Publishes a staged layer under its key.
+ *
+ * The layer is renamed into place atomically, so concurrent builds never
+ * replay a partial layer; losing the race to another build is fine. Its
+ * size is measured once and recorded in `<key>.size` beside it. The store
+ * is then pruned least recently used first, by those records, until it
+ * fits within CONFIG_LAYER_STORE_MAX_BYTES, sparing the new layer.
+ *
+ * @param key The layer key (hex).
+ * @param staging_path The staging directory from begin_layer().
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates the layer could not be published.
+ */
+int publish_layer(const char *key, const char *staging_path);
+
+/**
+ * Feeds the contents of a file into a digest.
+ *
+ * @param digest_context The digest to update.
+ * @param path The path to the file.
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates read or hashing failure.
+ */
+int hash_file_contents(EVP_MD_CTX *digest_context, const char *path);
+
+/**
+ * Feeds the names, file contents and symlink targets of a directory tree
+ * into a digest, in a stable order.
+ *
+ * @param digest_context The digest to update.
+ * @param path The path to the directory.
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates read or hashing failure.
+ */
+int hash_tree_contents(EVP_MD_CTX *digest_context, const char *path);
+
+/**
+ * Records paths of a rootfs into a layer.
+ *
+ * Copies each directory, file or symlink that exists into
+ * `<layer_path>/tree`, under its path within the rootfs. A missing path is
+ * left out, so replaying the layer removes it.
+ *
+ * @param rootfs_path The path to the rootfs directory.
+ * @param paths The NULL-terminated paths, relative to the rootfs root
+ * (e.g. "/var/cache/apt").
+ * @param layer_path The layer directory.
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates a path could not be read or recreated.
+ * @return - `-2` - Indicates file data copy failure.
+ */
+int record_rootfs_paths(
+    const char *rootfs_path,
+    const char *const *paths,
+    const char *layer_path
+);
+
+/**
+ * Replays paths recorded by record_rootfs_paths() into a rootfs.
+ *
+ * Each path is replaced by its recorded copy, or removed if the layer has
+ * none.
+ *
+ * @param rootfs_path The path to the rootfs directory.
+ * @param paths The NULL-terminated paths, relative to the rootfs root.
+ * @param layer_path The layer directory.
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates a path could not be removed or recreated.
+ * @return - `-2` - Indicates file data copy failure.
+ */
+int replay_rootfs_paths(
+    const char *rootfs_path,
+    const char *const *paths,
+    const char *layer_path
+);
@@ -0,0 +1,167 @@
+/**
+ * This code is responsible for deriving the target and live rootfs from the
+ * base rootfs as overlayfs layers instead of full copies.
+ */
+
+#include "all.h"
+
+static int is_safe_overlay_path(const char *path)
+{
+    // Overlay mount options separate paths with ',' and ':'.
+    return strpbrk(path, ",:\\") == NULL;
+}
+
+static int mount_rootfs_overlay(const char *base_path, const char *path)
+{
+    if (!is_safe_overlay_path(base_path) || !is_safe_overlay_path(path))
+    {
+        return -1;
+    }
+
+    // Create the upper and work directories beside the rootfs, since
+    // overlayfs requires both on the same filesystem.
+    char upper_path[COMMON_MAX_PATH_LENGTH];
+    char work_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(upper_path, sizeof(upper_path), "%s.layer/upper", path);
+    snprintf(work_path, sizeof(work_path), "%s.layer/work", path);
+    if (common.mkdir_p(upper_path) != 0 ||
+        common.mkdir_p(work_path) != 0 ||
+        common.mkdir_p(path) != 0)
+    {
+        return -2;
+    }
+
+    // Mount the overlay with the base rootfs as its read-only lower layer.
+    char options[COMMON_MAX_COMMAND_LENGTH];
+    int length = snprintf(
+        options, sizeof(options), "lowerdir=%s,upperdir=%s,workdir=%s",
+        base_path, upper_path, work_path
+    );
+    if (length < 0 || (size_t)length >= sizeof(options))
+    {
+        return -1;
+    }
+    if (mount("overlay", path, "overlay", 0, options) != 0)
+    {
+        return -3;
+    }
+
+    return 0;
+}
+
+int derive_rootfs(const char *base_path, const char *path)
+{
+    // Prefer an overlay, which copies nothing up front.
+    if (mount_rootfs_overlay(base_path, path) == 0)
+    {
+        LOG_INFO("Mounted %s as an overlay of the base rootfs", path);
+        return 0;
+    }
+    LOG_WARNING("Could not mount an overlay at %s, copying the base rootfs", path);
+
+    // Remove what the failed attempt left behind.
+    char layer_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(layer_path, sizeof(layer_path), "%s.layer", path);
+    common.rm_rf(layer_path);
+    rmdir(path);
+
+    // Copy the base rootfs, sharing extents where the filesystem allows it.
+    int copy_result = copy_tree(base_path, path);
+    if (copy_result != 0)
+    {
+        return copy_result == -1 ? -1 : -2;
+    }
+
+    return 0;
+}
+
+static int is_mount_point(const char *path)
+{
+    // A mounted overlay has a different device than its parent directory.
+    char parent_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(parent_path, sizeof(parent_path), "%s/..", path);
+    struct stat path_stat;
+    struct stat parent_stat;
+    if (stat(path, &path_stat) != 0 || stat(parent_path, &parent_stat) != 0)
+    {
+        return 0;
+    }
+    return path_stat.st_dev != parent_stat.st_dev;
+}
+
+int attach_rootfs(const char *base_path, const char *path)
+{
+    // Nothing to mount for a copied rootfs or one never created.
+    char layer_path[COMMON_MAX_PATH_LENGTH];
+    char upper_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(layer_path, sizeof(layer_path), "%s.layer", path);
+    snprintf(upper_path, sizeof(upper_path), "%s/upper", layer_path);
+    if (!common.file_exists(upper_path))
+    {
+        return 0;
+    }
+
+    // Serialize with other steps attaching the same rootfs, since mounting
+    // it twice would stack two overlays on one upper layer.
+    char lock_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(lock_path, sizeof(lock_path), "%s/lock", layer_path);
+    int lock_fd = open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (lock_fd < 0 || flock(lock_fd, LOCK_EX) != 0)
+    {
+        if (lock_fd >= 0)
+        {
+            close(lock_fd);
+        }
+        return -1;
+    }
+
+    // Mount the existing upper layer again, unless it still is.
+    int result = 0;
+    if (!is_mount_point(path))
+    {
+        if (mount_rootfs_overlay(base_path, path) == 0)
+        {
+            LOG_INFO("Remounted %s from its existing overlay layer", path);
+        }
+        else
+        {
+            result = -2;
+        }
+    }
+
+    close(lock_fd);
+    return result;
+}
+
+int detach_rootfs(const char *path)
+{
+    // Unmount the overlay, if the rootfs is one. Overlays may have been
+    // mounted by another build step's process, so ask the kernel rather
+    // than tracking them.
+    if (umount2(path, 0) != 0 && errno != EINVAL && errno != ENOENT &&
+        umount2(path, MNT_DETACH) != 0)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+int release_rootfs(const char *path)
+{
+    // Unmount the overlay, if any.
+    if (detach_rootfs(path) != 0)
+    {
+        return -1;
+    }
+
+    // Remove the rootfs and its upper layer.
+    char layer_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(layer_path, sizeof(layer_path), "%s.layer", path);
+    if (common.rm_rf(path) != 0 || common.rm_rf(layer_path) != 0)
+    {
+        return -2;
+    }
+
+    return 0;
+}
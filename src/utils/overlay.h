@@ -0,0 +1,64 @@
+#pragma once
+#include "../all.h"
+
+/**
+ * Derives a rootfs from the base rootfs as a copy-on-write layer.
+ *
+ * Mounts an overlay at the path with the base rootfs as its read-only lower
+ * layer and an upper layer in a sibling `<path>.layer` directory, so only
+ * files the later steps modify are materialized. Falls back to copy_tree(),
+ * which reflinks where it can, when the kernel cannot mount the overlay.
+ * The base rootfs must stay unmodified until the rootfs is released.
+ *
+ * @param base_path The path to the base rootfs directory.
+ * @param path The path to create the rootfs at.
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates a path could not be read or recreated.
+ * @return - `-2` - Indicates file data copy failure.
+ */
+int derive_rootfs(const char *base_path, const char *path);
+
+/**
+ * Mounts a rootfs created by derive_rootfs() again after it was detached.
+ *
+ * Reuses the overlay's existing upper layer, so the rootfs comes back with
+ * every change made before it was detached. Does nothing for a rootfs that
+ * is still mounted, was copied rather than mounted, or was never created.
+ * Safe to call from concurrent build steps.
+ *
+ * @param base_path The path to the base rootfs directory.
+ * @param path The path to the rootfs directory.
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates layer lock failure.
+ * @return - `-2` - Indicates mount failure.
+ */
+int attach_rootfs(const char *base_path, const char *path);
+
+/**
+ * Unmounts a rootfs created by derive_rootfs(), keeping its upper layer.
+ *
+ * Safe to call on a path that is not mounted or was never created.
+ *
+ * @param path The path to the rootfs directory.
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates unmount failure.
+ */
+int detach_rootfs(const char *path);
+
+/**
+ * Releases a rootfs created by derive_rootfs().
+ *
+ * Unmounts its overlay, if any, and removes the rootfs and its upper layer.
+ * Safe to call on a path that was never created.
+ *
+ * @param path The path to the rootfs directory.
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates unmount failure.
+ * @return - `-2` - Indicates removal failure.
+ */
+int release_rootfs(const char *path);
+
@@ -0,0 +1,355 @@
+/**
+ * This code is responsible for the host package archive shared by every
+ * chroot and every build.
+ *
+ * Packages live at PACKAGES_ARCHIVE_DIR/<sha256>.deb, keyed by the hash APT
+ * expects, so a package placed into a chroot is exactly the one APT would
+ * have downloaded. APT still verifies every package it installs.
+ */
+
+#include "all.h"
+
+/**
+ * A type representing a package stored in the archive, for pruning.
+ */
+typedef struct ArchiveEntry
+{
+    char path[COMMON_MAX_PATH_LENGTH];
+    off_t size;
+    time_t last_used;
+} ArchiveEntry;
+
+static int load_package_plan(
+    const char *rootfs_path,
+    PlannedPackage **out_packages,
+    size_t *out_package_count
+)
+{
+    *out_packages = NULL;
+    *out_package_count = 0;
+
+    // Open the plan APT wrote into the chroot.
+    char plan_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(plan_path, sizeof(plan_path), "%s" PACKAGES_PLAN_PATH, rootfs_path);
+    FILE *plan_file = fopen(plan_path, "r");
+    if (!plan_file)
+    {
+        return -1;
+    }
+
+    // Parse lines of the form: 'uri' filename size SHA256:hash
+    char line[4096];
+    while (fgets(line, sizeof(line), plan_file))
+    {
+        char filename[PACKAGES_FILENAME_MAX_LENGTH];
+        char hash[128];
+        if (sscanf(line, "'%*[^']' %255s %*s %127s", filename, hash) != 2)
+        {
+            continue;
+        }
+
+        // Only archive packages with a SHA-256 and a plain filename.
+        if (strncmp(hash, "SHA256:", 7) != 0 ||
+            strlen(hash + 7) != COMMON_SHA256_HEX_LENGTH - 1 ||
+            filename[0] == '.' || strchr(filename, '/'))
+        {
+            continue;
+        }
+
+        // Grow the list by one slot.
+        PlannedPackage *grown = realloc(
+            *out_packages, (*out_package_count + 1) * sizeof(*grown)
+        );
+        if (!grown)
+        {
+            fclose(plan_file);
+            free(*out_packages);
+            *out_packages = NULL;
+            *out_package_count = 0;
+            return -2;
+        }
+        *out_packages = grown;
+
+        // Store the filename and the lowercase hash.
+        PlannedPackage *package = &grown[*out_package_count];
+        snprintf(package->filename, sizeof(package->filename), "%s", filename);
+        for (int i = 0; i < COMMON_SHA256_HEX_LENGTH; i++)
+        {
+            package->sha256[i] = (char)tolower((unsigned char)hash[7 + i]);
+        }
+        (*out_package_count)++;
+    }
+    fclose(plan_file);
+
+    return 0;
+}
+
+static int hash_package(const char *path, char *out_sha256)
+{
+    // Open the package and a SHA-256 digest.
+    FILE *package_file = fopen(path, "rb");
+    if (!package_file)
+    {
+        return -1;
+    }
+    EVP_MD_CTX *digest_context = EVP_MD_CTX_new();
+    if (!digest_context || EVP_DigestInit_ex(digest_context, EVP_sha256(), NULL) != 1)
+    {
+        EVP_MD_CTX_free(digest_context);
+        fclose(package_file);
+        return -1;
+    }
+
+    // Feed the whole package into the digest.
+    char buffer[65536];
+    size_t read_length;
+    int result = 0;
+    while ((read_length = fread(buffer, 1, sizeof(buffer), package_file)) > 0)
+    {
+        if (EVP_DigestUpdate(digest_context, buffer, read_length) != 1)
+        {
+            result = -1;
+            break;
+        }
+    }
+    if (ferror(package_file))
+    {
+        result = -1;
+    }
+    fclose(package_file);
+
+    // Render the digest as lowercase hex.
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_length = 0;
+    if (EVP_DigestFinal_ex(digest_context, digest, &digest_length) != 1)
+    {
+        result = -1;
+    }
+    EVP_MD_CTX_free(digest_context);
+    if (result != 0)
+    {
+        return -1;
+    }
+    for (unsigned int i = 0; i < digest_length; i++)
+    {
+        snprintf(out_sha256 + i * 2, 3, "%02x", digest[i]);
+    }
+
+    return 0;
+}
+
+static void seed_packages(
+    const char *rootfs_path,
+    const PlannedPackage *packages,
+    size_t package_count
+)
+{
+    size_t seeded_count = 0;
+    for (size_t i = 0; i < package_count; i++)
+    {
+        // Skip packages the archive does not hold.
+        char archive_path[COMMON_MAX_PATH_LENGTH];
+        snprintf(
+            archive_path, sizeof(archive_path),
+            PACKAGES_ARCHIVE_DIR "/%s.deb", packages[i].sha256
+        );
+        if (!common.file_exists(archive_path))
+        {
+            continue;
+        }
+
+        // Place the package where APT looks before downloading.
+        char chroot_path[COMMON_MAX_PATH_LENGTH];
+        snprintf(
+            chroot_path, sizeof(chroot_path),
+            "%s" CONFIG_APT_CACHE_DIR "/%s", rootfs_path, packages[i].filename
+        );
+        unlink(chroot_path);
+        if (clone_file(archive_path, chroot_path) != 0 &&
+            common.copy_file(archive_path, chroot_path) != 0)
+        {
+            LOG_WARNING("Failed to place archived package %s", packages[i].filename);
+            continue;
+        }
+
+        // Mark the package as recently used for pruning.
+        utimensat(AT_FDCWD, archive_path, NULL, 0);
+        seeded_count++;
+    }
+
+    LOG_INFO("Reusing %zu of %zu packages from the package archive", seeded_count, package_count);
+}
+
+static void store_packages(
+    const char *rootfs_path,
+    const PlannedPackage *packages,
+    size_t package_count
+)
+{
+    for (size_t i = 0; i < package_count; i++)
+    {
+        // Skip packages the archive already holds.
+        char archive_path[COMMON_MAX_PATH_LENGTH];
+        snprintf(
+            archive_path, sizeof(archive_path),
+            PACKAGES_ARCHIVE_DIR "/%s.deb", packages[i].sha256
+        );
+        if (common.file_exists(archive_path))
+        {
+            continue;
+        }
+
+        // Skip packages the command did not leave behind.
+        char chroot_path[COMMON_MAX_PATH_LENGTH];
+        snprintf(
+            chroot_path, sizeof(chroot_path),
+            "%s" CONFIG_APT_CACHE_DIR "/%s", rootfs_path, packages[i].filename
+        );
+        if (!common.file_exists(chroot_path))
+        {
+            continue;
+        }
+
+        // Only archive packages whose content matches the expected hash.
+        char actual_sha256[COMMON_SHA256_HEX_LENGTH];
+        if (hash_package(chroot_path, actual_sha256) != 0 ||
+            strcmp(actual_sha256, packages[i].sha256) != 0)
+        {
+            LOG_WARNING("Not archiving %s: checksum mismatch", packages[i].filename);
+            continue;
+        }
+
+        // Publish the package atomically so concurrent builds never place
+        // a partial file.
+        char staging_path[COMMON_MAX_PATH_LENGTH];
+        snprintf(staging_path, sizeof(staging_path), "%s.%d.tmp", archive_path, getpid());
+        if ((clone_file(chroot_path, staging_path) != 0 &&
+                common.copy_file(chroot_path, staging_path) != 0) ||
+            rename(staging_path, archive_path) != 0)
+        {
+            unlink(staging_path);
+            LOG_WARNING("Failed to archive package %s", packages[i].filename);
+        }
+    }
+}
+
+static int compare_archive_entries(const void *left, const void *right)
+{
+    const ArchiveEntry *left_entry = (const ArchiveEntry *)left;
+    const ArchiveEntry *right_entry = (const ArchiveEntry *)right;
+    if (left_entry->last_used != right_entry->last_used)
+    {
+        return left_entry->last_used < right_entry->last_used ? -1 : 1;
+    }
+    return strcmp(left_entry->path, right_entry->path);
+}
+
+static void prune_package_archive(void)
+{
+    DIR *directory = opendir(PACKAGES_ARCHIVE_DIR);
+    if (!directory)
+    {
+        return;
+    }
+
+    // Collect every archived package with its size and last use.
+    ArchiveEntry *entries = NULL;
+    size_t entry_count = 0;
+    unsigned long long total_size = 0;
+    struct dirent *entry;
+    while ((entry = readdir(directory)) != NULL)
+    {
+        size_t name_length = strlen(entry->d_name);
+        if (name_length < 4 || strcmp(entry->d_name + name_length - 4, ".deb") != 0)
+        {
+            continue;
+        }
+        ArchiveEntry archive_entry;
+        snprintf(
+            archive_entry.path, sizeof(archive_entry.path),
+            PACKAGES_ARCHIVE_DIR "/%s", entry->d_name
+        );
+        struct stat entry_stat;
+        if (stat(archive_entry.path, &entry_stat) != 0 || !S_ISREG(entry_stat.st_mode))
+        {
+            continue;
+        }
+        ArchiveEntry *grown = realloc(entries, (entry_count + 1) * sizeof(*grown));
+        if (!grown)
+        {
+            break;
+        }
+        entries = grown;
+        archive_entry.size = entry_stat.st_size;
+        archive_entry.last_used = entry_stat.st_mtime;
+        entries[entry_count++] = archive_entry;
+        total_size += (unsigned long long)entry_stat.st_size;
+    }
+    closedir(directory);
+
+    // Remove the least recently used packages until under the cap.
+    qsort(entries, entry_count, sizeof(*entries), compare_archive_entries);
+    size_t removed_count = 0;
+    for (size_t i = 0; i < entry_count && total_size > CONFIG_PACKAGES_ARCHIVE_MAX_BYTES; i++)
+    {
+        if (unlink(entries[i].path) == 0)
+        {
+            total_size -= (unsigned long long)entries[i].size;
+            removed_count++;
+        }
+    }
+    free(entries);
+
+    if (removed_count > 0)
+    {
+        LOG_INFO("Pruned %zu packages from the package archive", removed_count);
+    }
+}
+
+int run_with_package_archive(
+    const char *rootfs_path,
+    const char *apt_arguments,
+    const char *command
+)
+{
+    // Ask APT which packages the command would download.
+    char plan_command[COMMON_MAX_COMMAND_LENGTH];
+    snprintf(
+        plan_command, sizeof(plan_command),
+        "apt-get -qq --print-uris %s > " PACKAGES_PLAN_PATH,
+        apt_arguments
+    );
+    PlannedPackage *packages = NULL;
+    size_t package_count = 0;
+    int has_plan = common.run_chroot(rootfs_path, plan_command) == 0 &&
+        load_package_plan(rootfs_path, &packages, &package_count) == 0;
+    if (!has_plan)
+    {
+        LOG_WARNING("Could not plan package downloads, bypassing the package archive");
+    }
+
+    // Place archived packages into the chroot.
+    int has_archive = has_plan && common.mkdir_p(PACKAGES_ARCHIVE_DIR) == 0;
+    if (has_archive)
+    {
+        seed_packages(rootfs_path, packages, package_count);
+    }
+
+    // Run the command, which downloads only what is still missing.
+    int command_result = common.run_chroot_indented(rootfs_path, command);
+
+    // Keep newly downloaded packages for later chroots and builds.
+    if (command_result == 0 && has_archive)
+    {
+        store_packages(rootfs_path, packages, package_count);
+        prune_package_archive();
+    }
+
+    // Remove the plan so it does not end up in the image.
+    char plan_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(plan_path, sizeof(plan_path), "%s" PACKAGES_PLAN_PATH, rootfs_path);
+    unlink(plan_path);
+    free(packages);
+
+    return command_result == 0 ? 0 : -1;
+}
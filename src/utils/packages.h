@@ -0,0 +1,45 @@
+#pragma once
+#include "../all.h"
+
+/** The host directory holding the shared package archive. */
+#define PACKAGES_ARCHIVE_DIR CONFIG_CACHE_DIR "/apt"
+
+/** The path of the download plan inside a chroot. */
+#define PACKAGES_PLAN_PATH "/var/cache/apt/limeos-package-plan"
+
+/** The maximum length of a package filename in a download plan. */
+#define PACKAGES_FILENAME_MAX_LENGTH 256
+
+/**
+ * A type representing a package that APT plans to download.
+ */
+typedef struct PlannedPackage
+{
+    char filename[PACKAGES_FILENAME_MAX_LENGTH];
+    char sha256[COMMON_SHA256_HEX_LENGTH];
+} PlannedPackage;
+
+/**
+ * Runs an APT command in a chroot through the host package archive.
+ *
+ * Asks APT which packages `apt-get <apt_arguments>` would download, places
+ * those already in the archive into the chroot's CONFIG_APT_CACHE_DIR, runs
+ * the command, then stores every newly downloaded package in the archive
+ * after verifying its SHA-256. The archive is keyed by SHA-256, so a
+ * package is only downloaded once per host, and it is pruned least recently
+ * used first once it grows past CONFIG_PACKAGES_ARCHIVE_MAX_BYTES. Archive
+ * failures are logged and never fail the command.
+ *
+ * @param rootfs_path The path to the rootfs directory.
+ * @param apt_arguments The apt-get arguments that select the packages
+ * (e.g. "install --no-install-recommends grub-pc").
+ * @param command The command to run in the chroot.
+ *
+ * @return - `0` - Indicates success.
+ * @return - `-1` - Indicates the command failed.
+ */
+int run_with_package_archive(
+    const char *rootfs_path,
+    const char *apt_arguments,
+    const char *command
+);
@@ -45,7 +45,7 @@ int copy_kernel_and_initrd(const char *rootfs_path)
         return -1;
     }
     snprintf(dst, sizeof(dst), "%s/boot/vmlinuz", rootfs_path);
-    if (common.copy_file(src, dst) != 0)
+    if (clone_or_copy_file(src, dst) != 0)
     {
         return -2;
     }
@@ -57,7 +57,7 @@ int copy_kernel_and_initrd(const char *rootfs_path)
         return -3;
     }
     snprintf(dst, sizeof(dst), "%s/boot/initrd.img", rootfs_path);
-    if (common.copy_file(src, dst) != 0)
+    if (clone_or_copy_file(src, dst) != 0)
     {
         return -4;
     }
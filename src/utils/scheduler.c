@@ -0,0 +1,617 @@
+/**
+ * This code is responsible for running the build as a graph of steps,
+ * overlapping steps whose input artifacts are ready. Steps run as executor
+ * tasks, so their output stays readable when they overlap. Completed steps
+ * can be checkpointed so a rerun resumes where the last run failed, and
+ * their outputs are kept in the layer store so later builds replay every
+ * step whose inputs did not change.
+ */
+
+#include "all.h"
+
+/**
+ * A type representing the progress of a build step. Stored steps have their
+ * output in the layer store, but not in place.
+ */
+typedef enum StepState
+{
+    STEP_PENDING,
+    STEP_QUEUED,
+    STEP_RUNNING,
+    STEP_STORED,
+    STEP_DONE
+} StepState;
+
+/**
+ * A type representing what a step's executor task does: run the step, or
+ * replay its stored layer.
+ */
+typedef struct StepInvocation
+{
+    const BuildStep *step;
+    void *context;
+    char key[COMMON_SHA256_HEX_LENGTH];
+    int is_replay;
+} StepInvocation;
+
+static int find_producer(const BuildStep *steps, int step_count, const char *artifact)
+{
+    // Find the single step that produces the artifact.
+    int producer = -1;
+    for (int i = 0; i < step_count; i++)
+    {
+        for (int j = 0; j < SCHEDULER_MAX_ARTIFACTS && steps[i].outputs[j]; j++)
+        {
+            if (strcmp(steps[i].outputs[j], artifact) != 0)
+            {
+                continue;
+            }
+            if (producer != -1)
+            {
+                return -2;
+            }
+            producer = i;
+        }
+    }
+    return producer;
+}
+
+static int resolve_dependencies(
+    const BuildStep *steps,
+    int step_count,
+    int dependencies[][SCHEDULER_MAX_ARTIFACTS]
+)
+{
+    // Map every input to the step producing it.
+    for (int i = 0; i < step_count; i++)
+    {
+        for (int j = 0; j < SCHEDULER_MAX_ARTIFACTS; j++)
+        {
+            dependencies[i][j] = -1;
+            if (!steps[i].inputs[j])
+            {
+                continue;
+            }
+            dependencies[i][j] = find_producer(steps, step_count, steps[i].inputs[j]);
+            if (dependencies[i][j] < 0)
+            {
+                LOG_ERROR(
+                    "Build step %s needs %s, which no single step produces",
+                    steps[i].name, steps[i].inputs[j]
+                );
+                return -1;
+            }
+        }
+    }
+
+    // Reject cycles by ordering the steps the way the scheduler would.
+    int is_ordered[SCHEDULER_MAX_STEPS] = {0};
+    for (int ordered_count = 0; ordered_count < step_count; ordered_count++)
+    {
+        int next = -1;
+        for (int i = 0; i < step_count && next == -1; i++)
+        {
+            int is_ready = !is_ordered[i];
+            for (int j = 0; j < SCHEDULER_MAX_ARTIFACTS && is_ready; j++)
+            {
+                is_ready = dependencies[i][j] < 0 || is_ordered[dependencies[i][j]];
+            }
+            if (is_ready)
+            {
+                next = i;
+            }
+        }
+        if (next == -1)
+        {
+            LOG_ERROR("Build graph contains a cycle");
+            return -1;
+        }
+        is_ordered[next] = 1;
+    }
+
+    return 0;
+}
+
+static int finish_hex_digest(EVP_MD_CTX *digest_context, int result, char *out_key)
+{
+    // Finish the digest and encode it as hex.
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_length = 0;
+    if (result == 0 && EVP_DigestFinal_ex(digest_context, digest, &digest_length) != 1)
+    {
+        result = -1;
+    }
+    EVP_MD_CTX_free(digest_context);
+    if (result != 0)
+    {
+        return -1;
+    }
+    for (unsigned int i = 0; i < digest_length; i++)
+    {
+        snprintf(out_key + i * 2, 3, "%02x", digest[i]);
+    }
+
+    return 0;
+}
+
+static int build_layer_key(
+    const BuildStep *step,
+    void *context,
+    const int *step_dependencies,
+    char keys[][COMMON_SHA256_HEX_LENGTH],
+    char *out_key
+)
+{
+    // A step whose dependencies have no key has none either.
+    out_key[0] = '\0';
+    for (int i = 0; i < SCHEDULER_MAX_ARTIFACTS; i++)
+    {
+        if (step_dependencies[i] >= 0 && keys[step_dependencies[i]][0] == '\0')
+        {
+            return -1;
+        }
+    }
+
+    EVP_MD_CTX *digest_context = EVP_MD_CTX_new();
+    if (!digest_context || EVP_DigestInit_ex(digest_context, EVP_sha256(), NULL) != 1)
+    {
+        EVP_MD_CTX_free(digest_context);
+        return -2;
+    }
+
+    // Hash the step, its own inputs, and the keys of the steps it depends
+    // on, so a change to any input reaches every step downstream of it.
+    int result = 0;
+    if (EVP_DigestUpdate(digest_context, step->name, strlen(step->name) + 1) != 1 ||
+        (step->hash_inputs && step->hash_inputs(context, digest_context) != 0))
+    {
+        result = -1;
+    }
+    for (int i = 0; i < SCHEDULER_MAX_ARTIFACTS && result == 0; i++)
+    {
+        if (step_dependencies[i] < 0)
+        {
+            continue;
+        }
+        const char *key = keys[step_dependencies[i]];
+        if (EVP_DigestUpdate(digest_context, key, strlen(key) + 1) != 1)
+        {
+            result = -1;
+        }
+    }
+
+    if (finish_hex_digest(digest_context, result, out_key) != 0)
+    {
+        out_key[0] = '\0';
+        return -2;
+    }
+
+    return 0;
+}
+
+static int build_checkpoint_key(
+    const char *fingerprint,
+    const BuildStep *step,
+    const int *step_dependencies,
+    char markers[][SCHEDULER_CHECKPOINT_MAX_LENGTH],
+    char *out_key
+)
+{
+    EVP_MD_CTX *digest_context = EVP_MD_CTX_new();
+    if (!digest_context || EVP_DigestInit_ex(digest_context, EVP_sha256(), NULL) != 1)
+    {
+        EVP_MD_CTX_free(digest_context);
+        return -1;
+    }
+
+    // Hash the shared inputs, the step, and the markers of the steps it
+    // depends on, which change whenever one of them runs again.
+    int result = 0;
+    if (EVP_DigestUpdate(digest_context, fingerprint, strlen(fingerprint) + 1) != 1 ||
+        EVP_DigestUpdate(digest_context, step->name, strlen(step->name) + 1) != 1)
+    {
+        result = -1;
+    }
+    for (int i = 0; i < SCHEDULER_MAX_ARTIFACTS && result == 0; i++)
+    {
+        if (step_dependencies[i] < 0)
+        {
+            continue;
+        }
+        const char *marker = markers[step_dependencies[i]];
+        if (EVP_DigestUpdate(digest_context, marker, strlen(marker) + 1) != 1)
+        {
+            result = -1;
+        }
+    }
+
+    return finish_hex_digest(digest_context, result, out_key);
+}
+
+static int read_checkpoint(const char *checkpoint_dir, const char *name, char *out_marker)
+{
+    char marker_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(marker_path, sizeof(marker_path), "%s/%s.done", checkpoint_dir, name);
+    FILE *marker_file = fopen(marker_path, "r");
+    if (!marker_file)
+    {
+        return -1;
+    }
+
+    // Read the marker's single line.
+    int result = fgets(out_marker, SCHEDULER_CHECKPOINT_MAX_LENGTH, marker_file) ? 0 : -1;
+    fclose(marker_file);
+    out_marker[strcspn(out_marker, "\n")] = '\0';
+
+    return result;
+}
+
+static int write_checkpoint(
+    const char *checkpoint_dir,
+    const char *name,
+    const char *key,
+    char *out_marker
+)
+{
+    // Tag the key with this run, so steps depending on this one see that it
+    // ran again even when its inputs did not change.
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    snprintf(
+        out_marker, SCHEDULER_CHECKPOINT_MAX_LENGTH, "%s %lx.%lx.%x",
+        key, (unsigned long)now.tv_sec, (unsigned long)now.tv_nsec, (unsigned int)getpid()
+    );
+
+    // Publish the marker atomically, so a crash never leaves a partial one.
+    char marker_path[COMMON_MAX_PATH_LENGTH];
+    char staging_path[COMMON_MAX_PATH_LENGTH];
+    snprintf(marker_path, sizeof(marker_path), "%s/%s.done", checkpoint_dir, name);
+    snprintf(staging_path, sizeof(staging_path), "%s/.%s.done.%d.tmp", checkpoint_dir, name, (int)getpid());
+    FILE *marker_file = fopen(staging_path, "we");
+    if (!marker_file)
+    {
+        return -1;
+    }
+    int write_failed = fprintf(marker_file, "%s\n", out_marker) < 0;
+    if (fclose(marker_file) != 0 || write_failed || rename(staging_path, marker_path) != 0)
+    {
+        unlink(staging_path);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int run_step_invocation(void *argument)
+{
+    const StepInvocation *invocation = (const StepInvocation *)argument;
+    const BuildStep *step = invocation->step;
+
+    // Replay the step's stored layer instead of running it.
+    if (invocation->is_replay)
+    {
+        char layer_path[COMMON_MAX_PATH_LENGTH];
+        if (find_layer(invocation->key, layer_path, sizeof(layer_path)) != 0)
+        {
+            LOG_ERROR("Layer %.12s is no longer stored", invocation->key);
+            return -1;
+        }
+        LOG_INFO("Replaying layer %.12s", invocation->key);
+        return step->replay(invocation->context, layer_path);
+    }
+
+    int result = step->run(invocation->context);
+    if (result != 0)
+    {
+        return result;
+    }
+
+    // Store the step's output for later builds. This never fails the step.
+    if (invocation->key[0] != '\0' && step->record)
+    {
+        char staging_path[COMMON_MAX_PATH_LENGTH];
+        if (begin_layer(invocation->key, staging_path, sizeof(staging_path)) != 0 ||
+            step->record(invocation->context, staging_path) != 0 ||
+            publish_layer(invocation->key, staging_path) != 0)
+        {
+            common.rm_rf(staging_path);
+            LOG_WARNING("Failed to store layer %.12s", invocation->key);
+        }
+        else
+        {
+            LOG_INFO("Stored layer %.12s", invocation->key);
+        }
+    }
+
+    return 0;
+}
+
+static int has_dependencies_in(
+    const int *step_dependencies,
+    const StepState *states,
+    StepState first_state,
+    StepState last_state
+)
+{
+    // Check every dependency is in the given range of states.
+    for (int i = 0; i < SCHEDULER_MAX_ARTIFACTS; i++)
+    {
+        if (step_dependencies[i] < 0)
+        {
+            continue;
+        }
+        StepState state = states[step_dependencies[i]];
+        if (state < first_state || state > last_state)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int run_build_graph(
+    const BuildStep *steps,
+    int step_count,
+    void *context,
+    int max_jobs,
+    const char *log_dir,
+    const char *checkpoint_dir,
+    const char *fingerprint
+)
+{
+    if (step_count <= 0 || step_count > SCHEDULER_MAX_STEPS)
+    {
+        return -1;
+    }
+
+    // Resolve which steps each step waits for.
+    int dependencies[SCHEDULER_MAX_STEPS][SCHEDULER_MAX_ARTIFACTS];
+    if (resolve_dependencies(steps, step_count, dependencies) != 0)
+    {
+        return -1;
+    }
+    int has_dependents[SCHEDULER_MAX_STEPS] = {0};
+    for (int i = 0; i < step_count; i++)
+    {
+        for (int j = 0; j < SCHEDULER_MAX_ARTIFACTS; j++)
+        {
+            if (dependencies[i][j] >= 0)
+            {
+                has_dependents[dependencies[i][j]] = 1;
+            }
+        }
+    }
+
+    // Prepare the executor that runs the steps and multiplexes their logs.
+    static Executor executor;
+    if (init_executor(&executor, log_dir) != 0)
+    {
+        LOG_ERROR("Failed to create log directory %s", log_dir);
+        return -3;
+    }
+    if (checkpoint_dir && common.mkdir_p(checkpoint_dir) != 0)
+    {
+        LOG_ERROR("Failed to create checkpoint directory %s", checkpoint_dir);
+        return -3;
+    }
+
+    StepState states[SCHEDULER_MAX_STEPS] = {0};
+    static StepInvocation invocations[SCHEDULER_MAX_STEPS];
+    static char keys[SCHEDULER_MAX_STEPS][COMMON_SHA256_HEX_LENGTH];
+    static char checkpoint_keys[SCHEDULER_MAX_STEPS][COMMON_SHA256_HEX_LENGTH];
+    static char markers[SCHEDULER_MAX_STEPS][SCHEDULER_CHECKPOINT_MAX_LENGTH];
+    int task_steps[EXECUTOR_MAX_TASKS];
+    int running_count = 0;
+    while (1)
+    {
+        // Decide how to bring about each step whose dependencies are done
+        // or stored: keep what an earlier run left, replay a stored layer,
+        // or run it. Deciding one step can make others decidable.
+        int is_changed = 1;
+        while (is_changed)
+        {
+            is_changed = 0;
+            for (int i = 0; i < step_count; i++)
+            {
+                if (states[i] != STEP_PENDING ||
+                    !has_dependencies_in(dependencies[i], states, STEP_STORED, STEP_DONE))
+                {
+                    continue;
+                }
+                is_changed = 1;
+                invocations[i].step = &steps[i];
+                invocations[i].context = context;
+                invocations[i].is_replay = 0;
+                if (build_layer_key(&steps[i], context, dependencies[i], keys, keys[i]) == -2)
+                {
+                    LOG_WARNING(
+                        "Could not hash the inputs of build step %s, not caching it",
+                        steps[i].name
+                    );
+                }
+                snprintf(invocations[i].key, sizeof(invocations[i].key), "%s", keys[i]);
+
+                // Keep what an earlier run completed with the same inputs.
+                // This needs the dependencies in place, not merely stored.
+                if (checkpoint_dir &&
+                    has_dependencies_in(dependencies[i], states, STEP_DONE, STEP_DONE))
+                {
+                    if (build_checkpoint_key(
+                            fingerprint, &steps[i], dependencies[i],
+                            markers, checkpoint_keys[i]) != 0)
+                    {
+                        LOG_ERROR("Failed to hash the inputs of build step %s", steps[i].name);
+                        stop_executor_tasks(&executor);
+                        return -3;
+                    }
+                    size_t key_length = strlen(checkpoint_keys[i]);
+                    if (read_checkpoint(checkpoint_dir, steps[i].name, markers[i]) == 0 &&
+                        strncmp(markers[i], checkpoint_keys[i], key_length) == 0 &&
+                        markers[i][key_length] == ' ')
+                    {
+                        LOG_INFO("Skipping build step %s, completed by an earlier run", steps[i].name);
+                        states[i] = STEP_DONE;
+                        continue;
+                    }
+                }
+
+                // Defer a step whose layer is stored until something needs
+                // its output in place.
+                char layer_path[COMMON_MAX_PATH_LENGTH];
+                if (keys[i][0] != '\0' && steps[i].replay &&
+                    find_layer(keys[i], layer_path, sizeof(layer_path)) == 0)
+                {
+                    LOG_INFO("Build step %s is stored as layer %.12s", steps[i].name, keys[i]);
+                    states[i] = STEP_STORED;
+                    invocations[i].is_replay = 1;
+                    continue;
+                }
+                states[i] = STEP_QUEUED;
+            }
+        }
+
+        // Replay the stored steps whose output is needed: final outputs,
+        // and the dependencies of steps that run or replay on top of them.
+        is_changed = 1;
+        while (is_changed)
+        {
+            is_changed = 0;
+            for (int i = 0; i < step_count; i++)
+            {
+                if (states[i] == STEP_STORED && !has_dependents[i])
+                {
+                    states[i] = STEP_QUEUED;
+                    is_changed = 1;
+                }
+                if ((states[i] != STEP_QUEUED && states[i] != STEP_RUNNING) ||
+                    (invocations[i].is_replay && steps[i].is_standalone_replay))
+                {
+                    continue;
+                }
+                for (int j = 0; j < SCHEDULER_MAX_ARTIFACTS; j++)
+                {
+                    int dependency = dependencies[i][j];
+                    if (dependency >= 0 && states[dependency] == STEP_STORED)
+                    {
+                        states[dependency] = STEP_QUEUED;
+                        is_changed = 1;
+                    }
+                }
+            }
+        }
+
+        // Finish once every step is done or never needed.
+        int is_finished = 1;
+        for (int i = 0; i < step_count && is_finished; i++)
+        {
+            is_finished = states[i] == STEP_DONE || states[i] == STEP_STORED;
+        }
+        if (is_finished)
+        {
+            return 0;
+        }
+
+        // Start every queued step whose dependencies are in place, up to the
+        // concurrency limit.
+        for (int i = 0; i < step_count && running_count < max_jobs; i++)
+        {
+            int is_standalone = invocations[i].is_replay && steps[i].is_standalone_replay;
+            if (states[i] != STEP_QUEUED ||
+                (!is_standalone && !has_dependencies_in(dependencies[i], states, STEP_DONE, STEP_DONE)))
+            {
+                continue;
+            }
+
+            // Hash the markers of the dependencies now in place, for the
+            // step's own checkpoint.
+            if (checkpoint_dir &&
+                build_checkpoint_key(
+                    fingerprint, &steps[i], dependencies[i],
+                    markers, checkpoint_keys[i]) != 0)
+            {
+                LOG_ERROR("Failed to hash the inputs of build step %s", steps[i].name);
+                stop_executor_tasks(&executor);
+                return -3;
+            }
+
+            // Log replays apart from runs, so a step run after its replay
+            // failed keeps the log of that failure.
+            char log_name[EXECUTOR_NAME_MAX_LENGTH + 8];
+            if (invocations[i].is_replay)
+            {
+                LOG_INFO("Replaying build step %s from layer %.12s", steps[i].name, keys[i]);
+                snprintf(log_name, sizeof(log_name), "%s.replay", steps[i].name);
+            }
+            else
+            {
+                LOG_INFO("Starting build step %s", steps[i].name);
+                snprintf(log_name, sizeof(log_name), "%s", steps[i].name);
+            }
+            int task_index = start_executor_task(
+                &executor, steps[i].name, log_name, run_step_invocation, &invocations[i]
+            );
+            if (task_index < 0)
+            {
+                LOG_ERROR("Failed to start build step %s", steps[i].name);
+                stop_executor_tasks(&executor);
+                return -3;
+            }
+            task_steps[task_index] = i;
+            states[i] = STEP_RUNNING;
+            running_count++;
+        }
+
+        // Stop everything if the build was interrupted.
+        if (common.check_interrupted())
+        {
+            stop_executor_tasks(&executor);
+            return -4;
+        }
+
+        // Forward step output until a step finishes.
+        int task_index = wait_executor_task(&executor, SCHEDULER_POLL_INTERVAL_MS);
+        if (task_index < 0)
+        {
+            continue;
+        }
+        const ExecutorTask *task = &executor.tasks[task_index];
+        int finished = task_steps[task_index];
+        running_count--;
+
+        // Run a step whose layer could not be replayed instead.
+        if (task->exit_status != 0 && invocations[finished].is_replay)
+        {
+            LOG_WARNING(
+                "Failed to replay build step %s, running it instead (replay log: %s)",
+                steps[finished].name, task->log_path
+            );
+            invocations[finished].is_replay = 0;
+            states[finished] = STEP_QUEUED;
+            continue;
+        }
+
+        // Stop the whole graph on the first failure.
+        if (task->exit_status != 0)
+        {
+            LOG_ERROR("Build step %s failed (full log: %s)", steps[finished].name, task->log_path);
+            print_executor_log_tail(&executor, task_index);
+            stop_executor_tasks(&executor);
+            return -2;
+        }
+        states[finished] = STEP_DONE;
+        if (checkpoint_dir &&
+            write_checkpoint(
+                checkpoint_dir, steps[finished].name,
+                checkpoint_keys[finished], markers[finished]) != 0)
+        {
+            LOG_WARNING("Failed to record a checkpoint for build step %s", steps[finished].name);
+        }
+        LOG_INFO(
+            "Finished build step %s in %.1fs (user %.1fs, system %.1fs, peak memory %ld MiB)",
+            steps[finished].name, task->elapsed_seconds,
+            (double)task->usage.ru_utime.tv_sec + (double)task->usage.ru_utime.tv_usec / 1e6,
+            (double)task->usage.ru_stime.tv_sec + (double)task->usage.ru_stime.tv_usec / 1e6,
+            task->usage.ru_maxrss / 1024
+        );
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include "../all.h"
+
+/** The maximum number of artifacts a build step consumes or produces. */
+#define SCHEDULER_MAX_ARTIFACTS 4
+
+/** The maximum number of steps in a build graph. */
+#define SCHEDULER_MAX_STEPS 16
+
+/** The interval between checks on running steps, in milliseconds. */
+#define SCHEDULER_POLL_INTERVAL_MS 100
+
+/** The maximum length of a step's checkpoint marker. */
+#define SCHEDULER_CHECKPOINT_MAX_LENGTH 128
+
+/**
+ * A type representing one step of the build graph.
+ *
+ * A step may start once every artifact it consumes has been produced, and
+ * its artifacts count as produced once it succeeds. Artifact lists are
+ * NULL-terminated names that only need to match between steps.
+ *
+ * The optional hooks make the step's output cacheable in the layer store.
+ * `hash_inputs` feeds everything the step depends on besides the outputs
+ * of other steps into the step's key (its code revision, configuration and
+ * assets); it runs in the scheduler before the step, and may only read the
+ * outputs of dependencies without a `replay` hook. `record` copies the
+ * step's output into a new layer directory after it succeeds, and `replay`
+ * recreates that output from a stored layer instead of running the step.
+ * Replaying needs the outputs of the step's dependencies in place, unless
+ * `is_standalone_replay` is set because the layer holds the whole output.
+ */
+typedef struct BuildStep
+{
+    const char *name;
+    int (*run)(void *context);
+    const char *inputs[SCHEDULER_MAX_ARTIFACTS];
+    const char *outputs[SCHEDULER_MAX_ARTIFACTS];
+    int (*hash_inputs)(void *context, EVP_MD_CTX *digest_context);
+    int (*record)(void *context, const char *layer_path);
+    int (*replay)(void *context, const char *layer_path);
+    int is_standalone_replay;
+} BuildStep;
+
+/**
+ * Runs a build graph, overlapping steps whose inputs are ready.
+ *
+ * Each step runs as an executor task, in its own child process and process
+ * group, so steps share nothing but the filesystem. Their output is tagged
+ * with the step name and logged to `<log_dir>/<step>.log`, or
+ * `<log_dir>/<step>.replay.log` when the step is replayed. A failing step
+ * stops the whole graph: the other running steps and their subprocesses are
+ * terminated, and the tail of the failed step's log is shown.
+ *
+ * Every step gets a key hashing its name, its `hash_inputs` and the keys of
+ * the steps it depends on, so a change reaches everything downstream of it.
+ * Steps with a `record` hook store their output under that key. A step
+ * whose layer is already stored is not run: it is replayed only once its
+ * output is needed, by a step that has to run or because nothing consumes
+ * it, so a build whose every input matches an earlier one only replays the
+ * final steps. A step whose replay fails is run instead.
+ *
+ * With a checkpoint directory, every step that succeeds leaves a marker at
+ * `<checkpoint_dir>/<step>.done` holding a hash of the fingerprint, the step
+ * name and the markers of the steps it depends on. A later run skips every
+ * step whose marker still matches, so it resumes at the step that failed.
+ * A step that runs again gets a fresh marker, which in turn invalidates
+ * every step downstream of it. Steps must tolerate being rerun on top of
+ * what a failed attempt left behind.
+ *
+ * @param steps The steps of the graph.
+ * @param step_count The number of steps.
+ * @param context The value passed to every step.
+ * @param max_jobs The maximum number of steps running at once.
+ * @param log_dir The directory for per-step logs.
+ * @param checkpoint_dir The directory for step markers, or NULL to run every
+ * step.
+ * @param fingerprint The build inputs shared by every step, such as the
+ * version; markers left under a different fingerprint are ignored.
+ *
+ * @return - `0` - Indicates every step succeeded.
+ * @return - `-1` - Indicates the graph is invalid (an input nobody produces,
+ * an artifact produced twice, or a cycle).
+ * @return - `-2` - Indicates a step failed.
+ * @return - `-3` - Indicates a step, the log directory or the checkpoint
+ * directory could not be created.
+ * @return - `-4` - Indicates the build was interrupted.
+ */
+int run_build_graph(
+    const BuildStep *steps,
+    int step_count,
+    void *context,
+    int max_jobs,
+    const char *log_dir,
+    const char *checkpoint_dir,
+    const char *fingerprint
+);
@@ -3,3 +3,11 @@
 
 #include <setjmp.h>
 #include <cmocka.h>
+
+/* src/phases/preparation/resolve.c */
+void feed_releases_parser(ReleasesRequest *request, const char *data, size_t length);
+int finish_releases_parser(const ReleasesParser *parser);
+void read_next_page_link(ReleasesRequest *request, const char *value, size_t value_length);
+size_t read_api_response_header(char *header, size_t size, size_t count, void *userdata);
+int has_next_releases_page(const ReleasesRequest *request);
+int defer_rate_limited_request(ReleasesRequest *request, long http_code, time_t now);
@@ -0,0 +1,105 @@
+/**
+ * This code is responsible for benchmarking the checksum table parser and
+ * lookups against synthetic manifests with thousands of entries.
+ */
+
+#include "../../../all.h"
+
+/** The number of times each manifest is parsed and fully looked up. */
+#define BENCHMARK_ROUNDS 20
+
+/** The maximum length of a synthetic artifact filename. */
+#define BENCHMARK_FILENAME_MAX_LENGTH 64
+
+/** The manifest sizes (in entries) to benchmark. */
+static const size_t BENCHMARK_ENTRY_COUNTS[] = { 1000, 10000, 100000 };
+
+static double get_elapsed_ms(const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1000.0 +
+           (end.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+static char *build_manifest(size_t entry_count, size_t *out_length)
+{
+    // Write one "hash  filename" line per synthetic artifact.
+    char *manifest = NULL;
+    FILE *stream = open_memstream(&manifest, out_length);
+    if (!stream)
+    {
+        return NULL;
+    }
+    for (size_t i = 0; i < entry_count; i++)
+    {
+        fprintf(stream, "%064zx  limeos-artifact-%zu.tar.zst\n", i * 2654435761u, i);
+    }
+    fclose(stream);
+
+    return manifest;
+}
+
+static int run_benchmark(size_t entry_count)
+{
+    // Generate the synthetic manifest.
+    size_t length = 0;
+    char *manifest = build_manifest(entry_count, &length);
+    if (!manifest)
+    {
+        return -1;
+    }
+
+    // Time repeated parses and a lookup of every entry after each.
+    double parse_ms = 0;
+    double lookup_ms = 0;
+    size_t misses = 0;
+    char filename[BENCHMARK_FILENAME_MAX_LENGTH];
+    for (int round = 0; round < BENCHMARK_ROUNDS; round++)
+    {
+        ChecksumTable table = {0};
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (parse_checksum_table(&table, manifest, length) != 0)
+        {
+            free(manifest);
+            return -2;
+        }
+        parse_ms += get_elapsed_ms(&start);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t i = 0; i < entry_count; i++)
+        {
+            snprintf(filename, sizeof(filename), "limeos-artifact-%zu.tar.zst", i);
+            misses += find_checksum_table_entry(&table, filename) == NULL;
+        }
+        lookup_ms += get_elapsed_ms(&start);
+        cleanup_checksum_table(&table);
+    }
+    free(manifest);
+
+    // Report per-round averages.
+    printf(
+        "  %7zu entries (%5.1f MB): parse %8.3f ms, lookup all %8.3f ms (%.0f ns/lookup)\n",
+        entry_count, length / 1e6,
+        parse_ms / BENCHMARK_ROUNDS, lookup_ms / BENCHMARK_ROUNDS,
+        lookup_ms * 1e6 / BENCHMARK_ROUNDS / entry_count
+    );
+
+    return misses == 0 ? 0 : -3;
+}
+
+int main(void)
+{
+    size_t size_count = sizeof(BENCHMARK_ENTRY_COUNTS) / sizeof(BENCHMARK_ENTRY_COUNTS[0]);
+    for (size_t i = 0; i < size_count; i++)
+    {
+        if (run_benchmark(BENCHMARK_ENTRY_COUNTS[i]) != 0)
+        {
+            fprintf(stderr, "Benchmark failed for %zu entries\n", BENCHMARK_ENTRY_COUNTS[i]);
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,248 @@
+/**
+ * This code is responsible for benchmarking the ext4 image payload against
+ * the tarball on a synthetic rootfs: the size each ships, and the time the
+ * installer spends extracting the tarball versus block-copying the image to
+ * a partition, giving it a fresh UUID and growing it to fit.
+ */
+
+#include "../../../all.h"
+
+/** The number of files in the synthetic rootfs. */
+#define BENCHMARK_FILE_COUNT 2000
+
+/** The size of each synthetic file. */
+#define BENCHMARK_FILE_SIZE (16 * 1024)
+
+/** The size of the partition the image is copied to. */
+#define BENCHMARK_PARTITION_SIZE (1024LL * 1024 * 1024)
+
+/** The buffer size of the block copy. */
+#define BENCHMARK_COPY_BUFFER_SIZE (4 * 1024 * 1024)
+
+/** The tarball compressions to compare the image with. */
+static const TarballCompression BENCHMARK_COMPRESSIONS[] = {
+    TARBALL_COMPRESSION_ZSTD,
+    TARBALL_COMPRESSION_NONE
+};
+
+/** The benchmark's working directory. */
+static char work_dir[256];
+
+static double get_elapsed_ms(const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1000.0 +
+           (end.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+static double get_file_mb(const char *path)
+{
+    struct stat file_stat;
+    if (stat(path, &file_stat) != 0)
+    {
+        return 0;
+    }
+    return file_stat.st_size / 1e6;
+}
+
+static int build_synthetic_rootfs(const char *rootfs_path)
+{
+    // Spread many small, partly compressible files over a few directories,
+    // like a rootfs.
+    char buffer[BENCHMARK_FILE_SIZE];
+    unsigned int seed = 1;
+    for (int i = 0; i < BENCHMARK_FILE_COUNT; i++)
+    {
+        char directory_path[512];
+        char file_path[600];
+        snprintf(directory_path, sizeof(directory_path), "%s/dir-%d", rootfs_path, i % 20);
+        snprintf(file_path, sizeof(file_path), "%s/file-%d", directory_path, i);
+        if (common.mkdir_p(directory_path) != 0)
+        {
+            return -1;
+        }
+        for (size_t j = 0; j < sizeof(buffer); j++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            buffer[j] = (seed >> 16) % 3 == 0 ? (char)(seed >> 8) : 'a';
+        }
+        FILE *file = fopen(file_path, "wb");
+        if (!file)
+        {
+            return -1;
+        }
+        size_t written = fwrite(buffer, 1, sizeof(buffer), file);
+        if (fclose(file) != 0 || written != sizeof(buffer))
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int copy_image(const char *image_path, const char *partition_path)
+{
+    int input_fd = open(image_path, O_RDONLY | O_CLOEXEC);
+    if (input_fd < 0)
+    {
+        return -1;
+    }
+    int output_fd = open(partition_path, O_WRONLY | O_CLOEXEC);
+    if (output_fd < 0)
+    {
+        close(input_fd);
+        return -1;
+    }
+
+    // Copy every block, as the installer does onto a partition.
+    char *buffer = malloc(BENCHMARK_COPY_BUFFER_SIZE);
+    int result = buffer ? 0 : -1;
+    ssize_t bytes;
+    while (result == 0 && (bytes = read(input_fd, buffer, BENCHMARK_COPY_BUFFER_SIZE)) > 0)
+    {
+        if (write(output_fd, buffer, (size_t)bytes) != bytes)
+        {
+            result = -1;
+        }
+    }
+    if (bytes < 0 || fsync(output_fd) != 0)
+    {
+        result = -1;
+    }
+
+    free(buffer);
+    close(input_fd);
+    close(output_fd);
+    return result;
+}
+
+static int run_tarball_benchmark(const char *rootfs_path, TarballCompression compression)
+{
+    const char *name = get_tarball_compression_name(compression);
+
+    // Package the tarball.
+    char tarball_path[600];
+    snprintf(tarball_path, sizeof(tarball_path), "%s/rootfs-%s.tar", work_dir, name);
+    if (package_target_rootfs(rootfs_path, tarball_path, compression, time(NULL)) != 0)
+    {
+        return -1;
+    }
+
+    // Extract it as the installer does, flushing it to disk.
+    char extract_dir[512];
+    char command[2048];
+    snprintf(extract_dir, sizeof(extract_dir), "%s/extract-%s", work_dir, name);
+    if (common.mkdir_p(extract_dir) != 0)
+    {
+        return -1;
+    }
+    snprintf(command, sizeof(command), "tar -xf %s -C %s && sync", tarball_path, extract_dir);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (system(command) != 0)
+    {
+        return -2;
+    }
+    double extract_ms = get_elapsed_ms(&start);
+
+    printf(
+        "  tar (%-4s): payload %6.1f MB, extract %8.1f ms\n",
+        name, get_file_mb(tarball_path), extract_ms
+    );
+
+    return 0;
+}
+
+static int run_image_benchmark(const char *rootfs_path)
+{
+    // Package the image.
+    char image_path[512];
+    char manifest_path[512];
+    snprintf(image_path, sizeof(image_path), "%s/rootfs.img", work_dir);
+    snprintf(manifest_path, sizeof(manifest_path), "%s/rootfs.manifest", work_dir);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (image_target_rootfs(rootfs_path, image_path, manifest_path, time(NULL)) != 0)
+    {
+        return -1;
+    }
+    double package_ms = get_elapsed_ms(&start);
+
+    // Stand in for the partition with a file of its size.
+    char partition_path[512];
+    snprintf(partition_path, sizeof(partition_path), "%s/partition.img", work_dir);
+    int fd = open(partition_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0 || ftruncate(fd, BENCHMARK_PARTITION_SIZE) != 0)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+    close(fd);
+
+    // Block-copy the image, give it a fresh UUID as the manifest asks, and
+    // grow the filesystem to fill the partition.
+    char command[2048];
+    snprintf(
+        command, sizeof(command), "tune2fs -U random %s >/dev/null 2>&1 && resize2fs %s >/dev/null 2>&1",
+        partition_path, partition_path
+    );
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (copy_image(image_path, partition_path) != 0)
+    {
+        return -2;
+    }
+    double copy_ms = get_elapsed_ms(&start);
+    if (system(command) != 0)
+    {
+        return -3;
+    }
+    double install_ms = get_elapsed_ms(&start);
+
+    printf(
+        "  ext4      : payload %6.1f MB, package %8.1f ms, copy %8.1f ms + uuid and grow = %8.1f ms\n",
+        get_file_mb(image_path), package_ms, copy_ms, install_ms
+    );
+
+    return 0;
+}
+
+int main(void)
+{
+    // Create the synthetic rootfs.
+    snprintf(work_dir, sizeof(work_dir), "/tmp/iso-builder-bench-image-%d", getpid());
+    char rootfs_path[512];
+    snprintf(rootfs_path, sizeof(rootfs_path), "%s/rootfs", work_dir);
+    if (build_synthetic_rootfs(rootfs_path) != 0)
+    {
+        fprintf(stderr, "Failed to create the synthetic rootfs\n");
+        common.rm_rf(work_dir);
+        return 1;
+    }
+
+    int exit_code = 0;
+    size_t compression_count = sizeof(BENCHMARK_COMPRESSIONS) / sizeof(BENCHMARK_COMPRESSIONS[0]);
+    for (size_t i = 0; i < compression_count; i++)
+    {
+        if (run_tarball_benchmark(rootfs_path, BENCHMARK_COMPRESSIONS[i]) != 0)
+        {
+            fprintf(
+                stderr, "Benchmark failed for %s\n",
+                get_tarball_compression_name(BENCHMARK_COMPRESSIONS[i])
+            );
+            exit_code = 1;
+            break;
+        }
+    }
+    if (exit_code == 0 && run_image_benchmark(rootfs_path) != 0)
+    {
+        fprintf(stderr, "Benchmark failed for ext4\n");
+        exit_code = 1;
+    }
+
+    common.rm_rf(work_dir);
+    return exit_code;
+}
@@ -0,0 +1,218 @@
+/**
+ * This code is responsible for benchmarking the target tarball compressions
+ * against a synthetic rootfs: the time to package the tarball and to build
+ * the squashfs around it, the size each adds to the ISO, and the time to
+ * extract the tarball again.
+ */
+
+#include "../../../all.h"
+
+/** The number of files of each kind in the synthetic rootfs. */
+#define BENCHMARK_FILES_PER_KIND 200
+
+/** The size of each synthetic file. */
+#define BENCHMARK_FILE_SIZE (64 * 1024)
+
+/** The squashfs compression the assembly phase uses. */
+#define BENCHMARK_SQUASHFS_COMPRESSION "xz"
+
+/** The compressions to benchmark. */
+static const TarballCompression BENCHMARK_COMPRESSIONS[] = {
+    TARBALL_COMPRESSION_GZIP,
+    TARBALL_COMPRESSION_ZSTD,
+    TARBALL_COMPRESSION_NONE
+};
+
+/** The benchmark's working directory. */
+static char work_dir[256];
+
+static double get_elapsed_ms(const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1000.0 +
+           (end.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+static double get_file_mb(const char *path)
+{
+    struct stat file_stat;
+    if (stat(path, &file_stat) != 0)
+    {
+        return 0;
+    }
+    return file_stat.st_size / 1e6;
+}
+
+static int write_synthetic_file(const char *path, int kind, unsigned int seed)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file)
+    {
+        return -1;
+    }
+
+    // Mimic text (compressible), already compressed data (incompressible)
+    // and binaries (partly compressible).
+    static const char *const WORDS[] = { "limeos ", "install ", "package ", "config\n" };
+    for (size_t i = 0; i < BENCHMARK_FILE_SIZE; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        int byte;
+        if (kind == 0)
+        {
+            const char *word = WORDS[(seed >> 16) % 4];
+            byte = word[i % strlen(word)];
+        }
+        else if (kind == 1)
+        {
+            byte = (int)(seed >> 16) & 0xff;
+        }
+        else
+        {
+            byte = (seed >> 16) % 3 == 0 ? (int)(seed >> 8) & 0xff : 0;
+        }
+        fputc(byte, file);
+    }
+
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+static int build_synthetic_rootfs(const char *rootfs_path)
+{
+    for (int kind = 0; kind < 3; kind++)
+    {
+        char directory_path[512];
+        snprintf(directory_path, sizeof(directory_path), "%s/kind-%d", rootfs_path, kind);
+        if (common.mkdir_p(directory_path) != 0)
+        {
+            return -1;
+        }
+        for (int i = 0; i < BENCHMARK_FILES_PER_KIND; i++)
+        {
+            char file_path[600];
+            snprintf(file_path, sizeof(file_path), "%s/file-%d", directory_path, i);
+            if (write_synthetic_file(file_path, kind, (unsigned int)(kind * 100003 + i)) != 0)
+            {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int run_benchmark(const char *rootfs_path, TarballCompression compression, int has_squashfs)
+{
+    const char *name = get_tarball_compression_name(compression);
+
+    // Package the rootfs into a directory standing in for the live rootfs.
+    char live_dir[512];
+    char payload_path[600];
+    snprintf(live_dir, sizeof(live_dir), "%s/live-%s", work_dir, name);
+    snprintf(
+        payload_path, sizeof(payload_path), "%s/rootfs.tar%s",
+        live_dir, get_tarball_compression_extension(compression)
+    );
+    if (common.mkdir_p(live_dir) != 0)
+    {
+        return -1;
+    }
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (package_target_rootfs(rootfs_path, payload_path, compression, time(NULL)) != 0)
+    {
+        return -2;
+    }
+    double package_ms = get_elapsed_ms(&start);
+
+    // Build the squashfs around it, as the assembly phase does.
+    char squashfs_path[600];
+    char command[2048];
+    double squashfs_ms = 0;
+    snprintf(squashfs_path, sizeof(squashfs_path), "%s/live-%s.squashfs", work_dir, name);
+    if (has_squashfs)
+    {
+        snprintf(
+            command, sizeof(command),
+            "mksquashfs %s %s -comp " BENCHMARK_SQUASHFS_COMPRESSION " -noappend -no-progress >/dev/null",
+            live_dir, squashfs_path
+        );
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (system(command) != 0)
+        {
+            return -3;
+        }
+        squashfs_ms = get_elapsed_ms(&start);
+    }
+
+    // Extract the tarball, letting tar detect its compression.
+    char extract_dir[512];
+    snprintf(extract_dir, sizeof(extract_dir), "%s/extract-%s", work_dir, name);
+    if (common.mkdir_p(extract_dir) != 0)
+    {
+        return -1;
+    }
+    snprintf(command, sizeof(command), "tar -xf %s -C %s", payload_path, extract_dir);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (system(command) != 0)
+    {
+        return -4;
+    }
+    double extract_ms = get_elapsed_ms(&start);
+
+    // Report the build time, the size the ISO carries and the extraction.
+    if (has_squashfs)
+    {
+        printf(
+            "  %-4s: package %8.1f ms + squashfs %8.1f ms, tarball %6.1f MB, squashfs %6.1f MB, extract %8.1f ms\n",
+            name, package_ms, squashfs_ms, get_file_mb(payload_path), get_file_mb(squashfs_path), extract_ms
+        );
+    }
+    else
+    {
+        printf(
+            "  %-4s: package %8.1f ms, tarball %6.1f MB, extract %8.1f ms\n",
+            name, package_ms, get_file_mb(payload_path), extract_ms
+        );
+    }
+
+    return 0;
+}
+
+int main(void)
+{
+    // Create the synthetic rootfs.
+    snprintf(work_dir, sizeof(work_dir), "/tmp/iso-builder-bench-package-%d", getpid());
+    char rootfs_path[512];
+    snprintf(rootfs_path, sizeof(rootfs_path), "%s/rootfs", work_dir);
+    if (build_synthetic_rootfs(rootfs_path) != 0)
+    {
+        fprintf(stderr, "Failed to create the synthetic rootfs\n");
+        common.rm_rf(work_dir);
+        return 1;
+    }
+
+    int has_squashfs = common.is_command_available("mksquashfs");
+    if (!has_squashfs)
+    {
+        printf("  mksquashfs is not installed, leaving out the squashfs\n");
+    }
+
+    int exit_code = 0;
+    size_t compression_count = sizeof(BENCHMARK_COMPRESSIONS) / sizeof(BENCHMARK_COMPRESSIONS[0]);
+    for (size_t i = 0; i < compression_count; i++)
+    {
+        if (run_benchmark(rootfs_path, BENCHMARK_COMPRESSIONS[i], has_squashfs) != 0)
+        {
+            fprintf(
+                stderr, "Benchmark failed for %s\n",
+                get_tarball_compression_name(BENCHMARK_COMPRESSIONS[i])
+            );
+            exit_code = 1;
+            break;
+        }
+    }
+
+    common.rm_rf(work_dir);
+    return exit_code;
+}
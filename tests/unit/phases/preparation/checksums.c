@@ -0,0 +1,84 @@
+/**
+ * This code is responsible for testing the checksum table functions.
+ */
+
+#include "../../../all.h"
+
+/** A valid SHA-256 hex digest used across tests. */
+#define TEST_HASH_A "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+
+/** A second valid SHA-256 hex digest used across tests. */
+#define TEST_HASH_B "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb"
+
+/** Verifies parse_checksum_table() indexes both sha256sum line formats. */
+static void test_parse_checksum_table_formats(void **state)
+{
+    (void)state;
+
+    // Parse a manifest with text and binary mode lines.
+    const char *manifest =
+        TEST_HASH_A "  window-manager\n"
+        TEST_HASH_B " *display-manager\r\n";
+    ChecksumTable table = {0};
+    assert_int_equal(0, parse_checksum_table(&table, manifest, strlen(manifest)));
+
+    // Verify both entries resolve to their hashes.
+    assert_string_equal(TEST_HASH_A, find_checksum_table_entry(&table, "window-manager"));
+    assert_string_equal(TEST_HASH_B, find_checksum_table_entry(&table, "display-manager"));
+    assert_null(find_checksum_table_entry(&table, "installation-wizard"));
+
+    cleanup_checksum_table(&table);
+}
+
+/** Verifies parse_checksum_table() skips malformed lines and duplicates. */
+static void test_parse_checksum_table_skips_invalid(void **state)
+{
+    (void)state;
+
+    // Parse a manifest with a short hash, a non-hex hash, and a duplicate.
+    const char *manifest =
+        "abc  short-hash\n"
+        "zzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzz  not-hex\n"
+        "\n"
+        TEST_HASH_A "  duplicate\n"
+        TEST_HASH_B "  duplicate\n";
+    ChecksumTable table = {0};
+    assert_int_equal(0, parse_checksum_table(&table, manifest, strlen(manifest)));
+
+    // Verify only the first duplicate entry was indexed.
+    assert_int_equal(1, (int)table.entry_count);
+    assert_null(find_checksum_table_entry(&table, "short-hash"));
+    assert_null(find_checksum_table_entry(&table, "not-hex"));
+    assert_string_equal(TEST_HASH_A, find_checksum_table_entry(&table, "duplicate"));
+
+    cleanup_checksum_table(&table);
+}
+
+/** Verifies acquire_release_checksums() shares one table per release. */
+static void test_acquire_release_checksums_shares_tables(void **state)
+{
+    (void)state;
+
+    // Acquire tables for two releases, one of them twice.
+    ChecksumTable *first = acquire_release_checksums("window-manager", "v1.0.0");
+    ChecksumTable *second = acquire_release_checksums("window-manager", "v1.0.0");
+    ChecksumTable *other = acquire_release_checksums("window-manager", "v1.1.0");
+
+    // Verify the same release maps to the same table.
+    assert_non_null(first);
+    assert_true(first == second);
+    assert_true(first != other);
+
+    clear_release_checksums();
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_parse_checksum_table_formats),
+        cmocka_unit_test(test_parse_checksum_table_skips_invalid),
+        cmocka_unit_test(test_acquire_release_checksums_shares_tables),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,70 @@
+/**
+ * This code is responsible for testing the component lockfile functions.
+ */
+
+#include "../../../all.h"
+
+/** A valid SHA-256 hex digest used across tests. */
+#define TEST_HASH_A "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+
+/** A valid uppercase SHA-256 hex digest used across tests. */
+#define TEST_HASH_B "BBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBB"
+
+/** The path of the lockfile written by the tests. */
+#define TEST_LOCK_PATH "/tmp/limeos-iso-builder-test.lock"
+
+/** Verifies a saved lockfile loads back the recorded components. */
+static void test_component_locks_round_trip(void **state)
+{
+    (void)state;
+
+    // Record two components and save them.
+    assert_int_equal(0, record_component_lock("window-manager", "v1.2.0", TEST_HASH_A));
+    assert_int_equal(0, record_component_lock("display-manager", "v2.0.1", TEST_HASH_B));
+    assert_int_equal(0, save_component_locks(TEST_LOCK_PATH));
+    clear_component_locks();
+
+    // Load the lockfile and verify both components are pinned.
+    assert_int_equal(0, load_component_locks(TEST_LOCK_PATH));
+    const ComponentLock *lock = find_component_lock("display-manager");
+    assert_non_null(lock);
+    assert_string_equal("v2.0.1", lock->version);
+    assert_string_equal(
+        "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb",
+        lock->sha256
+    );
+    assert_non_null(find_component_lock("window-manager"));
+    assert_null(find_component_lock("installation-wizard"));
+
+    clear_component_locks();
+    unlink(TEST_LOCK_PATH);
+}
+
+/** Verifies load_component_locks() rejects malformed lines. */
+static void test_load_component_locks_rejects_malformed(void **state)
+{
+    (void)state;
+
+    // Write a lockfile whose second entry has a truncated hash.
+    FILE *file = fopen(TEST_LOCK_PATH, "w");
+    assert_non_null(file);
+    fprintf(file, "# comment\n\nwindow-manager v1.2.0 " TEST_HASH_A "\n");
+    fprintf(file, "display-manager v2.0.1 abc\n");
+    fclose(file);
+
+    // Verify the lockfile is rejected.
+    assert_int_equal(-2, load_component_locks(TEST_LOCK_PATH));
+
+    clear_component_locks();
+    unlink(TEST_LOCK_PATH);
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_component_locks_round_trip),
+        cmocka_unit_test(test_load_component_locks_rejects_malformed),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
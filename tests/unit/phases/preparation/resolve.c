@@ -0,0 +1,303 @@
+/**
+ * This code is responsible for testing the releases listing parser and API
+ * response handling.
+ */
+
+#include "../../../all.h"
+
+/** A releases page whose fields are interleaved with nested assets. */
+#define TEST_RELEASES_PAGE \
+    "[\n" \
+    "  {\"id\": 3, \"tag_name\": \"v2.0.0\", \"draft\": false,\n" \
+    "   \"assets\": [{\"name\": \"window-manager\", \"tag_name\": \"v9.0.0\"}],\n" \
+    "   \"prerelease\": false},\n" \
+    "  {\"id\": 2, \"tag_name\": \"v1.4.0\", \"prerelease\": true},\n" \
+    "  {\"id\": 1, \"tag_name\": \"v1.3.2\", \"assets\": [], \"draft\": false}\n" \
+    "]\n"
+
+/** Returns an empty request for a target major version. */
+static ReleasesRequest *create_test_request(int target_major)
+{
+    ReleasesRequest *request = calloc(1, sizeof(*request));
+    assert_non_null(request);
+    request->target_major = target_major;
+    request->parser.last_major = -1;
+    return request;
+}
+
+/** Returns the tag found for a major version, or NULL. */
+static const char *find_candidate_tag(const ReleasesRequest *request, int major)
+{
+    for (int i = 0; i < request->candidate_count; i++)
+    {
+        if (request->candidates[i].major == major)
+        {
+            return request->candidates[i].tag;
+        }
+    }
+    return NULL;
+}
+
+/** Feeds a whole listing to the parser and returns its result. */
+static int parse_test_listing(ReleasesRequest *request, const char *listing)
+{
+    feed_releases_parser(request, listing, strlen(listing));
+    return finish_releases_parser(&request->parser);
+}
+
+/** Reads a Link header value into the request. */
+static void read_test_link(ReleasesRequest *request, const char *value)
+{
+    read_next_page_link(request, value, strlen(value));
+}
+
+/** Verifies a page split at every byte parses like the whole page. */
+static void test_feed_releases_parser_split_chunks(void **state)
+{
+    (void)state;
+
+    const char *page = TEST_RELEASES_PAGE;
+    size_t length = strlen(page);
+    for (size_t split = 0; split <= length; split++)
+    {
+        // Feed the page in two chunks, splitting keys, tags and assets.
+        ReleasesRequest *request = create_test_request(1);
+        feed_releases_parser(request, page, split);
+        feed_releases_parser(request, page + split, length - split);
+        assert_int_equal(0, finish_releases_parser(&request->parser));
+
+        // Verify only the stable release tags were taken, ignoring the
+        // prerelease and the asset's nested field.
+        assert_int_equal(2, request->candidate_count);
+        assert_string_equal("v2.0.0", find_candidate_tag(request, 2));
+        assert_string_equal("v1.3.2", find_candidate_tag(request, 1));
+        assert_int_equal(1, request->parser.last_major);
+        free(request);
+    }
+
+    // Verify feeding one byte at a time gives the same result.
+    ReleasesRequest *request = create_test_request(1);
+    for (size_t i = 0; i < length; i++)
+    {
+        feed_releases_parser(request, page + i, 1);
+    }
+    assert_int_equal(0, finish_releases_parser(&request->parser));
+    assert_int_equal(2, request->candidate_count);
+    free(request);
+}
+
+/** Verifies escaped characters never end a string or inject a tag. */
+static void test_feed_releases_parser_escaped_strings(void **state)
+{
+    (void)state;
+
+    // Parse a release whose body quotes another release's fields, split
+    // right after an escaping backslash.
+    const char *first =
+        "[{\"body\": \"see \\\"tag_name\\\": \\\"v3.0.0\\\", \\\\ and \\";
+    const char *second =
+        "\"}\", \"tag_name\": \"v1.0.1\", \"name\": \"a \\\"quoted\\\" name\"}]";
+    ReleasesRequest *request = create_test_request(1);
+    feed_releases_parser(request, first, strlen(first));
+    feed_releases_parser(request, second, strlen(second));
+    assert_int_equal(0, finish_releases_parser(&request->parser));
+
+    // Verify only the real tag was taken.
+    assert_int_equal(1, request->candidate_count);
+    assert_string_equal("v1.0.1", find_candidate_tag(request, 1));
+    assert_null(find_candidate_tag(request, 3));
+    free(request);
+}
+
+/** Verifies empty, non-array and truncated listings. */
+static void test_feed_releases_parser_listing_shapes(void **state)
+{
+    (void)state;
+
+    // Verify an empty array parses to no candidates.
+    ReleasesRequest *request = create_test_request(1);
+    assert_int_equal(0, parse_test_listing(request, " [ ]\n"));
+    assert_int_equal(0, request->candidate_count);
+    assert_int_equal(-1, request->parser.last_major);
+    free(request);
+
+    // Verify an object instead of an array is an unexpected format.
+    request = create_test_request(1);
+    assert_int_equal(-4, parse_test_listing(request, "{\"message\": \"Not Found\"}"));
+    free(request);
+
+    // Verify a listing cut off mid-release is a parse failure.
+    request = create_test_request(1);
+    assert_int_equal(-3, parse_test_listing(request, "[{\"tag_name\": \"v1.0.0\""));
+    free(request);
+
+    // Verify content after the array is a parse failure.
+    request = create_test_request(1);
+    assert_int_equal(-3, parse_test_listing(request, "[] []"));
+    free(request);
+}
+
+/** Verifies read_next_page_link() takes only the next page's URL. */
+static void test_read_next_page_link(void **state)
+{
+    (void)state;
+
+    // Verify the next page is found among the other relations.
+    ReleasesRequest *request = create_test_request(1);
+    read_test_link(
+        request,
+        "<https://api.github.com/repositories/1/releases?page=1>; rel=\"prev\", "
+        "<https://api.github.com/repositories/1/releases?page=3>; rel=\"next\", "
+        "<https://api.github.com/repositories/1/releases?page=9>; rel=\"last\""
+    );
+    assert_string_equal(
+        "https://api.github.com/repositories/1/releases?page=3", request->next_url
+    );
+    free(request);
+
+    // Verify headers without a next page, or too malformed to read, leave
+    // the listing finished.
+    const char *links[] = {
+        "",
+        "<https://api.github.com/repositories/1/releases?page=1>; rel=\"prev\"",
+        "<https://api.github.com/repositories/1/releases?page=3; rel=\"next\"",
+        "https://api.github.com/repositories/1/releases?page=3>; rel=\"next\"",
+        "<https://api.github.com/repositories/1/releases?page=3>; rel=next",
+    };
+    for (size_t i = 0; i < sizeof(links) / sizeof(links[0]); i++)
+    {
+        request = create_test_request(1);
+        read_test_link(request, links[i]);
+        assert_string_equal("", request->next_url);
+        assert_int_equal(0, has_next_releases_page(request));
+        free(request);
+    }
+}
+
+/** Verifies the listing is followed while a page ends in the target major. */
+static void test_has_next_releases_page(void **state)
+{
+    (void)state;
+
+    const char *link = "<https://api.github.com/repositories/1/releases?page=2>; rel=\"next\"";
+
+    // Verify a page without the target major asks for the next.
+    ReleasesRequest *request = create_test_request(1);
+    assert_int_equal(0, parse_test_listing(request, "[{\"tag_name\": \"v2.1.0\"}]"));
+    read_test_link(request, link);
+    assert_int_equal(1, has_next_releases_page(request));
+    free(request);
+
+    // Verify a page ending inside the target major asks for the next, even
+    // when that last release is a prerelease.
+    request = create_test_request(1);
+    assert_int_equal(0, parse_test_listing(
+        request,
+        "[{\"tag_name\": \"v2.1.0\"}, {\"tag_name\": \"v1.2.0\"}, "
+        "{\"tag_name\": \"v1.3.0-rc1\", \"prerelease\": true}]"
+    ));
+    read_test_link(request, link);
+    assert_int_equal(1, has_next_releases_page(request));
+    free(request);
+
+    // Verify a page ending past the target major settles it.
+    request = create_test_request(1);
+    assert_int_equal(0, parse_test_listing(
+        request, "[{\"tag_name\": \"v1.2.0\"}, {\"tag_name\": \"v0.9.0\"}]"
+    ));
+    read_test_link(request, link);
+    assert_int_equal(0, has_next_releases_page(request));
+    free(request);
+
+    // Verify the last page settles the listing even inside the target major.
+    request = create_test_request(1);
+    assert_int_equal(0, parse_test_listing(request, "[{\"tag_name\": \"v1.2.0\"}]"));
+    assert_int_equal(0, has_next_releases_page(request));
+    free(request);
+}
+
+/** Feeds one response header line to read_api_response_header(). */
+static void feed_header(ReleasesRequest *request, const char *line)
+{
+    char header[512];
+    snprintf(header, sizeof(header), "%s", line);
+    size_t length = strlen(header);
+    assert_int_equal(length, read_api_response_header(header, 1, length, request));
+}
+
+/** Feeds the headers of a rate-limited refusal that resets at a given time. */
+static void feed_refusal_headers(ReleasesRequest *request, long reset)
+{
+    char reset_header[64];
+    snprintf(reset_header, sizeof(reset_header), "X-RateLimit-Reset: %ld\r\n", reset);
+    feed_header(request, "HTTP/2 403\r\n");
+    feed_header(request, "x-ratelimit-remaining: 0\r\n");
+    feed_header(request, reset_header);
+}
+
+/** Verifies a refusal that reports a soon reset is retried after it. */
+static void test_defer_rate_limited_request_waits_for_reset(void **state)
+{
+    (void)state;
+
+    // Read a refusal whose rate limit resets in half a minute.
+    ReleasesRequest request = {0};
+    time_t now = 1700000000;
+    feed_refusal_headers(&request, (long)now + 30);
+
+    // Verify the request is deferred until just after the reset.
+    assert_int_equal(2, defer_rate_limited_request(&request, 403, now));
+    assert_int_equal(now + 31, request.retry_at);
+}
+
+/** Verifies a refusal that reports a distant reset fails clearly. */
+static void test_defer_rate_limited_request_fails_distant_reset(void **state)
+{
+    (void)state;
+
+    // Read a secondary-limit refusal whose rate limit resets in an hour.
+    ReleasesRequest request = {0};
+    time_t now = 1700000000;
+    feed_refusal_headers(&request, (long)now + 3600);
+
+    // Verify the request fails instead of being retried.
+    assert_int_equal(-6, defer_rate_limited_request(&request, 429, now));
+    assert_int_equal(0, request.retry_at);
+}
+
+/** Verifies refusals with quota left are not taken for rate limits. */
+static void test_defer_rate_limited_request_ignores_other_refusals(void **state)
+{
+    (void)state;
+
+    // Read a refusal that still reports remaining requests.
+    ReleasesRequest request = {0};
+    time_t now = 1700000000;
+    feed_header(&request, "HTTP/2 403\r\n");
+    feed_header(&request, "X-RateLimit-Remaining: 12\r\n");
+    feed_header(&request, "X-RateLimit-Reset: 1700000030\r\n");
+    assert_int_equal(0, defer_rate_limited_request(&request, 403, now));
+
+    // Verify the next response of a redirect chain forgets what an earlier
+    // one reported.
+    feed_refusal_headers(&request, (long)now + 30);
+    feed_header(&request, "HTTP/2 403\r\n");
+    assert_int_equal(0, defer_rate_limited_request(&request, 403, now));
+    assert_int_equal(0, request.retry_at);
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_feed_releases_parser_split_chunks),
+        cmocka_unit_test(test_feed_releases_parser_escaped_strings),
+        cmocka_unit_test(test_feed_releases_parser_listing_shapes),
+        cmocka_unit_test(test_read_next_page_link),
+        cmocka_unit_test(test_has_next_releases_page),
+        cmocka_unit_test(test_defer_rate_limited_request_waits_for_reset),
+        cmocka_unit_test(test_defer_rate_limited_request_fails_distant_reset),
+        cmocka_unit_test(test_defer_rate_limited_request_ignores_other_refusals),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,154 @@
+/**
+ * This code is responsible for testing the tree archive writer.
+ */
+
+#include "../../all.h"
+
+/** The latest mtime archive tests store. */
+#define TEST_MAX_MTIME 1704067200
+
+/** Test directory path for archive tests. */
+static char test_dir[256];
+
+/** Sets up the test environment before each test. */
+static int setup(void **state)
+{
+    (void)state;
+
+    // Create a unique test directory.
+    snprintf(
+        test_dir, sizeof(test_dir),
+        "/tmp/iso-builder-test-archive-%d",
+        getpid()
+    );
+    common.mkdir_p(test_dir);
+
+    return 0;
+}
+
+/** Cleans up the test environment after each test. */
+static int teardown(void **state)
+{
+    (void)state;
+
+    // Remove the test directory.
+    common.rm_rf(test_dir);
+    return 0;
+}
+
+/** Verifies write_tree_archive() output extracts back to the same tree. */
+static void test_write_tree_archive_round_trip(void **state)
+{
+    (void)state;
+
+    // Build a tree with a nested file and a hardlink to it.
+    char tree_dir[512];
+    char file_path[512];
+    char link_path[512];
+    snprintf(tree_dir, sizeof(tree_dir), "%s/tree/etc", test_dir);
+    snprintf(file_path, sizeof(file_path), "%s/hostname", tree_dir);
+    snprintf(link_path, sizeof(link_path), "%s/tree/hostname", test_dir);
+    assert_int_equal(0, common.mkdir_p(tree_dir));
+    assert_int_equal(0, common.write_file(file_path, "limeos"));
+    assert_int_equal(0, link(file_path, link_path));
+
+    // Archive the tree and extract it with tar.
+    char tree_path[512];
+    char archive_path[512];
+    char extract_dir[512];
+    snprintf(tree_path, sizeof(tree_path), "%s/tree", test_dir);
+    snprintf(archive_path, sizeof(archive_path), "%s/tree.tar", test_dir);
+    snprintf(extract_dir, sizeof(extract_dir), "%s/extracted", test_dir);
+    assert_int_equal(0, write_tree_archive(tree_path, NULL, archive_path, TEST_MAX_MTIME));
+    assert_int_equal(0, common.mkdir_p(extract_dir));
+    char command[1024];
+    snprintf(command, sizeof(command), "tar -xf %s -C %s", archive_path, extract_dir);
+    assert_int_equal(0, system(command));
+
+    // Read the extracted file back and verify its contents.
+    char extracted_path[512];
+    snprintf(extracted_path, sizeof(extracted_path), "%s/etc/hostname", extract_dir);
+    FILE *f = fopen(extracted_path, "r");
+    assert_non_null(f);
+    char content[16];
+    size_t bytes = fread(content, 1, sizeof(content) - 1, f);
+    content[bytes] = '\0';
+    fclose(f);
+    assert_string_equal("limeos", content);
+
+    // Verify the hardlink was kept.
+    struct stat extracted_stat;
+    assert_int_equal(0, stat(extracted_path, &extracted_stat));
+    assert_int_equal(2, extracted_stat.st_nlink);
+}
+
+/** Verifies write_tree_archive() clamps mtimes, giving the same archive. */
+static void test_write_tree_archive_reproducible(void **state)
+{
+    (void)state;
+
+    // Build a tree with a file newer than the latest mtime.
+    char tree_path[512];
+    char file_path[512];
+    snprintf(tree_path, sizeof(tree_path), "%s/tree", test_dir);
+    snprintf(file_path, sizeof(file_path), "%s/hostname", tree_path);
+    assert_int_equal(0, common.mkdir_p(tree_path));
+    assert_int_equal(0, common.write_file(file_path, "limeos"));
+
+    // Archive the tree, touch the file, and archive it again.
+    char first_path[512];
+    char second_path[512];
+    snprintf(first_path, sizeof(first_path), "%s/first.tar", test_dir);
+    snprintf(second_path, sizeof(second_path), "%s/second.tar", test_dir);
+    assert_int_equal(0, write_tree_archive(tree_path, NULL, first_path, TEST_MAX_MTIME));
+    struct timespec times[2] = { { 0, UTIME_NOW }, { TEST_MAX_MTIME + 1000, 0 } };
+    assert_int_equal(0, utimensat(AT_FDCWD, file_path, times, 0));
+    assert_int_equal(0, write_tree_archive(tree_path, NULL, second_path, TEST_MAX_MTIME));
+
+    // Verify both archives are the same bytes.
+    char command[1024];
+    snprintf(command, sizeof(command), "cmp -s %s %s", first_path, second_path);
+    assert_int_equal(0, system(command));
+
+    // Extract the archive and verify the mtime was clamped.
+    char extract_dir[512];
+    char extracted_path[512];
+    snprintf(extract_dir, sizeof(extract_dir), "%s/extracted", test_dir);
+    snprintf(extracted_path, sizeof(extracted_path), "%s/hostname", extract_dir);
+    assert_int_equal(0, common.mkdir_p(extract_dir));
+    snprintf(command, sizeof(command), "tar -xf %s -C %s", second_path, extract_dir);
+    assert_int_equal(0, system(command));
+    struct stat extracted_stat;
+    assert_int_equal(0, stat(extracted_path, &extracted_stat));
+    assert_int_equal(TEST_MAX_MTIME, extracted_stat.st_mtime);
+}
+
+/** Verifies write_tree_archive() fails when the tree does not exist. */
+static void test_write_tree_archive_missing_tree(void **state)
+{
+    (void)state;
+
+    // Attempt to archive a path that does not exist.
+    char tree_path[512];
+    char archive_path[512];
+    snprintf(tree_path, sizeof(tree_path), "%s/missing", test_dir);
+    snprintf(archive_path, sizeof(archive_path), "%s/tree.tar", test_dir);
+    assert_int_equal(-3, write_tree_archive(tree_path, NULL, archive_path, TEST_MAX_MTIME));
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(
+            test_write_tree_archive_round_trip, setup, teardown
+        ),
+        cmocka_unit_test_setup_teardown(
+            test_write_tree_archive_reproducible, setup, teardown
+        ),
+        cmocka_unit_test_setup_teardown(
+            test_write_tree_archive_missing_tree, setup, teardown
+        ),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,212 @@
+/**
+ * This code is responsible for testing the file cloning and tree copying
+ * functions.
+ */
+
+#include "../../all.h"
+
+/** Test directory path for clone tests. */
+static char test_dir[256];
+
+/** Sets up the test environment before each test. */
+static int setup(void **state)
+{
+    (void)state;
+
+    // Create a unique test directory.
+    snprintf(
+        test_dir, sizeof(test_dir),
+        "/tmp/iso-builder-test-clone-%d",
+        getpid()
+    );
+    common.mkdir_p(test_dir);
+
+    return 0;
+}
+
+/** Cleans up the test environment after each test. */
+static int teardown(void **state)
+{
+    (void)state;
+
+    // Remove the test directory.
+    common.rm_rf(test_dir);
+    return 0;
+}
+
+/** Verifies clone_file() produces a file with identical contents. */
+static void test_clone_file_preserves_contents(void **state)
+{
+    (void)state;
+
+    // Write a source file.
+    char source_path[512];
+    snprintf(source_path, sizeof(source_path), "%s/source", test_dir);
+    assert_int_equal(0, common.write_file(source_path, "limeos"));
+
+    // Clone it within the same filesystem.
+    char destination_path[512];
+    snprintf(destination_path, sizeof(destination_path), "%s/destination", test_dir);
+    assert_int_equal(0, clone_file(source_path, destination_path));
+
+    // Read the clone back and verify its contents.
+    FILE *f = fopen(destination_path, "r");
+    assert_non_null(f);
+    char content[16];
+    size_t bytes = fread(content, 1, sizeof(content) - 1, f);
+    content[bytes] = '\0';
+    fclose(f);
+    assert_string_equal("limeos", content);
+}
+
+/** Verifies clone_file() fails when the source does not exist. */
+static void test_clone_file_missing_source(void **state)
+{
+    (void)state;
+
+    // Attempt to clone a path that does not exist.
+    char source_path[512];
+    char destination_path[512];
+    snprintf(source_path, sizeof(source_path), "%s/missing", test_dir);
+    snprintf(destination_path, sizeof(destination_path), "%s/destination", test_dir);
+    assert_int_equal(-1, clone_file(source_path, destination_path));
+}
+
+/** Verifies copy_tree() recreates every kind of entry with its metadata. */
+static void test_copy_tree_preserves_entries(void **state)
+{
+    (void)state;
+
+    // Build a tree with a private directory holding a file with an extended
+    // attribute, a hardlink to it, a symlink and a FIFO.
+    char source_path[512];
+    char private_path[512];
+    char file_path[512];
+    char link_path[512];
+    char symlink_path[512];
+    char fifo_path[512];
+    snprintf(source_path, sizeof(source_path), "%s/source", test_dir);
+    snprintf(private_path, sizeof(private_path), "%s/source/private", test_dir);
+    snprintf(file_path, sizeof(file_path), "%s/source/private/data", test_dir);
+    snprintf(link_path, sizeof(link_path), "%s/source/link", test_dir);
+    snprintf(symlink_path, sizeof(symlink_path), "%s/source/symlink", test_dir);
+    snprintf(fifo_path, sizeof(fifo_path), "%s/source/fifo", test_dir);
+    assert_int_equal(0, common.mkdir_p(private_path));
+    assert_int_equal(0, common.write_file(file_path, "limeos"));
+    assert_int_equal(0, setxattr(file_path, "user.limeos", "1", 1, 0));
+    assert_int_equal(0, link(file_path, link_path));
+    assert_int_equal(0, symlink("private/data", symlink_path));
+    assert_int_equal(0, mkfifo(fifo_path, 0600));
+
+    // Give the directory a non-default mode and an old mtime, after its
+    // contents exist.
+    struct timespec times[2] = { { 0, UTIME_OMIT }, { 1704067200, 0 } };
+    assert_int_equal(0, chmod(private_path, 0750));
+    assert_int_equal(0, utimensat(AT_FDCWD, private_path, times, 0));
+
+    // Copy the tree.
+    char destination_path[512];
+    snprintf(destination_path, sizeof(destination_path), "%s/destination", test_dir);
+    assert_int_equal(0, copy_tree(source_path, destination_path));
+
+    // Verify the directory kept its mode and mtime.
+    char copied_path[512];
+    struct stat copied_stat;
+    snprintf(copied_path, sizeof(copied_path), "%s/destination/private", test_dir);
+    assert_int_equal(0, lstat(copied_path, &copied_stat));
+    assert_true(S_ISDIR(copied_stat.st_mode));
+    assert_int_equal(0750, copied_stat.st_mode & 07777);
+    assert_int_equal(1704067200, copied_stat.st_mtime);
+
+    // Verify the file kept its extended attribute and its hardlink.
+    struct stat file_stat;
+    struct stat link_stat;
+    char value[16];
+    snprintf(copied_path, sizeof(copied_path), "%s/destination/private/data", test_dir);
+    assert_int_equal(0, lstat(copied_path, &file_stat));
+    assert_int_equal(1, getxattr(copied_path, "user.limeos", value, sizeof(value)));
+    assert_int_equal('1', value[0]);
+    snprintf(copied_path, sizeof(copied_path), "%s/destination/link", test_dir);
+    assert_int_equal(0, lstat(copied_path, &link_stat));
+    assert_int_equal(2, file_stat.st_nlink);
+    assert_int_equal(file_stat.st_ino, link_stat.st_ino);
+
+    // Verify the symlink and the FIFO were recreated as such.
+    char target[64];
+    snprintf(copied_path, sizeof(copied_path), "%s/destination/symlink", test_dir);
+    assert_int_equal(0, lstat(copied_path, &copied_stat));
+    assert_true(S_ISLNK(copied_stat.st_mode));
+    ssize_t target_length = readlink(copied_path, target, sizeof(target) - 1);
+    assert_int_equal(strlen("private/data"), target_length);
+    target[target_length] = '\0';
+    assert_string_equal("private/data", target);
+    snprintf(copied_path, sizeof(copied_path), "%s/destination/fifo", test_dir);
+    assert_int_equal(0, lstat(copied_path, &copied_stat));
+    assert_true(S_ISFIFO(copied_stat.st_mode));
+}
+
+/** Verifies copy_path() replaces single files and symlinks in place. */
+static void test_copy_path_replaces_entries(void **state)
+{
+    (void)state;
+
+    // Create an executable file, a symlink to a missing target, and stale
+    // copies of both at their destinations.
+    char file_path[512];
+    char symlink_path[512];
+    char copied_file_path[512];
+    char copied_symlink_path[512];
+    snprintf(file_path, sizeof(file_path), "%s/binary", test_dir);
+    snprintf(symlink_path, sizeof(symlink_path), "%s/default.target", test_dir);
+    snprintf(copied_file_path, sizeof(copied_file_path), "%s/binary.copy", test_dir);
+    snprintf(copied_symlink_path, sizeof(copied_symlink_path), "%s/default.copy", test_dir);
+    assert_int_equal(0, common.write_file(file_path, "limeos"));
+    assert_int_equal(0, chmod(file_path, 0755));
+    assert_int_equal(0, symlink("/lib/systemd/system/multi-user.target", symlink_path));
+    assert_int_equal(0, common.write_file(copied_file_path, "stale contents"));
+    assert_int_equal(0, common.write_file(copied_symlink_path, "stale"));
+
+    // Copy both over their stale copies.
+    assert_int_equal(0, copy_path(file_path, copied_file_path));
+    assert_int_equal(0, copy_path(symlink_path, copied_symlink_path));
+
+    // Verify the file kept its contents and mode.
+    struct stat copied_stat;
+    char buffer[32] = {0};
+    FILE *file = fopen(copied_file_path, "r");
+    assert_non_null(file);
+    assert_int_equal(6, fread(buffer, 1, sizeof(buffer) - 1, file));
+    fclose(file);
+    assert_string_equal("limeos", buffer);
+    assert_int_equal(0, lstat(copied_file_path, &copied_stat));
+    assert_int_equal(0755, copied_stat.st_mode & 07777);
+
+    // Verify the symlink was recreated without following it.
+    char target[64];
+    assert_int_equal(0, lstat(copied_symlink_path, &copied_stat));
+    assert_true(S_ISLNK(copied_stat.st_mode));
+    ssize_t target_length = readlink(copied_symlink_path, target, sizeof(target) - 1);
+    assert_true(target_length > 0);
+    target[target_length] = '\0';
+    assert_string_equal("/lib/systemd/system/multi-user.target", target);
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(
+            test_clone_file_preserves_contents, setup, teardown
+        ),
+        cmocka_unit_test_setup_teardown(
+            test_clone_file_missing_source, setup, teardown
+        ),
+        cmocka_unit_test_setup_teardown(
+            test_copy_tree_preserves_entries, setup, teardown
+        ),
+        cmocka_unit_test_setup_teardown(
+            test_copy_path_replaces_entries, setup, teardown
+        ),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
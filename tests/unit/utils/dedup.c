@@ -0,0 +1,162 @@
+/**
+ * This code is responsible for testing the tree deduplication functions.
+ */
+
+#include "../../all.h"
+
+/** Test directory path for deduplication tests. */
+static char test_dir[256];
+
+/** Sets up the test environment before each test. */
+static int setup(void **state)
+{
+    (void)state;
+
+    // Create a unique test directory.
+    snprintf(
+        test_dir, sizeof(test_dir),
+        "/tmp/iso-builder-test-dedup-%d",
+        getpid()
+    );
+    common.mkdir_p(test_dir);
+
+    return 0;
+}
+
+/** Cleans up the test environment after each test. */
+static int teardown(void **state)
+{
+    (void)state;
+
+    // Remove the test directory.
+    common.rm_rf(test_dir);
+    return 0;
+}
+
+/** Writes a file under the test directory and returns its path. */
+static void write_test_file(const char *name, const char *content, char *out_path)
+{
+    snprintf(out_path, 512, "%s/%s", test_dir, name);
+    assert_int_equal(0, common.write_file(out_path, content));
+}
+
+/** Returns the inode of a path. */
+static ino_t get_inode(const char *path)
+{
+    struct stat path_stat;
+    assert_int_equal(0, stat(path, &path_stat));
+    return path_stat.st_ino;
+}
+
+/** Verifies deduplicate_tree() links identical files and keeps the rest. */
+static void test_deduplicate_tree_links_identical_files(void **state)
+{
+    (void)state;
+
+    // Build a tree with two identical files, one in a subdirectory, and a
+    // file with different contents.
+    char nested_dir[512];
+    char first_path[512];
+    char second_path[512];
+    char other_path[512];
+    snprintf(nested_dir, sizeof(nested_dir), "%s/nested", test_dir);
+    assert_int_equal(0, common.mkdir_p(nested_dir));
+    write_test_file("first", "limeos", first_path);
+    write_test_file("nested/second", "limeos", second_path);
+    write_test_file("other", "debian", other_path);
+
+    // Deduplicate the tree.
+    struct stat first_stat;
+    assert_int_equal(0, stat(first_path, &first_stat));
+    unsigned long long saved_bytes = 0;
+    assert_int_equal(0, deduplicate_tree(test_dir, NULL, &saved_bytes));
+
+    // Verify the identical files share an inode and the other does not.
+    assert_int_equal(get_inode(first_path), get_inode(second_path));
+    assert_int_not_equal(get_inode(first_path), get_inode(other_path));
+    assert_int_equal((unsigned long long)first_stat.st_blocks * 512, saved_bytes);
+}
+
+/** Verifies deduplicate_tree() keeps identical files with other metadata. */
+static void test_deduplicate_tree_keeps_different_metadata(void **state)
+{
+    (void)state;
+
+    // Build two identical files with different permissions.
+    char first_path[512];
+    char second_path[512];
+    write_test_file("first", "limeos", first_path);
+    write_test_file("second", "limeos", second_path);
+    assert_int_equal(0, chmod(first_path, 0644));
+    assert_int_equal(0, chmod(second_path, 0755));
+
+    // Deduplicate the tree and verify both files are kept.
+    unsigned long long saved_bytes = 1;
+    assert_int_equal(0, deduplicate_tree(test_dir, NULL, &saved_bytes));
+    assert_int_not_equal(get_inode(first_path), get_inode(second_path));
+    assert_int_equal(0, saved_bytes);
+}
+
+/** Verifies deduplicate_tree() fails when the tree does not exist. */
+static void test_deduplicate_tree_missing_tree(void **state)
+{
+    (void)state;
+
+    // Attempt to deduplicate a path that does not exist.
+    char tree_path[512];
+    unsigned long long saved_bytes = 0;
+    snprintf(tree_path, sizeof(tree_path), "%s/missing", test_dir);
+    assert_int_equal(-1, deduplicate_tree(tree_path, NULL, &saved_bytes));
+}
+
+/** Verifies deduplicate_tree() links only files in an overlay's upper layer. */
+static void test_deduplicate_tree_upper_layer_only(void **state)
+{
+    (void)state;
+
+    // Build a tree of three identical files, of which an upper layer holds
+    // the first two, as an overlay shows them.
+    char tree_dir[512];
+    char upper_dir[512];
+    char first_path[512];
+    char second_path[512];
+    char lower_path[512];
+    char upper_path[512];
+    snprintf(tree_dir, sizeof(tree_dir), "%s/tree", test_dir);
+    snprintf(upper_dir, sizeof(upper_dir), "%s/upper", test_dir);
+    assert_int_equal(0, common.mkdir_p(tree_dir));
+    assert_int_equal(0, common.mkdir_p(upper_dir));
+    write_test_file("tree/first", "limeos", first_path);
+    write_test_file("tree/second", "limeos", second_path);
+    write_test_file("tree/lower", "limeos", lower_path);
+    write_test_file("upper/first", "limeos", upper_path);
+    write_test_file("upper/second", "limeos", upper_path);
+
+    // Deduplicate the tree against the upper layer.
+    unsigned long long saved_bytes = 0;
+    assert_int_equal(0, deduplicate_tree(tree_dir, upper_dir, &saved_bytes));
+
+    // Verify the upper layer files were linked and the lower one was not.
+    assert_int_equal(get_inode(first_path), get_inode(second_path));
+    assert_int_not_equal(get_inode(first_path), get_inode(lower_path));
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(
+            test_deduplicate_tree_links_identical_files, setup, teardown
+        ),
+        cmocka_unit_test_setup_teardown(
+            test_deduplicate_tree_keeps_different_metadata, setup, teardown
+        ),
+        cmocka_unit_test_setup_teardown(
+            test_deduplicate_tree_upper_layer_only, setup, teardown
+        ),
+        cmocka_unit_test_setup_teardown(
+            test_deduplicate_tree_missing_tree, setup, teardown
+        ),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}